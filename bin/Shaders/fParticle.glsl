@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec4 ourColor;
+in vec2 TexCoord;
+
+uniform sampler2D sprite;
+
+// drawn with additive blending, the order of the particles does not matter
+void main() {
+    FragColor = texture(sprite, TexCoord) * ourColor;
+}
@@ -4,9 +4,24 @@ out vec4 FragColor;
 in vec3 ourColor;
 in vec2 TexCoord;
 
+// variants: number of textures sampled, 0 uses the vertex color
+#ifndef TEXTURE_COUNT
+#define TEXTURE_COUNT 2
+#endif
+
+#if TEXTURE_COUNT >= 1
 uniform sampler2D texture1;
+#endif
+#if TEXTURE_COUNT >= 2
 uniform sampler2D texture2;
+#endif
 
 void main() {
+#if TEXTURE_COUNT == 0
+    FragColor = vec4(ourColor, 1.0);
+#elif TEXTURE_COUNT == 1
+    FragColor = texture(texture1, TexCoord);
+#else
     FragColor = mix(texture(texture1, TexCoord), texture(texture2, TexCoord), 0.2);
-}
\ No newline at end of file
+#endif
+}
@@ -0,0 +1,16 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec4 ourColor;
+in vec2 TexCoord;
+
+uniform sampler2D atlas;
+
+// the atlas holds distance, 0.5 on the outline: a pixel wide ramp across it
+// keeps the edge sharp and smooth at any size
+void main() {
+    float distance = texture(atlas, TexCoord).r;
+    float width = fwidth(distance);
+    float coverage = smoothstep(0.5 - width, 0.5 + width, distance);
+    FragColor = vec4(ourColor.rgb, ourColor.a * coverage);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// shared by every program, updated once per frame
+layout (std140) uniform Frame {
+    mat4 viewProjection;
+    float time;
+};
+
+// per draw, a range of one large buffer
+layout (std140) uniform Object {
+    mat4 transform;
+};
@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;
+layout (location = 1) in vec2 aTexCoord;
+// per particle (see particle_renderer.h)
+layout (location = 2) in float aX;
+layout (location = 3) in float aY;
+layout (location = 4) in float aFade;
+layout (location = 5) in float aSize;
+layout (location = 6) in vec4 aColor;
+
+out vec4 ourColor;
+out vec2 TexCoord;
+
+#include "uniforms.glsl"
+
+void main() {
+    // shrinks and fades out over its life
+    vec2 position = vec2(aX, aY) + aCorner * aSize * (0.5 + 0.5 * aFade);
+    gl_Position = viewProjection * transform * vec4(position, 0.0, 1.0);
+    ourColor = vec4(aColor.rgb, aColor.a * aFade);
+    TexCoord = aTexCoord;
+}
@@ -6,10 +6,10 @@ layout (location = 2) in vec2 aTexCoord;
 out vec3 ourColor;
 out vec2 TexCoord;
 
-uniform mat4 transform;
+#include "uniforms.glsl"
 
 void main() {
-    gl_Position = transform * vec4(aPos, 1.0f);
+    gl_Position = viewProjection * transform * vec4(aPos, 1.0f);
     ourColor = aColor;
     TexCoord = aTexCoord;
-}
\ No newline at end of file
+}
@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;
+// per glyph (see text_renderer.h)
+layout (location = 1) in vec2 aPosition;
+layout (location = 2) in vec2 aSize;
+layout (location = 3) in vec4 aCell;
+layout (location = 4) in vec4 aColor;
+
+out vec4 ourColor;
+out vec2 TexCoord;
+
+#include "uniforms.glsl"
+
+void main() {
+    gl_Position = viewProjection * transform * vec4(aPosition + aCorner * aSize, 0.0, 1.0);
+    ourColor = aColor;
+    TexCoord = mix(aCell.xy, aCell.zw, aCorner);
+}
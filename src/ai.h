@@ -0,0 +1,254 @@
+#ifndef AI_H
+#define AI_H
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+
+#include "glm/glm.hpp"
+
+#include "game.h"
+#include "simd.h"
+#include "bounds.h"
+#include "random.h"
+
+// Computer opponent.
+//
+// The ball's path to the paddle is a straight line folded by the walls, so
+// where it crosses the paddle line is closed form: extend the line to that x,
+// then fold y back into the field with a triangle wave (one period is a
+// bounce off each wall). No stepping, a handful of operations however far
+// the ball has to go.
+//
+// Difficulty is a reaction time and an aim error. Every time the ball changes
+// course (serve, paddle hit) the player waits `reactionTime` before aiming
+// again, and aims off by up to `noise` units per second of flight left, a
+// fresh random draw per new course. While the ball goes away it heads back to
+// the centre. Walls are part of the prediction, so they do not count as a
+// change of course.
+//
+// aiInput() decides for one seat. AiBatch decides for many seats at once in
+// float8 lanes, for servers filling lobbies with bots or batched self-play
+// with stepGames(): copying the few observed values in is the only per-seat
+// scalar work. Built without AVX2 it runs aiInput()'s scalar code per seat.
+
+struct AiSettings {
+    float reactionTime; // seconds
+    float noise;        // aim error in units per second of flight left
+
+    AiSettings() : reactionTime(0.2f), noise(0.15f) {}
+    AiSettings(float reactionTime, float noise) : reactionTime(reactionTime), noise(noise) {}
+
+    static AiSettings easy() { return AiSettings(0.35f, 0.4f); }
+    static AiSettings normal() { return AiSettings(0.2f, 0.15f); }
+    static AiSettings hard() { return AiSettings(0.12f, 0.12f); }
+};
+
+// what a seat remembers between ticks, start from AiPlayer(seed)
+struct AiPlayer {
+    float target;        // y the paddle is heading to
+    float countdown;     // seconds before aiming again, < 0 when not waiting
+    float seenVelocityX; // the course being followed, by its x speed (walls do not change it)
+    float sample;        // aim error draw in [-1, 1] for this course
+    uint32_t seed;
+    uint32_t draws;
+
+    explicit AiPlayer(uint32_t seed = 0)
+        : target(0.0f), countdown(-1.0f), seenVelocityX(0.0f), sample(0.0f), seed(seed), draws(0) {}
+};
+
+// y of the ball's centre when it reaches x = lineX, and the time it takes
+// (negative when moving away from the line)
+inline float predictCrossing(const GameConfig &config, const glm::vec2 &ball, const glm::vec2 &velocity, float lineX,
+                             float &time) {
+    time = velocity.x != 0.0f ? (lineX - ball.x) / velocity.x : -1.0f;
+    const float wall = config.halfSize.y - config.ballRadius;
+    const float period = 4.0f * wall;
+    float u = ball.y + velocity.y * time + wall;
+    u -= std::floor(u / period) * period;
+    return u < 2.0f * wall ? u - wall : 3.0f * wall - u;
+}
+
+// x the ball centre has when it touches the face of the paddle on `side`
+inline float paddleLineX(const GameConfig &config, int side) {
+    float reach = config.paddleHalf.x + config.ballRadius;
+    return side == 0 ? paddleCentreX(config, 0) + reach : paddleCentreX(config, 1) - reach;
+}
+
+// a new course: start the reaction countdown and draw the aim error
+inline void aiObserve(const AiSettings &settings, const GameState &state, AiPlayer &player) {
+    if (state.ballVelocity.x == player.seenVelocityX) return;
+    player.seenVelocityX = state.ballVelocity.x;
+    player.countdown = settings.reactionTime;
+    uint64_t bits = splitMix64(((uint64_t)player.seed << 32) | player.draws++);
+    player.sample = (float)(bits >> 40) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+inline PaddleInput aiInput(const GameConfig &config, const AiSettings &settings, const GameState &state, int side,
+                           AiPlayer &player, float dt) {
+    aiObserve(settings, state, player);
+    if (player.countdown >= 0.0f) {
+        player.countdown -= dt;
+        if (player.countdown <= 0.0f) {
+            float time;
+            float y = predictCrossing(config, state.ball, state.ballVelocity, paddleLineX(config, side), time);
+            player.target = time > 0.0f ? y + player.sample * settings.noise * time : 0.0f;
+            player.countdown = -1.0f;
+        }
+    }
+    // half a step of dead zone so it does not shake around the target
+    PaddleInput input = {0};
+    float error = player.target - state.paddleY[side];
+    float deadZone = 0.5f * config.paddleSpeed * dt;
+    if (error > deadZone) input.move = 1;
+    else if (error < -deadZone) input.move = -1;
+    return input;
+}
+
+// Many seats, one float8 lane each, with their AiPlayer state kept in the
+// lanes. Each tick: observe() every seat, decide(), read input(). Seats are
+// numbered from 0 and start as AiPlayer(seat), reset() them for a new match.
+class AiBatch {
+
+public:
+    AiSettings settings;
+
+    explicit AiBatch(const AiSettings &settings = AiSettings()) : settings(settings) {}
+
+    size_t size() const { return lanes.size(); }
+
+    void resize(size_t seats) {
+        size_t first = lanes.size();
+        lanes.resize(seats);
+        seeds.resize(seats);
+        draws.resize(seats);
+        for (size_t seat = first; seat < seats; seat++) reset(seat, (uint32_t)seat);
+    }
+
+    void reset(size_t seat, uint32_t seed) {
+        AiPlayer player(seed);
+        lanes[TARGET][seat] = player.target;
+        lanes[COUNTDOWN][seat] = player.countdown;
+        lanes[SEEN_VELOCITY_X][seat] = player.seenVelocityX;
+        lanes[SAMPLE][seat] = player.sample;
+        seeds[seat] = player.seed;
+        draws[seat] = player.draws;
+    }
+
+    // what the seat sees this tick, playing on `side`
+    void observe(size_t seat, const GameConfig &config, const GameState &state, int side) {
+        lanes[BALL_X][seat] = state.ball.x;
+        lanes[BALL_Y][seat] = state.ball.y;
+        lanes[VELOCITY_X][seat] = state.ballVelocity.x;
+        lanes[VELOCITY_Y][seat] = state.ballVelocity.y;
+        lanes[PADDLE_Y][seat] = state.paddleY[side];
+        lanes[LINE_X][seat] = paddleLineX(config, side);
+    }
+
+    // the seats [first, first + count), first a multiple of 8 so threads can
+    // take separate ranges; count 0 means up to the end. Without AVX2 the
+    // float8 fallback loses to aiInput(), so that build decides seat by seat.
+    void decide(const GameConfig &config, float dt, size_t first = 0, size_t count = 0) {
+        size_t end = count ? first + count : lanes.size();
+        if (end > lanes.size()) end = lanes.size();
+#if !SIMD_AVX2
+        for (size_t seat = first; seat < end; seat++) decideSeat(config, dt, seat);
+#else
+        const float8 zero = float8::broadcast(0.0f), one = float8::broadcast(1.0f), minusOne = float8::broadcast(-1.0f);
+        const float wallY = config.halfSize.y - config.ballRadius;
+        const float8 wall = float8::broadcast(wallY), twoWalls = float8::broadcast(2.0f * wallY);
+        const float8 threeWalls = float8::broadcast(3.0f * wallY), period = float8::broadcast(4.0f * wallY);
+        const float8 step = float8::broadcast(dt), noise = float8::broadcast(settings.noise);
+        const float8 deadZone = float8::broadcast(0.5f * config.paddleSpeed * dt);
+
+        for (size_t i = first; i < end; i += 8) {
+            float8 velocityX = float8::load(lanes[VELOCITY_X] + i);
+
+            // aiObserve(), the draws are rare enough to stay scalar
+            float8 seen = float8::load(lanes[SEEN_VELOCITY_X] + i);
+            int changed = (((velocityX < seen) | (velocityX > seen)) & mask8::firstLanes(end - i)).bits();
+            for (int lane = 0; changed; lane++, changed >>= 1) {
+                if (changed & 1) newCourse(i + lane);
+            }
+            float8 target = float8::load(lanes[TARGET] + i), countdown = float8::load(lanes[COUNTDOWN] + i);
+            mask8 waiting = countdown >= zero;
+            float8 left = countdown - step;
+            mask8 ready = waiting & (left <= zero);
+            countdown = select(ready, minusOne, select(waiting, left, countdown));
+
+            // predictCrossing(), most ticks no lane needs it
+            if (ready.any()) {
+                float8 ballX = float8::load(lanes[BALL_X] + i), ballY = float8::load(lanes[BALL_Y] + i);
+                float8 velocityY = float8::load(lanes[VELOCITY_Y] + i);
+                mask8 moving = (velocityX < zero) | (velocityX > zero);
+                float8 lineX = float8::load(lanes[LINE_X] + i);
+                float8 time = select(moving, (lineX - ballX) / select(moving, velocityX, one), minusOne);
+                float8 u = ballY + velocityY * time + wall;
+                u = u - floor(u / period) * period;
+                float8 y = select(u < twoWalls, u - wall, threeWalls - u);
+                float8 aim = select(time > zero, y + float8::load(lanes[SAMPLE] + i) * noise * time, zero);
+                target = select(ready, aim, target);
+            }
+
+            float8 error = target - float8::load(lanes[PADDLE_Y] + i);
+            float8 move = select(error > deadZone, one, select(error < -deadZone, minusOne, zero));
+
+            target.store(lanes[TARGET] + i);
+            countdown.store(lanes[COUNTDOWN] + i);
+            move.store(lanes[MOVE] + i);
+        }
+#endif
+    }
+
+    PaddleInput input(size_t seat) const {
+        PaddleInput input = {(int8_t)lanes[MOVE][seat]};
+        return input;
+    }
+
+private:
+    enum {
+        BALL_X, BALL_Y, VELOCITY_X, VELOCITY_Y, PADDLE_Y, LINE_X, // observed
+        TARGET, COUNTDOWN, SEEN_VELOCITY_X, SAMPLE,                // AiPlayer
+        MOVE, FIELDS
+    };
+
+    SoAArrays<FIELDS> lanes;
+    std::vector<uint32_t> seeds, draws;
+
+    // aiInput() on the lanes of one seat
+    void decideSeat(const GameConfig &config, float dt, size_t seat) {
+        float velocityX = lanes[VELOCITY_X][seat];
+        if (velocityX < lanes[SEEN_VELOCITY_X][seat] || velocityX > lanes[SEEN_VELOCITY_X][seat]) newCourse(seat);
+        float &target = lanes[TARGET][seat], &countdown = lanes[COUNTDOWN][seat];
+        if (countdown >= 0.0f) {
+            countdown -= dt;
+            if (countdown <= 0.0f) {
+                float time;
+                glm::vec2 ball(lanes[BALL_X][seat], lanes[BALL_Y][seat]);
+                glm::vec2 velocity(velocityX, lanes[VELOCITY_Y][seat]);
+                float y = predictCrossing(config, ball, velocity, lanes[LINE_X][seat], time);
+                target = time > 0.0f ? y + lanes[SAMPLE][seat] * settings.noise * time : 0.0f;
+                countdown = -1.0f;
+            }
+        }
+        float error = target - lanes[PADDLE_Y][seat];
+        float deadZone = 0.5f * config.paddleSpeed * dt;
+        lanes[MOVE][seat] = error > deadZone ? 1.0f : error < -deadZone ? -1.0f : 0.0f;
+    }
+
+    void newCourse(size_t seat) {
+        AiPlayer player;
+        player.seenVelocityX = lanes[SEEN_VELOCITY_X][seat];
+        player.seed = seeds[seat];
+        player.draws = draws[seat];
+        GameState state;
+        state.ballVelocity.x = lanes[VELOCITY_X][seat];
+        aiObserve(settings, state, player);
+        lanes[SEEN_VELOCITY_X][seat] = player.seenVelocityX;
+        lanes[COUNTDOWN][seat] = player.countdown;
+        lanes[SAMPLE][seat] = player.sample;
+        draws[seat] = player.draws;
+    }
+};
+
+#endif
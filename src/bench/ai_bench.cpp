@@ -0,0 +1,157 @@
+#include "../ai.h"
+#include "../game.h"
+#include "bench.h"
+
+#include <vector>
+#include <cstdio>
+#include <cmath>
+
+// AI benchmark, built with `make bench`: prediction error against the
+// simulation, cost of a decision scalar and batched, and batched self-play
+// between the difficulty presets.
+
+static const float STEP = 1.0f / 60.0f;
+
+// the predicted crossing against the ball actually stepped there, paddles out of the way
+static void accuracy()
+{
+    GameConfig config;
+    config.paddleHalf.y = 0.0f;
+    float worst = 0.0f;
+    int bounces = 0;
+    for (uint32_t serve = 0; serve < 1000; serve++) {
+      GameState state;
+      resetGame(config, state, serve + 1u);
+      // steeper and faster than a serve, up to 4 units/s and several walls a crossing
+      state.ballVelocity.y *= 6.0f;
+      state.ballVelocity *= 1.0f + (float)(serve % 4) / glm::length(state.ballVelocity);
+      state.paddleY[0] = state.paddleY[1] = -config.halfSize.y;
+      int side = state.ballVelocity.x < 0.0f ? 0 : 1;
+      float lineX = paddleLineX(config, side), time;
+      float predicted = predictCrossing(config, state.ball, state.ballVelocity, lineX, time);
+      PaddleInput still[2] = {{0}, {0}};
+      float previousVelocityY = state.ballVelocity.y;
+      for (;;) {
+        GameState before = state;
+        stepGame(config, state, still, STEP);
+        if (state.ballVelocity.y != previousVelocityY) bounces++;
+        previousVelocityY = state.ballVelocity.y;
+        bool crossed = side == 0 ? state.ball.x <= lineX : state.ball.x >= lineX;
+        if (!crossed) continue;
+        // back to the line within the step
+        float fraction = (lineX - before.ball.x) / (state.ball.x - before.ball.x);
+        float y = before.ball.y + (state.ball.y - before.ball.y) * fraction;
+        // a wall bounce inside that last step bends the path, skip those
+        if ((state.ballVelocity.y > 0.0f) == (before.ballVelocity.y > 0.0f))
+          worst = std::max(worst, std::fabs(y - predicted));
+        break;
+      }
+    }
+    printf("prediction: 1000 serves, %d wall bounces, worst error %.6f units\n", bounces, worst);
+}
+
+// on states recorded from bot matches, so courses change as in play
+static void cost()
+{
+    const int SEATS = 10000, TICKS = 300;
+    GameConfig config;
+    AiSettings settings = AiSettings::normal();
+    std::vector<GameState> recorded((size_t)SEATS * TICKS);
+    for (int i = 0; i < SEATS; i++) {
+      GameState state;
+      resetGame(config, state, (uint32_t)i + 1u);
+      AiPlayer players[2] = {AiPlayer(0), AiPlayer(1)};
+      for (int t = 0; t < TICKS; t++) {
+        recorded[(size_t)t * SEATS + i] = state;
+        PaddleInput inputs[2] = {aiInput(config, settings, state, 0, players[0], STEP),
+                                 aiInput(config, settings, state, 1, players[1], STEP)};
+        stepGame(config, state, inputs, STEP);
+      }
+    }
+    std::vector<AiPlayer> players;
+    for (int i = 0; i < SEATS; i++) players.push_back(AiPlayer((uint32_t)i));
+    std::vector<PaddleInput> inputs((size_t)SEATS * TICKS), batchInputs((size_t)SEATS * TICKS);
+
+    BenchClock::time_point start = BenchClock::now();
+    for (int t = 0; t < TICKS; t++) {
+      const GameState *states = &recorded[(size_t)t * SEATS];
+      PaddleInput *out = &inputs[(size_t)t * SEATS];
+      for (int i = 0; i < SEATS; i++) out[i] = aiInput(config, settings, states[i], 1, players[i], STEP);
+    }
+    double scalar = secondsSince(start) / TICKS / SEATS * 1e9;
+
+    AiBatch batch(settings);
+    batch.resize(SEATS);
+    start = BenchClock::now();
+    for (int t = 0; t < TICKS; t++) {
+      const GameState *states = &recorded[(size_t)t * SEATS];
+      for (int i = 0; i < SEATS; i++) batch.observe(i, config, states[i], 1);
+      batch.decide(config, STEP);
+      PaddleInput *out = &batchInputs[(size_t)t * SEATS];
+      for (int i = 0; i < SEATS; i++) out[i] = batch.input(i);
+    }
+    double batched = secondsSince(start) / TICKS / SEATS * 1e9;
+    size_t differ = 0;
+    for (size_t i = 0; i < inputs.size(); i++) differ += inputs[i].move != batchInputs[i].move;
+
+    // what is left when the caller keeps the observed values in the lanes itself
+    start = BenchClock::now();
+    for (int t = 0; t < TICKS; t++) batch.decide(config, STEP);
+    double decideOnly = secondsSince(start) / TICKS / SEATS * 1e9;
+    printf("decision: scalar %.1f ns, batched %.1f ns with observe() and input(), %.1f ns decide() alone, "
+           "%zu / %zu inputs differ\n", scalar, batched, decideOnly, differ, inputs.size());
+}
+
+// `left` against `right`, many matches stepped together
+static void selfPlay(const char *leftName, const AiSettings &left, const char *rightName, const AiSettings &right)
+{
+    const int MATCHES = 1000, TICKS = 60 * 60;
+    GameConfig config;
+    std::vector<GameState> states(MATCHES);
+    std::vector<PaddleInput> inputs(MATCHES * 2);
+    std::vector<GameState *> statePointers(MATCHES);
+    std::vector<const PaddleInput *> inputPointers(MATCHES);
+    for (int m = 0; m < MATCHES; m++) {
+      resetGame(config, states[m], (uint32_t)m + 1u);
+      statePointers[m] = &states[m];
+      inputPointers[m] = &inputs[m * 2];
+    }
+    // one batch a difficulty, seat m for match m
+    AiBatch leftBatch(left), rightBatch(right);
+    leftBatch.resize(MATCHES);
+    rightBatch.resize(MATCHES);
+    for (int m = 0; m < MATCHES; m++) rightBatch.reset(m, (uint32_t)(MATCHES + m));
+    BenchClock::time_point start = BenchClock::now();
+    for (int t = 0; t < TICKS; t++) {
+      for (int m = 0; m < MATCHES; m++) {
+        leftBatch.observe(m, config, states[m], 0);
+        rightBatch.observe(m, config, states[m], 1);
+      }
+      leftBatch.decide(config, STEP);
+      rightBatch.decide(config, STEP);
+      for (int m = 0; m < MATCHES; m++) {
+        inputs[m * 2] = leftBatch.input(m);
+        inputs[m * 2 + 1] = rightBatch.input(m);
+      }
+      stepGames(config, statePointers.data(), inputPointers.data(), MATCHES, STEP);
+    }
+    double seconds = secondsSince(start);
+    unsigned long points[2] = {0, 0};
+    for (int m = 0; m < MATCHES; m++) {
+      points[0] += states[m].score[0];
+      points[1] += states[m].score[1];
+    }
+    printf("self-play %-6s vs %-6s: %lu - %lu points, %.1f s of rallies a point, %.0f match-ticks/s\n", leftName,
+           rightName, points[0], points[1], (double)MATCHES * TICKS * STEP / (points[0] + points[1] + 1),
+           (double)MATCHES * TICKS / seconds);
+}
+
+int main()
+{
+    accuracy();
+    cost();
+    selfPlay("hard", AiSettings::hard(), "hard", AiSettings::hard());
+    selfPlay("hard", AiSettings::hard(), "normal", AiSettings::normal());
+    selfPlay("normal", AiSettings::normal(), "easy", AiSettings::easy());
+    return 0;
+}
@@ -0,0 +1,54 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstdio>
+
+#include "../simd.h"
+#include "../game.h"
+
+// Shared by the benchmarks of src/bench, one program per file (`make bench`):
+// the timer, the report lines, and a bot to play matches with.
+
+typedef std::chrono::steady_clock BenchClock;
+
+inline double secondsSince(BenchClock::time_point start) {
+    return std::chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+// seconds a call of `body` takes, averaged over `repeats` calls
+template <typename Body>
+inline double timed(Body body, int repeats = 20) {
+    BenchClock::time_point start = BenchClock::now();
+    for (int r = 0; r < repeats; r++) body();
+    return secondsSince(start) / repeats;
+}
+
+// which float8 kernels the build runs
+inline void printSimd() {
+#if SIMD_AVX2
+    printf("float8: AVX2\n");
+#else
+    printf("float8: scalar lanes (build with SIMD=avx2 for AVX2)\n");
+#endif
+}
+
+// ends a report line: both codes in nanoseconds per item of work (`item`
+// with its article), then the speedup of the second, e.g.
+// "scalar 12.30 ns, batched 4.10 ns a ray (3.0x)"
+inline void printSpeedup(const char *reference, double referenceSeconds, const char *candidate,
+                         double candidateSeconds, double items, const char *item) {
+    printf("%s %7.2f ns, %s %7.2f ns %s (%.1fx)\n", reference, referenceSeconds / items * 1e9, candidate,
+           candidateSeconds / items * 1e9, item, referenceSeconds / candidateSeconds);
+}
+
+// follows the ball, with some dead zone so paddles also rest
+inline PaddleInput trackBall(const GameConfig &config, const GameState &state, int side) {
+    PaddleInput input = {0};
+    float error = state.ball.y - state.paddleY[side];
+    if (error > config.paddleHalf.y * 0.5f) input.move = 1;
+    else if (error < -config.paddleHalf.y * 0.5f) input.move = -1;
+    return input;
+}
+
+#endif
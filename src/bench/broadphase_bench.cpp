@@ -0,0 +1,110 @@
+#include "../broadphase.h"
+#include "../random.h"
+#include "bench.h"
+
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+
+// Spatial hash benchmark, built with `make bench`: bodies drifting in a
+// square arena at a constant density, update + pair search per tick, checked
+// against (and timed next to) the n^2 loop where that is affordable.
+
+static const int TICKS = 100;
+
+struct Body {
+    glm::vec2 position, velocity;
+    float radius;
+};
+
+static bool pairLess(const BroadPair &x, const BroadPair &y)
+{
+    return x.a != y.a ? x.a < y.a : x.b < y.b;
+}
+
+static void bruteForce(const std::vector<Body> &bodies, std::vector<BroadPair> &pairs)
+{
+    pairs.clear();
+    for (uint32_t a = 0; a < bodies.size(); a++) {
+      for (uint32_t b = a + 1; b < bodies.size(); b++) {
+        glm::vec2 gap = glm::abs(bodies[a].position - bodies[b].position);
+        float reach = bodies[a].radius + bodies[b].radius;
+        if (gap.x <= reach && gap.y <= reach) {
+          BroadPair pair = {a, b};
+          pairs.push_back(pair);
+        }
+      }
+    }
+}
+
+static void run(size_t count)
+{
+    // about one body per 4 square units, bodies of 0.3 - 0.6 radius in cells of 1
+    const float side = std::sqrt((float)count * 4.0f);
+    Pcg32 rng(12345u);
+    std::vector<Body> bodies(count);
+    for (size_t i = 0; i < count; i++) {
+      Body &body = bodies[i];
+      body.position = linearRand(rng, glm::vec2(0.0f), glm::vec2(side));
+      body.velocity = linearRand(rng, glm::vec2(-0.05f), glm::vec2(0.05f));
+      body.radius = linearRand(rng, 0.3f, 0.6f);
+    }
+
+    SpatialHash hash(1.0f);
+    std::vector<uint32_t> ids(count);
+    for (size_t i = 0; i < count; i++)
+      ids[i] = hash.add(bodies[i].position - bodies[i].radius, bodies[i].position + bodies[i].radius);
+
+    std::vector<BroadPair> pairs, expected;
+    BenchClock::time_point start = BenchClock::now();
+    hash.findPairs(pairs);
+    double firstMs = secondsSince(start) * 1e3;
+
+    bool checkable = count <= 10000;
+    double hashMs = 0.0, bruteMs = 0.0;
+    size_t rebuilt = 0, fullRebuilds = 0, pairTotal = 0;
+    int mismatches = 0;
+    for (int tick = 0; tick < TICKS; tick++) {
+      for (size_t i = 0; i < count; i++) {
+        Body &body = bodies[i];
+        body.position += body.velocity;
+        if (body.position.x < 0.0f || body.position.x > side) body.velocity.x = -body.velocity.x;
+        if (body.position.y < 0.0f || body.position.y > side) body.velocity.y = -body.velocity.y;
+      }
+
+      start = BenchClock::now();
+      for (size_t i = 0; i < count; i++)
+        hash.move(ids[i], bodies[i].position - bodies[i].radius, bodies[i].position + bodies[i].radius);
+      hash.findPairs(pairs);
+      hashMs += secondsSince(start) * 1e3;
+      rebuilt += hash.stats.rebuiltEntries;
+      fullRebuilds += hash.stats.fullRebuild ? 1 : 0;
+      pairTotal += pairs.size();
+
+      // the n^2 loop on a few ticks only past 1k bodies
+      if (checkable && (count <= 1000 || tick % 25 == 0)) {
+        start = BenchClock::now();
+        bruteForce(bodies, expected);
+        bruteMs += secondsSince(start) * 1e3 * (count <= 1000 ? 1.0 : 25.0);
+        std::sort(pairs.begin(), pairs.end(), pairLess);
+        if (pairs.size() != expected.size() ||
+            !std::equal(pairs.begin(), pairs.end(), expected.begin(),
+                        [](const BroadPair &x, const BroadPair &y) { return x.a == y.a && x.b == y.b; }))
+          mismatches++;
+      }
+    }
+
+    printf("%7d bodies: first build %7.3f ms, tick %7.3f ms (%5.1f%% of entries rebuilt, %d full), "
+           "%6.0f pairs", (int)count, firstMs, hashMs / TICKS, 100.0 * rebuilt / TICKS / hash.stats.entries,
+           (int)fullRebuilds, (double)pairTotal / TICKS);
+    if (checkable) printf(", n^2 %8.3f ms, %d mismatches\n", bruteMs / TICKS, mismatches);
+    else printf(", n^2 skipped\n");
+}
+
+int main()
+{
+    run(1000);
+    run(10000);
+    run(100000);
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "../half.h"
+#include "../random.h"
+#include "bench.h"
+
+#include <vector>
+#include <cstdio>
+#include <cmath>
+
+// Half float and normalized packing benchmark, built with `make bench`:
+// the conversions of half.h checked bit for bit (against F16C itself when
+// the build has it, SIMD=avx2), then the bulk functions timed against the
+// per-element glm ones.
+
+static const size_t COUNT = 1 << 22;
+
+// every float and every half through the software path
+static void checkHalf()
+{
+  unsigned long toHalf = 0, toFloat = 0, glmDiffers = 0;
+#if defined(__F16C__)
+  for (uint64_t u = 0; u < (1ull << 32); u++) {
+    float f = bitsFloat((uint32_t)u);
+    if (floatToHalfSoftware(f) != (uint16_t)_cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT)) toHalf++;
+  }
+  for (uint32_t h = 0; h < 65536; h++)
+    if (floatBits(halfToFloatSoftware((uint16_t)h)) != floatBits(_cvtsh_ss((uint16_t)h))) toFloat++;
+  printf("software against F16C: %lu / 2^32 floats and %lu / 2^16 halves differ\n", toHalf, toFloat);
+#else
+  // no hardware to compare with: halves must survive the round trip, NaN payloads included
+  for (uint32_t h = 0; h < 65536; h++) {
+    uint16_t back = floatToHalfSoftware(halfToFloatSoftware((uint16_t)h));
+    bool nan = (h & 0x7C00u) == 0x7C00u && (h & 0x3FFu);
+    if (back != (nan ? (h | 0x200u) : h)) toFloat++; // NaNs come back quiet
+  }
+  printf("software round trip: %lu / 2^16 halves differ (build with SIMD=avx2 to check against F16C)\n",
+         toFloat);
+#endif
+  for (uint64_t u = 0; u < (1ull << 32); u += 97) {
+    float f = bitsFloat((uint32_t)u);
+    if (std::isnan(f)) continue;
+    if (floatToHalf(f) != glm::packHalf1x16(f)) glmDiffers++;
+  }
+  printf("glm::packHalf1x16 rounds differently on %lu of 44M sampled floats\n", glmDiffers);
+}
+
+static void checkNormalized(const std::vector<float> &values)
+{
+  std::vector<uint8_t> unorm(values.size());
+  std::vector<int16_t> snorm(values.size());
+  packUnorm8(values.data(), unorm.data(), values.size());
+  packSnorm16(values.data(), snorm.data(), values.size());
+  size_t unormDiffers = 0, snormDiffers = 0;
+  for (size_t i = 0; i < values.size(); i++) {
+    if (unorm[i] != glm::packUnorm1x8(values[i])) unormDiffers++;
+    if ((uint16_t)snorm[i] != glm::packSnorm1x16(values[i])) snormDiffers++;
+  }
+  printf("packUnorm8 / packSnorm16 against glm: %zu and %zu of %zu differ\n", unormDiffers, snormDiffers,
+         values.size());
+}
+
+static void print(const char *name, double glmSeconds, double bulkSeconds)
+{
+  printf("%-14s ", name);
+  printSpeedup("glm", glmSeconds, "bulk", bulkSeconds, COUNT, "a value");
+}
+
+int main()
+{
+#if defined(__F16C__)
+  printf("half: F16C, normalized: AVX2\n");
+#else
+  printf("half and normalized: scalar (build with SIMD=avx2 for F16C / AVX2)\n");
+#endif
+  checkHalf();
+
+  // a spread of magnitudes plus the values the rounding is decided on
+  Pcg32 rng(28, 1);
+  std::vector<float> values(COUNT);
+  for (size_t i = 0; i < COUNT; i++) values[i] = gaussRand(rng, 0.0f, 0.6f);
+  for (int k = -300; k <= 300; k++) values[k + 300] = k / 255.0f + 0.5f / 255.0f; // unorm8 ties
+  checkNormalized(values);
+
+  std::vector<uint16_t> halves(COUNT);
+  std::vector<float> floats(COUNT);
+  std::vector<uint8_t> bytes(COUNT);
+  std::vector<int16_t> shorts(COUNT);
+
+  double glmSeconds = timed([&] { for (size_t i = 0; i < COUNT; i++) halves[i] = glm::packHalf1x16(values[i]); });
+  double bulkSeconds = timed([&] { packHalf(values.data(), halves.data(), COUNT); });
+  print("packHalf", glmSeconds, bulkSeconds);
+  glmSeconds = timed([&] { for (size_t i = 0; i < COUNT; i++) floats[i] = glm::unpackHalf1x16(halves[i]); });
+  bulkSeconds = timed([&] { unpackHalf(halves.data(), floats.data(), COUNT); });
+  print("unpackHalf", glmSeconds, bulkSeconds);
+  glmSeconds = timed([&] { for (size_t i = 0; i < COUNT; i++) bytes[i] = glm::packUnorm1x8(values[i]); });
+  bulkSeconds = timed([&] { packUnorm8(values.data(), bytes.data(), COUNT); });
+  print("packUnorm8", glmSeconds, bulkSeconds);
+  glmSeconds = timed([&] {
+    for (size_t i = 0; i < COUNT; i++) shorts[i] = (int16_t)glm::packSnorm1x16(values[i]);
+  });
+  bulkSeconds = timed([&] { packSnorm16(values.data(), shorts.data(), COUNT); });
+  print("packSnorm16", glmSeconds, bulkSeconds);
+  return 0;
+}
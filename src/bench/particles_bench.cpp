@@ -0,0 +1,132 @@
+#include "../particles.h"
+#include "../thread_pool.h"
+#include "bench.h"
+
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+// Particle benchmark, built with `make bench`: update() of a million live
+// particles with and without the thread pool, a plain per-particle loop over
+// an array of structs for comparison, and the copies the renderer makes to
+// upload them.
+
+static const float STEP = 1.0f / 60.0f;
+static const size_t COUNT = 1000000;
+
+// the same motion on one struct a particle, what the SoA arrays replace
+struct Particle {
+  glm::vec2 position, velocity;
+  float fade, fadeRate, size;
+  uint32_t color;
+};
+
+static void updateAos(std::vector<Particle> &particles, const ParticleSystem::Settings &settings, float dt)
+{
+  const float damping = std::exp(-settings.drag * dt);
+  for (size_t i = 0; i < particles.size();) {
+    Particle &p = particles[i];
+    p.velocity = (p.velocity + settings.gravity * dt) * damping;
+    p.position += p.velocity * dt;
+    p.fade -= p.fadeRate * dt;
+    if (p.fade <= 0.0f) {
+      p = particles.back();
+      particles.pop_back();
+    } else {
+      i++;
+    }
+  }
+}
+
+// a fountain topped up every frame so about COUNT stay alive, as main.cpp --particles does
+static ParticleBurst fountain(size_t count)
+{
+  ParticleBurst burst;
+  burst.position = glm::vec2(0.0f, -1.0f);
+  burst.count = (int)count;
+  burst.direction = glm::half_pi<float>();
+  burst.spread = 1.0f;
+  burst.speedMin = 1.0f;
+  burst.speedMax = 2.5f;
+  burst.lifetimeMin = 1.0f;
+  burst.lifetimeMax = 2.0f;
+  return burst;
+}
+
+static void run(const char *name, ThreadPool *pool)
+{
+  ParticleSystem particles(COUNT);
+  Pcg32 rng(1, 1);
+  particles.emit(fountain(COUNT), rng);
+  // past the first deaths, then timed with the top-ups outside the timer
+  const int FRAMES = 240;
+  double update = 0.0;
+  size_t died = 0, live = 0;
+  for (int frame = 0; frame < FRAMES; frame++) {
+    particles.emit(fountain(COUNT - particles.size()), rng);
+    BenchClock::time_point start = BenchClock::now();
+    particles.update(STEP, pool);
+    if (frame >= FRAMES / 2) {
+      update += secondsSince(start);
+      died += particles.stats.died;
+      live += particles.size();
+    }
+  }
+  int timed = FRAMES - FRAMES / 2;
+  printf("%-26s %6.2f ms a frame for %zu live, %zu die a frame\n", name, update / timed * 1e3, live / timed,
+         died / timed);
+}
+
+static void aos()
+{
+  ParticleSystem::Settings settings;
+  Pcg32 rng(1, 1);
+  std::vector<Particle> particles;
+  particles.reserve(COUNT);
+  const int FRAMES = 240;
+  double update = 0.0;
+  for (int frame = 0; frame < FRAMES; frame++) {
+    while (particles.size() < COUNT) {
+      Particle p;
+      p.position = glm::vec2(0.0f, -1.0f);
+      float angle = glm::half_pi<float>() + (unitRand(rng) - 0.5f);
+      p.velocity = linearRand(rng, 1.0f, 2.5f) * glm::vec2(std::cos(angle), std::sin(angle));
+      p.fade = 1.0f;
+      p.fadeRate = 1.0f / linearRand(rng, 1.0f, 2.0f);
+      p.size = 0.02f;
+      p.color = ~0u;
+      particles.push_back(p);
+    }
+    BenchClock::time_point start = BenchClock::now();
+    updateAos(particles, settings, STEP);
+    if (frame >= FRAMES / 2) update += secondsSince(start);
+  }
+  printf("%-26s %6.2f ms a frame\n", "array of structs", update / (FRAMES - FRAMES / 2) * 1e3);
+}
+
+// the five arrays the renderer copies, into memory standing in for the mapped buffer
+static void upload()
+{
+  ParticleSystem particles(COUNT);
+  Pcg32 rng(1, 1);
+  particles.emit(fountain(COUNT), rng);
+  std::vector<float> mapped(COUNT * 5);
+  double seconds = timed([&] {
+    const int fields[] = {ParticleSystem::X, ParticleSystem::Y, ParticleSystem::FADE, ParticleSystem::SIZE};
+    for (int a = 0; a < 4; a++) memcpy(&mapped[a * COUNT], particles.field(fields[a]), COUNT * 4);
+    memcpy(&mapped[4 * COUNT], particles.packedColors(), COUNT * 4);
+  }, 50);
+  printf("%-26s %6.2f ms a frame, %.1f MB\n", "upload copies", seconds * 1e3, COUNT * 20 / 1e6);
+}
+
+int main()
+{
+  run("update, this thread", NULL);
+  ThreadPool pool;
+  char name[64];
+  snprintf(name, sizeof(name), "update, %u workers + this", pool.size());
+  run(name, &pool);
+  aos();
+  upload();
+  return 0;
+}
@@ -0,0 +1,156 @@
+#include "../policy.h"
+#include "../game.h"
+#include "../random.h"
+#include "bench.h"
+
+#include <vector>
+#include <cstdio>
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+
+// Policy network benchmark, built with `make bench`: random networks of a few
+// sizes written as weight files, loaded back, checked against a plain double
+// precision forward pass and timed at several batch sizes.
+
+static const char *WEIGHTS_PATH = "policy_bench.mlp";
+
+struct Net {
+  std::vector<int> widths; // inputs first
+  std::vector<int> activations;
+  std::vector<std::vector<float> > weights, biases; // outputs x inputs as in the file
+};
+
+static void writeU32(std::ofstream &file, uint32_t value)
+{
+  file.write((const char *)&value, 4);
+}
+
+// Xavier-like weights so tanh layers neither saturate nor vanish
+static Net randomNet(const std::vector<int> &hidden, int activation, uint64_t seed)
+{
+  Pcg32 rng(seed, 1);
+  Net net;
+  net.widths.push_back(POLICY_INPUTS);
+  net.widths.insert(net.widths.end(), hidden.begin(), hidden.end());
+  net.widths.push_back(3);
+  for (size_t l = 0; l + 1 < net.widths.size(); l++) {
+    int inputs = net.widths[l], outputs = net.widths[l + 1];
+    float scale = std::sqrt(3.0f / inputs);
+    std::vector<float> w((size_t)inputs * outputs), b(outputs);
+    for (size_t i = 0; i < w.size(); i++) w[i] = linearRand(rng, -scale, scale);
+    for (size_t i = 0; i < b.size(); i++) b[i] = linearRand(rng, -0.1f, 0.1f);
+    net.weights.push_back(w);
+    net.biases.push_back(b);
+    net.activations.push_back(l + 2 < net.widths.size() ? activation : MlpPolicy::LINEAR);
+  }
+  return net;
+}
+
+static bool save(const Net &net, const char *path)
+{
+  std::ofstream file(path, std::ios::out | std::ios::binary);
+  if (!file) return false;
+  file.write("PMLP", 4);
+  writeU32(file, MlpPolicy::VERSION);
+  writeU32(file, POLICY_INPUTS);
+  writeU32(file, (uint32_t)net.weights.size());
+  for (size_t l = 0; l < net.weights.size(); l++) {
+    writeU32(file, (uint32_t)net.widths[l + 1]);
+    writeU32(file, (uint32_t)net.activations[l]);
+    file.write((const char *)net.weights[l].data(), net.weights[l].size() * 4);
+    file.write((const char *)net.biases[l].data(), net.biases[l].size() * 4);
+  }
+  return (bool)file;
+}
+
+static void reference(const Net &net, const PolicyObservation &observation, double scores[3])
+{
+  std::vector<double> x(POLICY_INPUTS), y;
+  const float *values = &observation.ball.x;
+  for (int i = 0; i < POLICY_INPUTS; i++) x[i] = values[i];
+  for (size_t l = 0; l < net.weights.size(); l++) {
+    int inputs = net.widths[l], outputs = net.widths[l + 1];
+    y.assign(outputs, 0.0);
+    for (int o = 0; o < outputs; o++) {
+      double sum = net.biases[l][o];
+      for (int i = 0; i < inputs; i++) sum += (double)net.weights[l][(size_t)o * inputs + i] * x[i];
+      if (net.activations[l] == MlpPolicy::RELU) sum = std::max(sum, 0.0);
+      if (net.activations[l] == MlpPolicy::TANH) sum = std::tanh(sum);
+      y[o] = sum;
+    }
+    x.swap(y);
+  }
+  for (int i = 0; i < 3; i++) scores[i] = x[i];
+}
+
+static void run(const char *name, const std::vector<int> &hidden, int activation,
+                const std::vector<PolicyObservation> &observations)
+{
+  Net net = randomNet(hidden, activation, hidden.size() * 1000 + hidden[0]);
+  MlpPolicy policy;
+  if (!save(net, WEIGHTS_PATH) || !policy.load(WEIGHTS_PATH)) return;
+  std::remove(WEIGHTS_PATH);
+
+  // accuracy
+  const size_t checked = 10000;
+  std::vector<float> scores(checked * 3);
+  std::vector<PaddleInput> moves(observations.size());
+  policy.forward(observations.data(), checked, scores.data());
+  policy.act(observations.data(), checked, moves.data());
+  double worst = 0.0;
+  size_t differentMoves = 0;
+  for (size_t i = 0; i < checked; i++) {
+    double expected[3];
+    reference(net, observations[i], expected);
+    for (int k = 0; k < 3; k++) worst = std::max(worst, std::fabs(expected[k] - scores[i * 3 + k]));
+    int best = expected[1] > expected[0] ? 1 : 0;
+    if (expected[2] > expected[best]) best = 2;
+    if (moves[i].move != best - 1) differentMoves++;
+  }
+
+  printf("%-22s worst score error %.2e, %zu / %zu moves differ from double precision\n", name, worst,
+         differentMoves, checked);
+
+  const size_t batches[] = {1, 16, 256, 10000};
+  for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+    size_t batch = batches[b];
+    size_t total = 0;
+    BenchClock::time_point start = BenchClock::now();
+    while (total < 2000000 && secondsSince(start) < 0.5) {
+      for (size_t first = 0; first + batch <= observations.size(); first += batch) {
+        policy.act(&observations[first], batch, &moves[first]);
+        total += batch;
+      }
+    }
+    double seconds = secondsSince(start);
+    printf("  batch %5zu: %8.1f ns a decision, %6.2f M decisions/s, %5.1f GFLOP/s\n", batch, seconds / total * 1e9,
+           total / seconds * 1e-6, (double)total * policy.flopsPerRow() / seconds * 1e-9);
+  }
+}
+
+int main()
+{
+  // observations from bot matches
+  const size_t count = 100000;
+  GameConfig config;
+  std::vector<PolicyObservation> observations;
+  GameState state;
+  resetGame(config, state, 7u);
+  PaddleInput inputs[2] = {{0}, {0}};
+  Pcg32 rng(3, 1);
+  while (observations.size() < count) {
+    if (observations.size() % 30 == 0) {
+      inputs[0].move = (int8_t)(rng.nextUInt() % 3) - 1;
+      inputs[1].move = (int8_t)(rng.nextUInt() % 3) - 1;
+    }
+    stepGame(config, state, inputs, 1.0f / 60.0f);
+    observations.push_back(observePolicy(config, state, (int)(observations.size() & 1)));
+  }
+
+  run("6-64-64-3 tanh", std::vector<int>{64, 64}, MlpPolicy::TANH, observations);
+  run("6-64-64-3 relu", std::vector<int>{64, 64}, MlpPolicy::RELU, observations);
+  run("6-256-256-3 tanh", std::vector<int>{256, 256}, MlpPolicy::TANH, observations);
+  run("6-32-3 relu", std::vector<int>{32}, MlpPolicy::RELU, observations);
+  return 0;
+}
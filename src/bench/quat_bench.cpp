@@ -0,0 +1,164 @@
+#define GLM_ENABLE_EXPERIMENTAL
+#include "../quat_batch.h"
+#include "../random.h"
+
+#include "../glm/gtx/dual_quaternion.hpp"
+#include "bench.h"
+
+#include <vector>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+// Quaternion benchmark, built with `make bench`: every kernel of
+// quat_batch.h against the same work done one element at a time with glm
+// (slerp, mat4_cast, tdualquat), the largest difference reported, then both
+// timed. Build with SIMD=avx2 for the AVX2 kernels.
+
+static const size_t COUNT = 1 << 16;
+static const size_t BONES = 64;
+
+static void print(const char *name, float worst, double glmSeconds, double batchSeconds)
+{
+  printf("%-22s worst difference %.2e, ", name, worst);
+  printSpeedup("glm", glmSeconds, "batched", batchSeconds, COUNT, "an element");
+}
+
+template <typename Rng>
+static glm::quat randomRotation(Rng &rng)
+{
+  return glm::angleAxis(linearRand(rng, -glm::pi<float>(), glm::pi<float>()), sphericalRand(rng, 1.0f));
+}
+
+static float difference(const glm::quat &a, const glm::quat &b)
+{
+  return std::max(std::max(std::fabs(a.x - b.x), std::fabs(a.y - b.y)),
+                  std::max(std::fabs(a.z - b.z), std::fabs(a.w - b.w)));
+}
+
+static float difference(const glm::mat4 &a, const glm::mat4 &b)
+{
+  float worst = 0.0f;
+  for (int c = 0; c < 4; c++)
+    for (int r = 0; r < 4; r++) worst = std::max(worst, std::fabs(a[c][r] - b[c][r]));
+  return worst;
+}
+
+static void interpolation(Pcg32 &rng)
+{
+  std::vector<glm::quat> a(COUNT), b(COUNT), expected(COUNT);
+  std::vector<float> t(COUNT);
+  QuatSoA sa, sb, out;
+  for (size_t i = 0; i < COUNT; i++) {
+    a[i] = randomRotation(rng);
+    // from nearly equal to opposite hemispheres
+    b[i] = i % 4 == 0 ? glm::normalize(a[i] * glm::angleAxis(1e-3f, sphericalRand(rng, 1.0f))) : randomRotation(rng);
+    t[i] = unitRand(rng);
+    sa.add(a[i]);
+    sb.add(b[i]);
+  }
+
+  double glmSeconds = timed([&] { for (size_t i = 0; i < COUNT; i++) expected[i] = glm::slerp(a[i], b[i], t[i]); });
+  double batchSeconds = timed([&] { slerpBatch(sa, sb, t.data(), out); });
+  float worst = 0.0f;
+  for (size_t i = 0; i < COUNT; i++) worst = std::max(worst, difference(out.get(i), expected[i]));
+  print("slerp", worst, glmSeconds, batchSeconds);
+
+  glmSeconds = timed([&] {
+    for (size_t i = 0; i < COUNT; i++) {
+      float s = glm::dot(a[i], b[i]) < 0.0f ? -1.0f : 1.0f;
+      expected[i] = glm::normalize(a[i] * (1.0f - t[i]) + b[i] * (s * t[i]));
+    }
+  });
+  batchSeconds = timed([&] { nlerpBatch(sa, sb, t.data(), out); });
+  worst = 0.0f;
+  for (size_t i = 0; i < COUNT; i++) worst = std::max(worst, difference(out.get(i), expected[i]));
+  print("nlerp", worst, glmSeconds, batchSeconds);
+
+  std::vector<glm::mat4> matrices(COUNT), expectedMatrices(COUNT);
+  glmSeconds = timed([&] { for (size_t i = 0; i < COUNT; i++) expectedMatrices[i] = glm::mat4_cast(a[i]); });
+  batchSeconds = timed([&] { toMat4Batch(sa, matrices.data()); });
+  worst = 0.0f;
+  for (size_t i = 0; i < COUNT; i++) worst = std::max(worst, difference(matrices[i], expectedMatrices[i]));
+  print("mat4_cast", worst, glmSeconds, batchSeconds);
+}
+
+// a skeleton of BONES dual quaternions, every vertex blended from up to four
+static void skinning(Pcg32 &rng)
+{
+  std::vector<glm::dualquat> bones(BONES);
+  DualQuatSoA boneSoA;
+  for (size_t b = 0; b < BONES; b++) {
+    glm::quat rotation = randomRotation(rng);
+    glm::vec3 translation = linearRand(rng, glm::vec3(-2.0f), glm::vec3(2.0f));
+    bones[b] = glm::dualquat(rotation, translation);
+    boneSoA.add(rotation, translation);
+  }
+
+  std::vector<glm::ivec4> influences(COUNT);
+  std::vector<glm::vec4> weights(COUNT);
+  std::vector<glm::vec3> positions(COUNT);
+  SkinInfluenceSoA skin;
+  Vec3SoA positionSoA;
+  for (size_t v = 0; v < COUNT; v++) {
+    glm::vec4 w(unitRand(rng), unitRand(rng), v % 3 ? unitRand(rng) : 0.0f, v % 2 ? unitRand(rng) : 0.0f);
+    weights[v] = w / (w.x + w.y + w.z + w.w);
+    for (int k = 0; k < 4; k++) influences[v][k] = (int)(rng.nextUInt() % BONES);
+    positions[v] = linearRand(rng, glm::vec3(-1.0f), glm::vec3(1.0f));
+    skin.add(influences[v], weights[v]);
+    positionSoA.add(positions[v]);
+  }
+
+  std::vector<glm::dualquat> blended(COUNT);
+  double glmSeconds = timed([&] {
+    for (size_t v = 0; v < COUNT; v++) {
+      const glm::dualquat &pivot = bones[influences[v].x];
+      glm::dualquat sum = pivot * weights[v].x;
+      for (int k = 1; k < 4; k++) {
+        const glm::dualquat &bone = bones[influences[v][k]];
+        float w = glm::dot(bone.real, pivot.real) < 0.0f ? -weights[v][k] : weights[v][k];
+        sum = sum + bone * w;
+      }
+      blended[v] = glm::normalize(sum);
+    }
+  });
+  DualQuatSoA blendedSoA;
+  double batchSeconds = timed([&] { blendDualQuatsBatch(boneSoA, skin, blendedSoA); });
+  float worst = 0.0f;
+  for (size_t v = 0; v < COUNT; v++) {
+    worst = std::max(worst, difference(blendedSoA.real.get(v), blended[v].real));
+    worst = std::max(worst, difference(blendedSoA.dual.get(v), blended[v].dual));
+  }
+  print("dual quaternion blend", worst, glmSeconds, batchSeconds);
+
+  std::vector<glm::vec3> skinned(COUNT);
+  glmSeconds = timed([&] { for (size_t v = 0; v < COUNT; v++) skinned[v] = blended[v] * positions[v]; });
+  Vec3SoA skinnedSoA;
+  batchSeconds = timed([&] { skinPositionsBatch(blendedSoA, positionSoA, skinnedSoA); });
+  worst = 0.0f;
+  for (size_t v = 0; v < COUNT; v++)
+    worst = std::max(worst, glm::length(skinnedSoA.get(v) - skinned[v]));
+  print("skin positions", worst, glmSeconds, batchSeconds);
+
+  // the rotation of mat4_cast plus the dual quaternion's translation
+  std::vector<glm::mat4> matrices(COUNT), expected(COUNT);
+  glmSeconds = timed([&] {
+    for (size_t v = 0; v < COUNT; v++) {
+      expected[v] = glm::mat4_cast(blended[v].real);
+      expected[v][3] = glm::vec4(blended[v] * glm::vec3(0.0f), 1.0f);
+    }
+  });
+  batchSeconds = timed([&] { toMat4Batch(blendedSoA, matrices.data()); });
+  worst = 0.0f;
+  for (size_t v = 0; v < COUNT; v++) worst = std::max(worst, difference(matrices[v], expected[v]));
+  print("dual quaternion mat4", worst, glmSeconds, batchSeconds);
+}
+
+int main()
+{
+  printSimd();
+  Pcg32 rng(29, 1);
+  interpolation(rng);
+  skinning(rng);
+  return 0;
+}
@@ -0,0 +1,176 @@
+#include "../replay.h"
+#include "../game.h"
+#include "../random.h"
+#include "bench.h"
+
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+// Replay check, built with `make bench`: a bot match is recorded with the
+// state of every tick kept aside, then played back: from the start, and
+// seeking to, before and after every keyframe. Every state must come back
+// bit for bit. Fast-forward and seeking are timed against stepping the same
+// inputs with stepGame(), and damaged files must be refused by load().
+
+static const char *REPLAY_PATH = "replay_bench.replay";
+static const float STEP = 1.0f / 120.0f;
+static const uint32_t TICKS = 120 * 600; // ten minutes
+static const uint32_t KEYFRAME_INTERVAL = 600;
+
+// follows the ball, sometimes twitching so the inputs keep changing
+static PaddleInput bot(const GameConfig &config, const GameState &state, int side, Pcg32 &rng)
+{
+  PaddleInput input = trackBall(config, state, side);
+  if (rng.nextUInt() % 64 == 0) input.move = (int8_t)(rng.nextUInt() % 3) - 1;
+  return input;
+}
+
+static bool same(const GameState &a, const GameState &b)
+{
+  return memcmp(&a, &b, sizeof(GameState)) == 0;
+}
+
+static std::vector<uint8_t> readAll(const char *path)
+{
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void writeAll(const char *path, const std::vector<uint8_t> &bytes)
+{
+  std::ofstream file(path, std::ios::out | std::ios::binary);
+  file.write((const char *)&bytes[0], bytes.size());
+}
+
+static void putU32(std::vector<uint8_t> &bytes, size_t offset, uint32_t value)
+{
+  for (int i = 0; i < 4; i++) bytes[offset + i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint32_t getU32(const std::vector<uint8_t> &bytes, size_t offset)
+{
+  return (uint32_t)bytes[offset] | (uint32_t)bytes[offset + 1] << 8 | (uint32_t)bytes[offset + 2] << 16 |
+         (uint32_t)bytes[offset + 3] << 24;
+}
+
+// true when load() refuses the file, as it must
+static bool refused(const char *name, const std::vector<uint8_t> &bytes)
+{
+  writeAll(REPLAY_PATH, bytes);
+  ReplayPlayer player;
+  printf("  %-32s ", name);
+  fflush(stdout);
+  bool ok = !player.load(REPLAY_PATH);
+  if (!ok) printf("LOADED\n");
+  return ok;
+}
+
+int main()
+{
+  // the match, states[t] at the start of tick t
+  GameConfig config;
+  GameState state;
+  resetGame(config, state, 5u);
+  std::vector<GameState> states(TICKS + 1);
+  std::vector<PaddleInput> inputs(TICKS * 2);
+  Pcg32 rng(6u, 1u);
+  ReplayWriter writer;
+  if (!writer.open(REPLAY_PATH, config, 5u, STEP, KEYFRAME_INTERVAL)) return 1;
+  for (uint32_t t = 0; t < TICKS; t++) {
+    PaddleInput input[2] = {bot(config, state, 0, rng), bot(config, state, 1, rng)};
+    states[t] = state;
+    inputs[t * 2] = input[0];
+    inputs[t * 2 + 1] = input[1];
+    writer.record(state, input);
+    stepGame(config, state, input, STEP);
+  }
+  states[TICKS] = state;
+  writer.close();
+  size_t fileSize = writer.size();
+  printf("%u ticks at %.0f Hz, a keyframe every %u: %zu bytes (%.2f a tick, states alone %zu bytes)\n", TICKS,
+         1.0f / STEP, KEYFRAME_INTERVAL, fileSize, (double)fileSize / TICKS, (size_t)TICKS * sizeof(GameState));
+
+  ReplayPlayer player;
+  if (!player.load(REPLAY_PATH) || player.tickCount != TICKS) {
+    printf("LOAD FAILED\n");
+    return 1;
+  }
+
+  // every tick from the start
+  int mismatches = 0;
+  player.seek(0);
+  for (uint32_t t = 0; t <= TICKS; t++) {
+    if (player.currentTick() != t || !same(player.current(), states[t])) mismatches++;
+    player.advance(1);
+  }
+  printf("played through: %d / %u states differ\n", mismatches, TICKS + 1);
+
+  // around every keyframe, and on across the next one
+  int seeks = 0, seekMismatches = 0;
+  for (uint32_t k = 0; k * KEYFRAME_INTERVAL <= TICKS; k++) {
+    for (int d = -1; d <= 1; d++) {
+      uint32_t target = k * KEYFRAME_INTERVAL + d;
+      if ((d < 0 && k == 0) || target > TICKS) continue;
+      seeks++;
+      bool ok = player.seek(target) && same(player.current(), states[target]);
+      for (uint32_t t = target + 1; ok && t <= target + KEYFRAME_INTERVAL + 1 && t <= TICKS; t++) {
+        player.advance(1);
+        ok = same(player.current(), states[t]);
+      }
+      if (!ok) seekMismatches++;
+    }
+  }
+  player.seek(TICKS + 100);
+  bool end = player.currentTick() == TICKS && same(player.current(), states[TICKS]) && player.finished();
+  printf("seeks around keyframes: %d / %d differ, past the end %s\n", seekMismatches, seeks,
+         end ? "stops on the last tick" : "WRONG");
+
+  // fast-forward against the same steps without the file
+  GameState stepped;
+  double stepSeconds = timed([&] {
+    stepped = states[0];
+    for (uint32_t t = 0; t < TICKS; t++) stepGame(config, stepped, &inputs[t * 2], STEP);
+  }, 5);
+  double playSeconds = timed([&] {
+    player.seek(0);
+    player.advance(TICKS);
+  }, 5);
+  printf("fast-forward %.1fM ticks/s, ", TICKS / playSeconds * 1e-6);
+  printSpeedup("stepGame", stepSeconds, "replay", playSeconds, TICKS, "a tick");
+
+  Pcg32 seekRng(7u, 1u);
+  const int SEEKS = 200;
+  double seekSeconds = timed([&] { player.seek(seekRng.nextUInt() % (TICKS + 1)); }, SEEKS);
+  printf("random seek %.1f us (decodes up to %u keyframes, steps up to %u ticks)\n", seekSeconds * 1e6,
+         TICKS / KEYFRAME_INTERVAL + 1, KEYFRAME_INTERVAL - 1);
+
+  // damaged files
+  std::vector<uint8_t> bytes = readAll(REPLAY_PATH);
+  size_t footer = bytes.size() - 4;
+  uint32_t indexOffset = getU32(bytes, footer);
+  printf("damaged files:\n");
+  bool refusals = true;
+  std::vector<uint8_t> bad = bytes;
+  putU32(bad, footer, 0xFFFFFFFCu); // + 8 wraps in 32 bits
+  refusals = refused("index offset near 2^32", bad) && refusals;
+  bad = bytes;
+  putU32(bad, indexOffset + 4, 0x20000000u); // * 8 wraps in 32 bits
+  refusals = refused("keyframe count near 2^29", bad) && refusals;
+  bad = bytes;
+  putU32(bad, indexOffset + 12 + 8, indexOffset + 100); // second keyframe past the records
+  refusals = refused("keyframe offset in the index", bad) && refusals;
+  bad = bytes;
+  putU32(bad, indexOffset + 12, 4); // first keyframe in the header
+  refusals = refused("keyframe offset in the header", bad) && refusals;
+  bad = bytes;
+  putU32(bad, indexOffset + 8 + 8, 0); // second keyframe before the first
+  refusals = refused("keyframe ticks out of order", bad) && refusals;
+  bad.assign(bytes.begin(), bytes.begin() + bytes.size() / 2);
+  refusals = refused("truncated", bad) && refusals;
+  std::remove(REPLAY_PATH);
+
+  return mismatches || seekMismatches || !end || !refusals ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+#include "../sdf_font.h"
+#include "../thread_pool.h"
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+// SDF font benchmark, built with `make bench`: generating the atlas on this
+// thread and over the pool, checked to give the same texels, against reading
+// it back from the cache.
+
+static const char *CACHE_PATH = "sdf_bench.sdf";
+
+int main()
+{
+  const int REPEATS = 20;
+  SdfFont serial;
+  double best = 1e9;
+  for (int r = 0; r < REPEATS; r++) {
+    serial.generate();
+    best = std::min(best, serial.stats.generateMs);
+  }
+  printf("%-26s %7.2f ms (%dx%d atlas)\n", "generate, this thread", best, serial.width, serial.height);
+
+  ThreadPool pool;
+  SdfFont parallel;
+  best = 1e9;
+  for (int r = 0; r < REPEATS; r++) {
+    parallel.generate(&pool);
+    best = std::min(best, parallel.stats.generateMs);
+  }
+  char name[64];
+  snprintf(name, sizeof(name), "generate, %u workers + this", pool.size());
+  printf("%-26s %7.2f ms, %s\n", name, best, parallel.texels == serial.texels ? "same texels" : "TEXELS DIFFER");
+
+  if (!serial.save(CACHE_PATH)) return 1;
+  SdfFont cached;
+  double seconds = timed([&] { cached.load(CACHE_PATH); }, REPEATS);
+  std::remove(CACHE_PATH);
+  printf("%-26s %7.2f ms, %s\n", "load from cache", seconds * 1e3,
+         cached.stats.fromCache && cached.texels == serial.texels ? "same texels" : "CACHE MISMATCH");
+  return 0;
+}
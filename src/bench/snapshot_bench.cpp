@@ -0,0 +1,82 @@
+#include "../snapshot_codec.h"
+#include "../game.h"
+#include "bench.h"
+
+#include <vector>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+// Snapshot codec benchmark, built with `make bench`: encode / decode
+// throughput and bytes per snapshot, against the raw GameState.
+
+static const int MATCHES = 1000;
+static const int TICKS = 1000;
+
+int main()
+{
+    // match histories, [match][tick]
+    GameConfig config;
+    std::vector<GameState> states((size_t)MATCHES * TICKS);
+    for (int m = 0; m < MATCHES; m++) {
+      GameState state;
+      resetGame(config, state, (uint32_t)m + 1u);
+      for (int t = 0; t < TICKS; t++) {
+        PaddleInput input[2] = {trackBall(config, state, 0), trackBall(config, state, 1)};
+        stepGame(config, state, input, 1.0f / 60.0f);
+        states[(size_t)m * TICKS + t] = state;
+      }
+    }
+
+    SnapshotCodec codec;
+    const size_t count = states.size();
+    std::vector<QuantizedState> quantized(count);
+    std::vector<uint8_t> packets(count * codec.maxEncodedSize());
+    std::vector<size_t> sizes(count);
+
+    // base distances: none, the previous tick, ~100 ms of round trip at 60 Hz
+    const int distances[] = {0, 1, 6};
+    printf("%d snapshots, raw GameState %d bytes\n", (int)count, (int)sizeof(GameState));
+    for (int d = 0; d < 3; d++) {
+      int distance = distances[d];
+
+      BenchClock::time_point start = BenchClock::now();
+      size_t bytes = 0;
+      for (size_t i = 0; i < count; i++) {
+        codec.quantize(states[i], quantized[i]);
+        const QuantizedState *base = distance && (int)(i % TICKS) >= distance ? &quantized[i - distance] : NULL;
+        sizes[i] = codec.encode(quantized[i], base, &packets[i * codec.maxEncodedSize()], codec.maxEncodedSize());
+        bytes += sizes[i];
+      }
+      double encodeTime = secondsSince(start);
+
+      start = BenchClock::now();
+      std::vector<QuantizedState> decoded(count);
+      std::vector<GameState> restored(count);
+      int failures = 0;
+      for (size_t i = 0; i < count; i++) {
+        const QuantizedState *base = distance && (int)(i % TICKS) >= distance ? &decoded[i - distance] : NULL;
+        if (!codec.decode(&packets[i * codec.maxEncodedSize()], sizes[i], base, decoded[i])) failures++;
+        decoded[i].tick = quantized[i].tick;
+        codec.dequantize(decoded[i], restored[i]);
+      }
+      double decodeTime = secondsSince(start);
+
+      float maxError = 0.0f;
+      for (size_t i = 0; i < count; i++) {
+        if (memcmp(decoded[i].values, quantized[i].values, sizeof(decoded[i].values)) != 0) failures++;
+        maxError = std::max(maxError, std::fabs(restored[i].ball.x - states[i].ball.x));
+        maxError = std::max(maxError, std::fabs(restored[i].ball.y - states[i].ball.y));
+        maxError = std::max(maxError, std::fabs(restored[i].paddleY[0] - states[i].paddleY[0]));
+      }
+
+      printf("base %-9s %6.2f bytes/snapshot (%4.1f%% of raw), encode %6.1f ns %7.1f MB/s, "
+             "decode %6.1f ns %7.1f MB/s, position error %.6f, %d mismatches\n",
+             distance ? (distance == 1 ? "previous" : "6 ticks") : "none", (double)bytes / count,
+             100.0 * bytes / count / sizeof(GameState), encodeTime / count * 1e9,
+             count * sizeof(GameState) / encodeTime / 1e6, decodeTime / count * 1e9,
+             count * sizeof(GameState) / decodeTime / 1e6, maxError, failures);
+    }
+    return 0;
+}
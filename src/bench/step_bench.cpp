@@ -0,0 +1,96 @@
+#include "../game.h"
+#include "../ai.h"
+#include "bench.h"
+
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+// Match stepping benchmark, built with `make bench`: stepGames() against a
+// loop of stepGame() over the same matches, both bit for bit the same
+// (compared every tick). The paddles are played by AiBatch as on the match
+// server: how the bots play changes the cost of a step a lot, with the
+// simple trackBall() bots a float8 stepGames() once looked faster while it
+// was slower for the server. stepGames() is that loop today; a batched
+// version has to beat it in both layouts: states packed together as in
+// batched self-play (ai_bench), and inside the bigger per-match records of
+// the match server.
+
+static const int MATCHES = 10000;
+static const int TICKS = 600;
+static const float STEP = 1.0f / 60.0f;
+
+struct Packed {
+  GameState state;
+  PaddleInput input[2];
+};
+
+struct ServerRecord {
+  GameState state;
+  PaddleInput input[2];
+  char rest[192]; // what else a server keeps per match: clients, snapshot history
+};
+
+// false when the two disagree
+template <typename Match>
+static bool run(const char *layout)
+{
+  GameConfig config;
+  std::vector<Match> scalar(MATCHES), batched(MATCHES);
+  std::vector<GameState *> states(MATCHES);
+  std::vector<const PaddleInput *> inputs(MATCHES);
+  // hard against normal, one batch a side and a world, seat m for match m
+  AiBatch bots[2][2] = {{AiBatch(AiSettings::hard()), AiBatch(AiSettings::normal())},
+                        {AiBatch(AiSettings::hard()), AiBatch(AiSettings::normal())}};
+  for (int w = 0; w < 2; w++) {
+    for (int side = 0; side < 2; side++) {
+      bots[w][side].resize(MATCHES);
+      for (int m = 0; m < MATCHES; m++) bots[w][side].reset(m, (uint32_t)(side * MATCHES + m));
+    }
+  }
+  for (int m = 0; m < MATCHES; m++) {
+    resetGame(config, scalar[m].state, (uint32_t)m + 1u);
+    batched[m].state = scalar[m].state;
+    states[m] = &batched[m].state;
+    inputs[m] = batched[m].input;
+  }
+
+  double scalarSeconds = 0.0, batchedSeconds = 0.0;
+  int differ = 0;
+  for (int t = 0; t < TICKS; t++) {
+    for (int side = 0; side < 2; side++) {
+      for (int m = 0; m < MATCHES; m++) {
+        bots[0][side].observe(m, config, scalar[m].state, side);
+        bots[1][side].observe(m, config, batched[m].state, side);
+      }
+      bots[0][side].decide(config, STEP);
+      bots[1][side].decide(config, STEP);
+      for (int m = 0; m < MATCHES; m++) {
+        scalar[m].input[side] = bots[0][side].input(m);
+        batched[m].input[side] = bots[1][side].input(m);
+      }
+    }
+    BenchClock::time_point start = BenchClock::now();
+    for (int m = 0; m < MATCHES; m++) stepGame(config, scalar[m].state, scalar[m].input, STEP);
+    scalarSeconds += secondsSince(start);
+    start = BenchClock::now();
+    stepGames(config, states.data(), inputs.data(), MATCHES, STEP);
+    batchedSeconds += secondsSince(start);
+    for (int m = 0; m < MATCHES; m++)
+      if (memcmp(&scalar[m].state, &batched[m].state, sizeof(GameState)) != 0) differ++;
+  }
+
+  printf("%-14s (%3zu bytes a match), %d states differ: ", layout, sizeof(Match), differ);
+  printSpeedup("stepGame loop", scalarSeconds, "stepGames", batchedSeconds, (double)MATCHES * TICKS,
+               "a match-tick");
+  return differ == 0;
+}
+
+int main()
+{
+  printSimd();
+  printf("%d bot matches, %d ticks at %.0f Hz\n", MATCHES, TICKS, 1.0f / STEP);
+  bool ok = run<Packed>("packed");
+  ok = run<ServerRecord>("server records") && ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <vector>
+#include <cstddef>
+
+#include "glm/glm.hpp"
+
+// Structure-of-arrays primitive sets for the batched kernels (see simd.h).
+//
+// Every component array is padded with zeros to a multiple of 8 so a kernel
+// can always load a full group; the padding lanes are masked off with
+// mask8::firstLanes().
+template <int N>
+struct SoAArrays {
+    std::vector<float> data[N];
+    size_t count = 0;
+
+    void push(const float (&values)[N]) {
+        if (count % 8 == 0)
+            for (int k = 0; k < N; k++) data[k].resize(count + 8, 0.0f);
+        for (int k = 0; k < N; k++) data[k][count] = values[k];
+        count++;
+    }
+    void clear() {
+        for (int k = 0; k < N; k++) data[k].clear();
+        count = 0;
+    }
+    // for output sets: new elements are zero
+    void resize(size_t n) {
+        for (int k = 0; k < N; k++) data[k].resize((n + 7) / 8 * 8, 0.0f);
+        count = n;
+    }
+    size_t size() const { return count; }
+    size_t groups() const { return (count + 7) / 8; }
+    const float *operator[](int k) const { return data[k].data(); }
+    float *operator[](int k) { return data[k].data(); }
+};
+
+struct SphereSoA : SoAArrays<4> {
+    enum { X, Y, Z, R };
+    void add(const glm::vec3 &center, float radius) {
+        push({center.x, center.y, center.z, radius});
+    }
+};
+
+struct AabbSoA : SoAArrays<6> {
+    enum { MIN_X, MIN_Y, MIN_Z, MAX_X, MAX_Y, MAX_Z };
+    void add(const glm::vec3 &min, const glm::vec3 &max) {
+        push({min.x, min.y, min.z, max.x, max.y, max.z});
+    }
+};
+
+// stored as one vertex plus the two edges, which is what Moller-Trumbore uses
+struct TriangleSoA : SoAArrays<9> {
+    enum { V0_X, V0_Y, V0_Z, E1_X, E1_Y, E1_Z, E2_X, E2_Y, E2_Z };
+    void add(const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2) {
+        glm::vec3 e1 = v1 - v0;
+        glm::vec3 e2 = v2 - v0;
+        push({v0.x, v0.y, v0.z, e1.x, e1.y, e1.z, e2.x, e2.y, e2.z});
+    }
+};
+
+// 2D segments, e.g. arena walls and obstacle edges
+struct SegmentSoA : SoAArrays<4> {
+    enum { A_X, A_Y, B_X, B_Y };
+    void add(const glm::vec2 &a, const glm::vec2 &b) {
+        push({a.x, a.y, b.x, b.y});
+    }
+};
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+#include "glm/glm.hpp"
+
+// Broadphase for arenas with many moving bodies: which 2D boxes overlap.
+//
+// Space is cut into square cells of `cellSize` and every body is entered in
+// each cell its box touches. Cells are hashed to a key in a table sized to
+// the entry count, and the entries (key, body, cell) are kept in one flat
+// array sorted by key, so the bodies sharing a cell sit next to each other
+// and a pair search is a linear walk with small n^2 runs.
+//
+// The array is maintained incrementally: a body that moves but stays over
+// the same cells (most of them, most ticks) keeps its entries. Only the
+// entries of bodies that changed cells are rebuilt: the old ones are filtered
+// out (which keeps the order), the new ones are radix sorted and merged in.
+// When a large part of the bodies changed, or the table has to grow, it is
+// all rebuilt and radix sorted at once.
+//
+// Two boxes can share several cells. A pair is only reported from the cell
+// holding the min corner of their overlap, so the pair list has no
+// duplicates without sorting it; hash collisions (two cells, one key) are
+// told apart by the cell stored in the entry.
+//
+// Pick the cell size around the size of a typical body: much smaller and
+// bodies take many entries, much larger and cells hold many bodies.
+
+struct BroadPair {
+    uint32_t a, b; // a < b
+};
+
+class SpatialHash {
+
+public:
+    // as of the last findPairs()
+    struct Stats {
+        size_t entries = 0;
+        size_t rebuiltEntries = 0; // entries regenerated for the bodies that changed cells
+        bool fullRebuild = false;
+        size_t cellTests = 0;      // pairs of entries looked at
+    };
+    Stats stats;
+
+    explicit SpatialHash(float cellSize = 1.0f)
+        : cellSize(cellSize), inverseCell(1.0f / cellSize), tableBits(MIN_TABLE_BITS), liveBodies(0) {}
+
+    size_t size() const { return liveBodies; }
+
+    // returns the body id, ids of removed bodies are reused
+    uint32_t add(const glm::vec2 &min, const glm::vec2 &max) {
+        uint32_t id;
+        if (!freeIds.empty()) {
+            id = freeIds.back();
+            freeIds.pop_back();
+        } else {
+            id = (uint32_t)mins.size();
+            mins.push_back(min);
+            maxs.push_back(max);
+            cells.push_back(glm::ivec4(0, 0, -1, -1));
+            dirty.push_back(0);
+        }
+        liveBodies++;
+        move(id, min, max);
+        return id;
+    }
+
+    void move(uint32_t id, const glm::vec2 &min, const glm::vec2 &max) {
+        mins[id] = min;
+        maxs[id] = max;
+        glm::ivec4 range(cellOf(min.x), cellOf(min.y), cellOf(max.x), cellOf(max.y));
+        if (range != cells[id]) {
+            markDirty(id);
+            cells[id] = range;
+        }
+    }
+
+    void remove(uint32_t id) {
+        markDirty(id);
+        cells[id] = glm::ivec4(0, 0, -1, -1);
+        freeIds.push_back(id);
+        liveBodies--;
+    }
+
+    // every overlapping pair once, in no particular order
+    void findPairs(std::vector<BroadPair> &pairs) {
+        update();
+        pairs.clear();
+        size_t tests = 0;
+        const size_t count = entries.size();
+        for (size_t begin = 0; begin < count;) {
+            size_t end = begin + 1;
+            while (end < count && entries[end].key == entries[begin].key) end++;
+            for (size_t i = begin; i < end; i++) {
+                const Entry &first = entries[i];
+                for (size_t j = i + 1; j < end; j++) {
+                    const Entry &second = entries[j];
+                    tests++;
+                    if (first.x != second.x || first.y != second.y) continue; // a hash collision
+                    uint32_t a = first.body, b = second.body;
+                    // reported by the cell of the overlap's min corner only
+                    if (glm::max(cells[a].x, cells[b].x) != first.x || glm::max(cells[a].y, cells[b].y) != first.y)
+                        continue;
+                    if (!overlaps(a, b)) continue;
+                    BroadPair pair = {a < b ? a : b, a < b ? b : a};
+                    pairs.push_back(pair);
+                }
+            }
+            begin = end;
+        }
+        stats.cellTests = tests;
+    }
+
+private:
+    struct Entry {
+        uint32_t key;
+        uint32_t body;
+        int32_t x, y; // the cell, keys can collide
+    };
+
+    static const int MIN_TABLE_BITS = 8;
+    static const int MAX_TABLE_BITS = 24;
+    static const int RADIX_BITS = 11;
+
+    float cellSize, inverseCell;
+    int tableBits;
+    size_t liveBodies;
+
+    std::vector<glm::vec2> mins, maxs;
+    std::vector<glm::ivec4> cells;     // min x, min y, max x, max y, empty for removed ids
+    std::vector<uint8_t> dirty;        // cells changed since the last update
+    std::vector<uint32_t> dirtyBodies;
+    std::vector<uint32_t> freeIds;
+    std::vector<Entry> entries, fresh, scratch;
+    std::vector<uint32_t> histogram;
+
+    int32_t cellOf(float x) const { return (int32_t)std::floor(x * inverseCell); }
+
+    uint32_t keyOf(int32_t x, int32_t y) const {
+        return ((uint32_t)x * 0x9E3779B1u ^ (uint32_t)y * 0x85EBCA77u) >> (32 - tableBits);
+    }
+
+    bool overlaps(uint32_t a, uint32_t b) const {
+        return mins[a].x <= maxs[b].x && mins[b].x <= maxs[a].x && mins[a].y <= maxs[b].y && mins[b].y <= maxs[a].y;
+    }
+
+    void markDirty(uint32_t id) {
+        if (dirty[id]) return;
+        dirty[id] = 1;
+        dirtyBodies.push_back(id);
+    }
+
+    size_t cellCount(uint32_t id) const {
+        const glm::ivec4 &range = cells[id];
+        return range.z < range.x ? 0 : (size_t)(range.z - range.x + 1) * (size_t)(range.w - range.y + 1);
+    }
+
+    void appendEntries(uint32_t id, std::vector<Entry> &out) const {
+        const glm::ivec4 &range = cells[id];
+        for (int32_t y = range.y; y <= range.w; y++) {
+            for (int32_t x = range.x; x <= range.z; x++) {
+                Entry entry = {keyOf(x, y), id, x, y};
+                out.push_back(entry);
+            }
+        }
+    }
+
+    // about two table slots per entry
+    static int bitsFor(size_t entryCount) {
+        int bits = MIN_TABLE_BITS;
+        while (bits < MAX_TABLE_BITS && ((size_t)1 << bits) < entryCount * 2) bits++;
+        return bits;
+    }
+
+    void update() {
+        stats.fullRebuild = false;
+        stats.rebuiltEntries = 0;
+        if (!dirtyBodies.empty()) {
+            // the changed bodies' old entries count twice, close enough to size the table
+            size_t estimate = entries.size();
+            for (size_t i = 0; i < dirtyBodies.size(); i++) estimate += cellCount(dirtyBodies[i]);
+            // sized for two slots an entry, resized past one or under 1/8
+            size_t slots = (size_t)1 << tableBits;
+            int bits = bitsFor(estimate);
+            bool rehash = bits != tableBits && (estimate > slots || estimate * 8 < slots);
+            if (rehash) tableBits = bits;
+
+            if (rehash || dirtyBodies.size() * 4 > liveBodies) {
+                entries.clear();
+                for (uint32_t id = 0; id < (uint32_t)cells.size(); id++) appendEntries(id, entries);
+                radixSort(entries);
+                stats.fullRebuild = true;
+                stats.rebuiltEntries = entries.size();
+            } else {
+                size_t kept = 0;
+                for (size_t i = 0; i < entries.size(); i++) {
+                    if (!dirty[entries[i].body]) entries[kept++] = entries[i];
+                }
+                entries.resize(kept);
+                fresh.clear();
+                for (size_t i = 0; i < dirtyBodies.size(); i++) appendEntries(dirtyBodies[i], fresh);
+                radixSort(fresh);
+                merge();
+                stats.rebuiltEntries = fresh.size();
+            }
+            for (size_t i = 0; i < dirtyBodies.size(); i++) dirty[dirtyBodies[i]] = 0;
+            dirtyBodies.clear();
+        }
+        stats.entries = entries.size();
+    }
+
+    // LSD radix sort on the key, RADIX_BITS per pass
+    void radixSort(std::vector<Entry> &items) {
+        const size_t count = items.size();
+        if (count < 2) return;
+        scratch.resize(count);
+        histogram.resize((size_t)1 << RADIX_BITS);
+        const uint32_t mask = (1u << RADIX_BITS) - 1u;
+        for (int shift = 0; shift < tableBits; shift += RADIX_BITS) {
+            std::fill(histogram.begin(), histogram.end(), 0u);
+            for (size_t i = 0; i < count; i++) histogram[(items[i].key >> shift) & mask]++;
+            uint32_t offset = 0;
+            for (size_t d = 0; d < histogram.size(); d++) {
+                uint32_t n = histogram[d];
+                histogram[d] = offset;
+                offset += n;
+            }
+            for (size_t i = 0; i < count; i++) scratch[histogram[(items[i].key >> shift) & mask]++] = items[i];
+            items.swap(scratch);
+        }
+    }
+
+    // entries and fresh are both sorted, the result goes to entries
+    void merge() {
+        scratch.resize(entries.size() + fresh.size());
+        size_t i = 0, j = 0, k = 0;
+        while (i < entries.size() && j < fresh.size())
+            scratch[k++] = fresh[j].key < entries[i].key ? fresh[j++] : entries[i++];
+        while (i < entries.size()) scratch[k++] = entries[i++];
+        while (j < fresh.size()) scratch[k++] = fresh[j++];
+        entries.swap(scratch);
+    }
+
+    SpatialHash(const SpatialHash &);
+    SpatialHash &operator=(const SpatialHash &);
+};
+
+#endif
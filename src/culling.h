@@ -0,0 +1,250 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <utility>
+#include <algorithm>
+
+#include "glm/glm.hpp"
+
+#include "simd.h"
+#include "bounds.h"
+
+// Visibility culling before draw submission.
+//
+// Objects are kept in SoA sets (bounds.h) and tested 8 at a time against
+// the view frustum or, for the 2D orthographic camera, against the visible
+// rectangle. The result is a compact list of the indices still visible.
+
+struct Frustum {
+    // a, b, c, d with (a, b, c) normalized, inside when dot(n, p) + d >= 0.
+    // left, right, bottom, top, near, far
+    glm::vec4 planes[6];
+
+    // Gribb & Hartmann extraction from a glm (OpenGL clip space) view-projection
+    static Frustum fromMatrix(const glm::mat4 &viewProj) {
+        glm::vec4 row[4];
+        for (int i = 0; i < 4; i++)
+            row[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+        Frustum f;
+        f.planes[0] = row[3] + row[0];
+        f.planes[1] = row[3] - row[0];
+        f.planes[2] = row[3] + row[1];
+        f.planes[3] = row[3] - row[1];
+        f.planes[4] = row[3] + row[2];
+        f.planes[5] = row[3] - row[2];
+        for (int p = 0; p < 6; p++)
+            f.planes[p] /= glm::length(glm::vec3(f.planes[p]));
+        return f;
+    }
+};
+
+enum CullResult { CULL_OUTSIDE, CULL_INTERSECTS, CULL_INSIDE };
+
+// single box test, used for grid cells
+inline CullResult classifyAabb(const Frustum &f, const glm::vec3 &min, const glm::vec3 &max) {
+    CullResult result = CULL_INSIDE;
+    for (int p = 0; p < 6; p++) {
+        glm::vec3 n(f.planes[p]);
+        glm::vec3 positive = glm::mix(min, max, glm::greaterThan(n, glm::vec3(0.0f)));
+        glm::vec3 negative = glm::mix(max, min, glm::greaterThan(n, glm::vec3(0.0f)));
+        if (glm::dot(n, positive) + f.planes[p].w < 0.0f) return CULL_OUTSIDE;
+        if (glm::dot(n, negative) + f.planes[p].w < 0.0f) result = CULL_INTERSECTS;
+    }
+    return result;
+}
+
+// appends base + lane for every set lane of `bits`, mapped through remap if given
+inline void appendLanes(int bits, size_t base, std::vector<uint32_t> &out, const uint32_t *remap = NULL) {
+    for (int lane = 0; bits; lane++, bits >>= 1) {
+        if (bits & 1)
+            out.push_back(remap ? remap[base + lane] : (uint32_t)(base + lane));
+    }
+}
+
+// Boxes [begin, end) of `boxes`; begin must be a multiple of 8, or the
+// arrays must go on for a full group past end. Visible indices are mapped
+// through `remap` when given.
+inline void cullAabbRange(const Frustum &f, const AabbSoA &boxes, size_t begin, size_t end,
+                          std::vector<uint32_t> &visible, const uint32_t *remap = NULL) {
+    const float8 zero = float8::broadcast(0.0f);
+    for (size_t i = begin; i < end; i += 8) {
+        mask8 inside = mask8::firstLanes(end - i);
+        for (int p = 0; p < 6 && inside.any(); p++) {
+            const glm::vec4 &pl = f.planes[p];
+            // the box corner furthest along the normal is picked per plane,
+            // so it is a choice of array rather than a per-lane select
+            float8 x = float8::load(boxes[pl.x > 0.0f ? AabbSoA::MAX_X : AabbSoA::MIN_X] + i);
+            float8 y = float8::load(boxes[pl.y > 0.0f ? AabbSoA::MAX_Y : AabbSoA::MIN_Y] + i);
+            float8 z = float8::load(boxes[pl.z > 0.0f ? AabbSoA::MAX_Z : AabbSoA::MIN_Z] + i);
+            float8 dist = fmadd(x, float8::broadcast(pl.x),
+                          fmadd(y, float8::broadcast(pl.y),
+                          fmadd(z, float8::broadcast(pl.z), float8::broadcast(pl.w))));
+            inside = inside & (dist >= zero);
+        }
+        appendLanes(inside.bits(), i, visible, remap);
+    }
+}
+
+inline void cullAabbs(const Frustum &f, const AabbSoA &boxes, std::vector<uint32_t> &visible) {
+    cullAabbRange(f, boxes, 0, boxes.size(), visible);
+}
+
+inline void cullSpheres(const Frustum &f, const SphereSoA &spheres, std::vector<uint32_t> &visible) {
+    for (size_t i = 0; i < spheres.size(); i += 8) {
+        float8 x = float8::load(spheres[SphereSoA::X] + i);
+        float8 y = float8::load(spheres[SphereSoA::Y] + i);
+        float8 z = float8::load(spheres[SphereSoA::Z] + i);
+        float8 negR = -float8::load(spheres[SphereSoA::R] + i);
+        mask8 inside = mask8::firstLanes(spheres.size() - i);
+        for (int p = 0; p < 6 && inside.any(); p++) {
+            const glm::vec4 &pl = f.planes[p];
+            float8 dist = fmadd(x, float8::broadcast(pl.x),
+                          fmadd(y, float8::broadcast(pl.y),
+                          fmadd(z, float8::broadcast(pl.z), float8::broadcast(pl.w))));
+            inside = inside & (dist >= negR);
+        }
+        appendLanes(inside.bits(), i, visible);
+    }
+}
+
+// 2D fast path for the orthographic camera: screen aligned rectangles
+
+struct RectSoA : SoAArrays<4> {
+    enum { MIN_X, MIN_Y, MAX_X, MAX_Y };
+    void add(const glm::vec2 &min, const glm::vec2 &max) {
+        push({min.x, min.y, max.x, max.y});
+    }
+};
+
+// world rectangle seen by an orthographic view-projection (no rotation)
+inline void orthoViewRect(const glm::mat4 &viewProj, glm::vec2 &min, glm::vec2 &max) {
+    glm::mat4 inv = glm::inverse(viewProj);
+    glm::vec2 a(inv * glm::vec4(-1.0f, -1.0f, 0.0f, 1.0f));
+    glm::vec2 b(inv * glm::vec4(1.0f, 1.0f, 0.0f, 1.0f));
+    min = glm::min(a, b);
+    max = glm::max(a, b);
+}
+
+inline void cullRects(const glm::vec2 &viewMin, const glm::vec2 &viewMax, const RectSoA &rects,
+                      std::vector<uint32_t> &visible) {
+    const float8 vx0 = float8::broadcast(viewMin.x), vy0 = float8::broadcast(viewMin.y);
+    const float8 vx1 = float8::broadcast(viewMax.x), vy1 = float8::broadcast(viewMax.y);
+    for (size_t i = 0; i < rects.size(); i += 8) {
+        mask8 overlap = (float8::load(rects[RectSoA::MAX_X] + i) >= vx0) &
+                        (float8::load(rects[RectSoA::MIN_X] + i) <= vx1) &
+                        (float8::load(rects[RectSoA::MAX_Y] + i) >= vy0) &
+                        (float8::load(rects[RectSoA::MIN_Y] + i) <= vy1) &
+                        mask8::firstLanes(rects.size() - i);
+        appendLanes(overlap.bits(), i, visible);
+    }
+}
+
+// Two level grid for large scenes (one cell per court, say). Objects are
+// bucketed by the cell holding their centre on the XY plane; a cell whose
+// bounds are fully inside the frustum is accepted without testing its
+// objects, one fully outside is skipped, only the others go to the SIMD test.
+//
+// Only the cells holding objects exist: the objects are sorted by cell key
+// and each run of equal keys is a cell, so the memory is that of the objects
+// however far apart they are. Cell coordinates are clamped, far outliers
+// share the edge cells (whose bounds grow to hold them), and objects with a
+// NaN coordinate go to a catch-all cell. Cells whose bounds are not finite, the
+// catch-all one included, are always tested object by object.
+class CullingGrid {
+
+public:
+    float cellSize;
+
+    CullingGrid(float cellSize = 16.0f) : cellSize(cellSize) {}
+
+    // rebuild from scratch, object i of `boxes` keeps index i in the results
+    void build(const AabbSoA &boxes) {
+        const size_t count = boxes.size();
+        std::vector<std::pair<uint64_t, uint32_t> > order(count);
+        for (size_t i = 0; i < count; i++) order[i] = std::make_pair(cellKey(i, boxes), (uint32_t)i);
+        std::sort(order.begin(), order.end());
+
+        // cells packed back to back, they do not start on a group: one spare
+        // group at the end keeps the last loads inside the arrays
+        cells.clear();
+        sorted.resize(count + 8);
+        index.assign(count, 0u);
+        for (size_t slot = 0; slot < count; slot++) {
+            if (slot == 0 || order[slot].first != order[slot - 1].first) {
+                Cell cell;
+                cell.begin = slot;
+                cell.min = glm::vec3(INFINITY);
+                cell.max = glm::vec3(-INFINITY);
+                cells.push_back(cell);
+            }
+            Cell &cell = cells.back();
+            size_t i = order[slot].second;
+            glm::vec3 min(boxes[AabbSoA::MIN_X][i], boxes[AabbSoA::MIN_Y][i], boxes[AabbSoA::MIN_Z][i]);
+            glm::vec3 max(boxes[AabbSoA::MAX_X][i], boxes[AabbSoA::MAX_Y][i], boxes[AabbSoA::MAX_Z][i]);
+            sorted[AabbSoA::MIN_X][slot] = min.x;
+            sorted[AabbSoA::MIN_Y][slot] = min.y;
+            sorted[AabbSoA::MIN_Z][slot] = min.z;
+            sorted[AabbSoA::MAX_X][slot] = max.x;
+            sorted[AabbSoA::MAX_Y][slot] = max.y;
+            sorted[AabbSoA::MAX_Z][slot] = max.z;
+            index[slot] = (uint32_t)i;
+            cell.count++;
+            cell.min = glm::min(cell.min, min);
+            cell.max = glm::max(cell.max, max);
+        }
+        for (size_t c = 0; c < cells.size(); c++) {
+            Cell &cell = cells[c];
+            glm::vec3 extent = cell.max - cell.min;
+            cell.testObjects = !std::isfinite(extent.x + extent.y + extent.z) ||
+                               order[cell.begin].first == CATCH_ALL;
+        }
+    }
+
+    void cull(const Frustum &f, std::vector<uint32_t> &visible) const {
+        for (size_t c = 0; c < cells.size(); c++) {
+            const Cell &cell = cells[c];
+            CullResult r = cell.testObjects ? CULL_INTERSECTS : classifyAabb(f, cell.min, cell.max);
+            if (r == CULL_OUTSIDE) continue;
+            if (r == CULL_INSIDE) {
+                visible.insert(visible.end(), index.begin() + cell.begin, index.begin() + cell.begin + cell.count);
+                continue;
+            }
+            cullAabbRange(f, sorted, cell.begin, cell.begin + cell.count, visible, index.data());
+        }
+    }
+
+    size_t cellCount() const { return cells.size(); }
+
+private:
+    struct Cell {
+        size_t begin = 0;
+        size_t count = 0;
+        glm::vec3 min, max;
+        bool testObjects = false; // bounds not usable, no cell level test
+    };
+    std::vector<Cell> cells;
+    AabbSoA sorted;              // boxes grouped by cell
+    std::vector<uint32_t> index; // slot in `sorted` -> caller's index
+
+    // cell coordinates within +-2^30, offset to stay below the catch-all key
+    static const uint64_t CATCH_ALL = ~0ull;
+
+    uint64_t cellKey(size_t i, const AabbSoA &boxes) const {
+        const float LIMIT = 1073741824.0f;
+        float cx = 0.5f * (boxes[AabbSoA::MIN_X][i] + boxes[AabbSoA::MAX_X][i]);
+        float cy = 0.5f * (boxes[AabbSoA::MIN_Y][i] + boxes[AabbSoA::MAX_Y][i]);
+        float z = boxes[AabbSoA::MIN_Z][i] + boxes[AabbSoA::MAX_Z][i];
+        float x = std::floor(cx / cellSize), y = std::floor(cy / cellSize);
+        if (std::isnan(x) || std::isnan(y) || std::isnan(z)) return CATCH_ALL;
+        x = std::min(std::max(x, -LIMIT), LIMIT);
+        y = std::min(std::max(y, -LIMIT), LIMIT);
+        const int64_t offset = (int64_t)1 << 31;
+        return (uint64_t)((int64_t)y + offset) << 32 | (uint64_t)((int64_t)x + offset);
+    }
+};
+
+#endif
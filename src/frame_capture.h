@@ -0,0 +1,198 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+
+#include "frame_readback.h"
+#include "frame_writers.h"
+#include "yuv.h"
+
+// Captures rendered frames to disk without stalling the render loop.
+//
+//   render thread: glReadPixels into a ring of fenced PBOs (FrameReadback),
+//                  maps the copies the GPU has finished
+//   worker thread: converts / encodes straight from the mapped memory and
+//                  writes the file, then hands the buffer back for unmapping
+//
+// The output format follows the extension: ".y4m" is one YUV 4:2:0 stream
+// (SIMD conversion, see yuv.h), ".qoi" one image per frame, numbered
+// ("shot.qoi" -> "shot_000000.qoi", ...).
+//
+// When every buffer is busy capture() waits for the oldest one (counted in
+// stats.stalls), or drops the frame with dropWhenBusy. Raise `buffers` if
+// stalls show up: the worker has one frame time per buffer to keep up.
+class FrameCapture {
+
+public:
+    enum Format { CAPTURE_Y4M, CAPTURE_QOI };
+
+    struct Stats {
+        unsigned long captured = 0; // frames requested
+        unsigned long written = 0;  // by the worker, read it after finish()
+        unsigned long dropped = 0;
+        unsigned long stalls = 0;   // capture() had to wait for a buffer
+    };
+    Stats stats;
+
+    FrameCapture(const std::string &path, int width, int height, int fps = 60, int buffers = 4,
+                 bool dropWhenBusy = false)
+        : readback(width, height, buffers), path(path), format(formatOf(path)), dropWhenBusy(dropWhenBusy),
+          handed(0), completed(0), released(0), stopping(false), frameIndex(0) {
+        if (format == CAPTURE_Y4M) {
+            y4m.open(path, width, height, fps);
+            size_t chroma = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+            yuv.resize((size_t)width * height + 2 * chroma);
+        }
+        worker = std::thread(&FrameCapture::run, this);
+    }
+
+    ~FrameCapture() { finish(); }
+
+    static Format formatOf(const std::string &path) {
+        size_t dot = path.find_last_of('.');
+        std::string ext = dot == std::string::npos ? std::string() : path.substr(dot + 1);
+        return ext == "qoi" ? CAPTURE_QOI : CAPTURE_Y4M;
+    }
+
+    // render thread, once the frame is drawn into `framebuffer` (0 for the window)
+    void capture(GLuint framebuffer) {
+        if (stopping) return;
+        recycle(false);
+        handOver(false);
+
+        bool waited = false;
+        while (readback.full()) {
+            if (dropWhenBusy) {
+                stats.dropped++;
+                return;
+            }
+            if (!waited) stats.stalls++;
+            waited = true;
+            // the oldest copy is either still on the GPU or with the worker
+            if (readback.mapped() < readback.pending()) handOver(true);
+            else recycle(true);
+        }
+        readback.request(framebuffer, frameIndex++);
+        stats.captured++;
+    }
+
+    // render thread: writes the frames still in flight and closes the output
+    void finish() {
+        if (stopping) return;
+        while (readback.mapped() < readback.pending()) handOver(true);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+        recycle(false);
+        y4m.close();
+    }
+
+private:
+    struct Job {
+        const uint8_t *pixels;
+        unsigned long index;
+    };
+
+    FrameReadback readback;
+    std::string path;
+    Format format;
+    bool dropWhenBusy;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake; // worker: a job or stopping
+    std::condition_variable done; // render thread: a job completed
+    std::deque<Job> jobs;
+    unsigned long handed;    // jobs given to the worker (render thread)
+    unsigned long completed; // jobs finished (under mutex)
+    unsigned long released;  // buffers unmapped (render thread)
+    bool stopping;
+    unsigned long frameIndex;
+
+    // worker only
+    Y4MWriter y4m;
+    std::vector<uint8_t> yuv;
+    std::vector<uint8_t> encoded;
+
+    // maps the finished copies and queues them for the worker
+    void handOver(bool wait) {
+        FrameReadback::Frame frame;
+        while (readback.acquire(frame, wait)) {
+            Job job = {frame.pixels, frame.index};
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobs.push_back(job);
+            }
+            wake.notify_one();
+            handed++;
+            wait = false;
+        }
+    }
+
+    // unmaps the buffers the worker is done with, in order
+    void recycle(bool wait) {
+        unsigned long finished;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (wait) {
+                while (completed == released && released < handed) done.wait(lock);
+            }
+            finished = completed;
+        }
+        for (; released < finished; released++) readback.release();
+    }
+
+    void run() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (jobs.empty() && !stopping) wake.wait(lock);
+                if (jobs.empty()) return;
+                job = jobs.front();
+                jobs.pop_front();
+            }
+            write(job);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                completed++;
+                stats.written++;
+            }
+            done.notify_one();
+        }
+    }
+
+    void write(const Job &job) {
+        const int width = readback.width, height = readback.height;
+        if (format == CAPTURE_Y4M) {
+            if (!y4m.isOpen()) return;
+            uint8_t *y = &yuv[0];
+            uint8_t *u = y + (size_t)width * height;
+            uint8_t *v = u + (size_t)((width + 1) / 2) * ((height + 1) / 2);
+            rgbaToYuv420(job.pixels, width, height, true, y, u, v);
+            y4m.writeFrame(y, u, v);
+        } else {
+            encodeQoi(job.pixels, width, height, true, encoded);
+            char number[16];
+            snprintf(number, sizeof(number), "_%06lu", job.index);
+            size_t dot = path.find_last_of('.');
+            writeFile(path.substr(0, dot) + number + path.substr(dot), encoded);
+        }
+    }
+
+    FrameCapture(const FrameCapture &);
+    FrameCapture &operator=(const FrameCapture &);
+};
+
+#endif
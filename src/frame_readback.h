@@ -0,0 +1,136 @@
+#ifndef FRAME_READBACK_H
+#define FRAME_READBACK_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstddef>
+#include <iostream>
+
+#include "gl_state.h"
+
+// Asynchronous readback of rendered frames.
+//
+// request() makes the GPU copy the read framebuffer into one of `count`
+// pixel pack buffers and fences it; glReadPixels returns at once because the
+// destination is a buffer. acquire() maps the oldest copy once its fence has
+// passed, usually a frame or two later, so the CPU never waits on the
+// pipeline the way a plain glReadPixels into client memory does. Several
+// frames can be mapped at once (handed to another thread, say); they are
+// released in the order they were acquired.
+//
+// Pixels are RGBA8, rows bottom-up (GL order), tightly packed.
+class FrameReadback {
+
+public:
+    struct Frame {
+        const unsigned char *pixels;
+        int width;
+        int height;
+        unsigned long index; // as given to request()
+    };
+
+    int width;
+    int height;
+    // request() calls refused because every buffer was still in flight
+    unsigned int dropped;
+
+    FrameReadback(int width, int height, int count = 3)
+        : width(width), height(height), dropped(0), slots(count), oldest(0), inFlight(0), mappedCount(0) {
+        for (int i = 0; i < count; i++) {
+            glGenBuffers(1, &slots[i].pbo);
+            glState().bindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].pbo);
+            glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes(), NULL, GL_STREAM_READ);
+            slots[i].fence = 0;
+            slots[i].index = 0;
+        }
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    ~FrameReadback() {
+        while (mappedCount) release();
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (slots[i].fence) glDeleteSync(slots[i].fence);
+            glState().deleteBuffers(1, &slots[i].pbo);
+        }
+    }
+
+    size_t frameBytes() const { return (size_t)width * height * 4; }
+    int pending() const { return inFlight; }
+    int mapped() const { return mappedCount; }
+    bool full() const { return inFlight == (int)slots.size(); }
+
+    // after the frame is drawn, false (and the frame is dropped) when all
+    // buffers are busy: acquire() more often or use more buffers
+    bool request(GLuint framebuffer, unsigned long index) {
+        if (full()) {
+            dropped++;
+            return false;
+        }
+        Slot &slot = slots[(oldest + inFlight) % slots.size()];
+        glState().bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.index = index;
+        inFlight++;
+        return true;
+    }
+
+    // Maps the oldest requested frame not mapped yet if the GPU is done with
+    // it (or waits for it with `wait`). The pixels stay valid until release().
+    bool acquire(Frame &frame, bool wait = false) {
+        if (mappedCount == inFlight) return false;
+        Slot &slot = slots[(oldest + mappedCount) % slots.size()];
+        if (slot.fence) {
+            GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            while (wait && status == GL_TIMEOUT_EXPIRED)
+                status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+            if (status == GL_TIMEOUT_EXPIRED) return false;
+            glDeleteSync(slot.fence);
+            slot.fence = 0;
+        }
+
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        frame.pixels = (const unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes(), GL_MAP_READ_BIT);
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (!frame.pixels) {
+            std::cout << "ERROR::FRAME_READBACK::MAP_FAILED" << std::endl;
+            return false;
+        }
+        frame.width = width;
+        frame.height = height;
+        frame.index = slot.index;
+        mappedCount++;
+        return true;
+    }
+
+    // done with the oldest frame returned by acquire()
+    void release() {
+        if (!mappedCount) return;
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, slots[oldest].pbo);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        mappedCount--;
+        oldest = (oldest + 1) % (int)slots.size();
+        inFlight--;
+    }
+
+private:
+    struct Slot {
+        GLuint pbo;
+        GLsync fence;
+        unsigned long index;
+    };
+    std::vector<Slot> slots;
+    int oldest;      // first slot in flight
+    int inFlight;    // requested, not yet released
+    int mappedCount; // the first ones in flight are mapped
+
+    FrameReadback(const FrameReadback &);
+    FrameReadback &operator=(const FrameReadback &);
+};
+
+#endif
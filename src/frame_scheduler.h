@@ -0,0 +1,231 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <functional>
+
+// Frame pacing for the main loop.
+//
+//   scheduler.beginFrame();          // may sleep, see lateInput
+//   poll input
+//   for (int i = scheduler.simulationSteps(); i > 0; i--) simulate(scheduler.stepSeconds());
+//   render at scheduler.renderTime()
+//   scheduler.endWork();
+//   swap buffers (blocks on vsync with a swap interval)
+//   scheduler.endFrame();
+//
+// Deadlines: with vsync the next one is a refresh period (times the swap
+// interval) after the last swap returned, which is right after a vblank.
+// Without vsync they follow the targetFps cadence.
+//
+// lateInput sleeps at the start of the frame until the deadline minus the
+// predicted CPU work (the slowest of the recent frames plus a margin), so
+// input is sampled as late as possible before rendering. That is the input
+// to photon latency saved; the cost is a missed deadline when a frame takes
+// longer than predicted.
+//
+// With a simulationRate the simulation runs fixed steps decoupled from the
+// render rate and renderTime() interpolates between them. fixedFrameTime
+// replaces the wall clock (headless runs and captures are reproducible).
+class FrameScheduler {
+
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Settings {
+        int swapInterval = 1;        // applied by the caller (glfwSwapInterval), 0 = no vsync
+        double refreshRate = 60.0;   // display refresh, for vsync deadlines
+        double targetFps = 0.0;      // cadence without vsync, 0 = as fast as possible
+        bool lateInput = false;
+        double safetyMs = 1.0;       // added to the predicted work
+        double simulationRate = 0.0; // fixed steps per second, 0 = one step per frame
+        int maxStepsPerFrame = 5;    // after a hitch, the rest of the backlog is dropped
+        double fixedFrameTime = 0.0; // seconds per frame instead of the clock, 0 = real time
+    };
+    Settings settings;
+
+    // milliseconds
+    struct Stats {
+        unsigned long frames = 0;
+        unsigned long missedDeadlines = 0;
+        unsigned long droppedSteps = 0;
+        double cpuMs = 0, waitMs = 0, swapMs = 0, frameMs = 0; // last frame
+        double cpuTotal = 0, waitTotal = 0, swapTotal = 0;
+        double frameTotal = 0, frameMax = 0; // swap to swap, so from the second frame on
+        double cpuMax = 0;
+    };
+    Stats stats;
+
+    // Called instead of sleeping with the seconds left, e.g. to
+    // glfwWaitEventsTimeout so input events keep arriving (and being
+    // timestamped, see input.h) while the frame waits. May return early.
+    std::function<void(double)> waitEvents;
+
+    FrameScheduler() : started(false), accumulator(0.0), simTime(0.0), frameDelta(0.0), workIndex(0) {
+        for (int i = 0; i < WORK_HISTORY; i++) workHistory[i] = 0.0;
+    }
+
+    // seconds between deadlines, 0 when unpaced
+    double period() const {
+        if (settings.swapInterval > 0 && settings.refreshRate > 0) return settings.swapInterval / settings.refreshRate;
+        return settings.targetFps > 0 ? 1.0 / settings.targetFps : 0.0;
+    }
+
+    void beginFrame() {
+        Clock::time_point now = Clock::now();
+        if (!started) {
+            started = true;
+            lastFrameEnd = previousStart = now;
+            deadline = now + toDuration(period());
+        }
+
+        // Without vsync the cadence is held here, and waiting at the start of
+        // the frame rather than the end is late input for free.
+        bool sleep = period() > 0 && settings.fixedFrameTime <= 0 &&
+                     (settings.lateInput || settings.swapInterval <= 0);
+        if (sleep) sleepUntil(deadline - toDuration(predictedWork() + settings.safetyMs / 1000.0));
+        workStart = Clock::now();
+        stats.waitMs = milliseconds(workStart - now);
+
+        // simulation clock
+        double elapsed = settings.fixedFrameTime > 0 ? settings.fixedFrameTime : toSeconds(workStart - previousStart);
+        previousStart = workStart;
+        frameDelta = elapsed;
+        accumulator += elapsed;
+    }
+
+    // number of simulation steps to run this frame
+    int simulationSteps() {
+        if (settings.simulationRate <= 0) {
+            simTime += accumulator;
+            accumulator = 0.0;
+            return 1;
+        }
+        double step = stepSeconds();
+        int steps = (int)(accumulator / step);
+        if (steps > settings.maxStepsPerFrame) {
+            stats.droppedSteps += steps - settings.maxStepsPerFrame;
+            steps = settings.maxStepsPerFrame;
+            accumulator = steps * step + std::fmod(accumulator, step);
+        }
+        accumulator -= steps * step;
+        simTime += steps * step;
+        return steps;
+    }
+
+    double stepSeconds() const {
+        return settings.simulationRate > 0 ? 1.0 / settings.simulationRate : frameDelta;
+    }
+    // 0..1 between the last simulated state and the next one
+    double interpolation() const {
+        return settings.simulationRate > 0 ? accumulator * settings.simulationRate : 0.0;
+    }
+    double simulationTime() const { return simTime; }
+    // wall-clock time a simulation time of this frame stands for, e.g. the
+    // end of each step to pick the input events that belong to it
+    Clock::time_point wallTime(double simulationTime) const {
+        return workStart - toDuration(simTime + accumulator - simulationTime);
+    }
+    // simulation time to render, interpolated between steps
+    double renderTime() const { return simTime + interpolation() * (settings.simulationRate > 0 ? stepSeconds() : 0.0); }
+
+    // CPU work of the frame is submitted, about to swap
+    void endWork() {
+        workEnd = Clock::now();
+        stats.cpuMs = milliseconds(workEnd - workStart);
+        workHistory[workIndex++ % WORK_HISTORY] = stats.cpuMs / 1000.0;
+    }
+
+    // the swap returned
+    void endFrame() {
+        Clock::time_point now = Clock::now();
+        stats.swapMs = milliseconds(now - workEnd);
+        stats.frameMs = milliseconds(now - lastFrameEnd);
+        double p = period();
+        if (p > 0) {
+            if (settings.swapInterval > 0) {
+                // a frame longer than the swap interval missed its vblank
+                if (stats.frameMs > p * 1500.0) stats.missedDeadlines++;
+                deadline = now + toDuration(p);
+            } else {
+                if (workEnd > deadline) stats.missedDeadlines++;
+                deadline += toDuration(p);
+                if (deadline < now) deadline = now + toDuration(p); // fell behind, restart the cadence
+            }
+        }
+        lastFrameEnd = now;
+
+        stats.frames++;
+        stats.cpuTotal += stats.cpuMs;
+        stats.waitTotal += stats.waitMs;
+        stats.swapTotal += stats.swapMs;
+        stats.cpuMax = std::max(stats.cpuMax, stats.cpuMs);
+        if (stats.frames > 1) {
+            stats.frameTotal += stats.frameMs;
+            stats.frameMax = std::max(stats.frameMax, stats.frameMs);
+        }
+    }
+
+    void printStats(std::ostream &out) const {
+        if (!stats.frames) return;
+        double n = (double)stats.frames;
+        std::ios::fmtflags flags = out.flags();
+        std::streamsize precision = out.precision();
+        out << std::fixed << std::setprecision(2)
+            << "Frames: " << stats.frames << ", average ms: cpu " << stats.cpuTotal / n
+            << " (max " << stats.cpuMax << "), wait " << stats.waitTotal / n
+            << ", swap " << stats.swapTotal / n << ", frame " << stats.frameTotal / std::max(n - 1.0, 1.0)
+            << " (max " << stats.frameMax << "), missed deadlines " << stats.missedDeadlines
+            << ", dropped steps " << stats.droppedSteps << std::endl;
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+private:
+    static const int WORK_HISTORY = 32;
+
+    bool started;
+    Clock::time_point deadline;
+    Clock::time_point lastFrameEnd;
+    Clock::time_point workStart, workEnd, previousStart;
+    double accumulator;
+    double simTime;
+    double frameDelta;
+    double workHistory[WORK_HISTORY]; // seconds of CPU work of the last frames
+    int workIndex;
+
+    static Clock::duration toDuration(double seconds) {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    }
+    static double toSeconds(Clock::duration d) {
+        return std::chrono::duration<double>(d).count();
+    }
+    static double milliseconds(Clock::duration d) {
+        return std::chrono::duration<double, std::milli>(d).count();
+    }
+
+    // slowest recent frame, with 10% headroom
+    double predictedWork() const {
+        double worst = 0.0;
+        for (int i = 0; i < WORK_HISTORY; i++) worst = std::max(worst, workHistory[i]);
+        return worst * 1.1;
+    }
+
+    // OS sleeps overshoot by up to a millisecond: sleep short, then yield
+    void sleepUntil(Clock::time_point wake) const {
+        Clock::time_point coarse = wake - std::chrono::milliseconds(1);
+        if (waitEvents) {
+            for (Clock::time_point now = Clock::now(); now < coarse; now = Clock::now())
+                waitEvents(toSeconds(coarse - now));
+        }
+        if (Clock::now() < coarse) std::this_thread::sleep_until(coarse);
+        while (Clock::now() < wake) std::this_thread::yield();
+    }
+};
+
+#endif
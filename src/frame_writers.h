@@ -0,0 +1,132 @@
+#ifndef FRAME_WRITERS_H
+#define FRAME_WRITERS_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+// Output formats of the frame capture (frame_capture.h).
+//
+// - Y4M: raw YUV 4:2:0 frames behind a one-line header, what ffmpeg / x264
+//   read from a pipe or a file without any option.
+// - QOI: one lossless RGBA image per frame ("Quite OK Image" format), a
+//   single pass with a 64-entry colour cache, far cheaper than PNG's deflate.
+
+class Y4MWriter {
+
+public:
+    Y4MWriter() : width(0), height(0) {}
+
+    bool open(const std::string &path, int width, int height, int fps) {
+        this->width = width;
+        this->height = height;
+        file.open(path.c_str(), std::ios::out | std::ios::binary);
+        if (!file) {
+            std::cout << "ERROR::Y4M::FILE_NOT_OPENED " << path << std::endl;
+            return false;
+        }
+        file << "YUV4MPEG2 W" << width << " H" << height << " F" << fps << ":1 Ip A1:1 C420jpeg\n";
+        return true;
+    }
+
+    bool isOpen() const { return file.is_open(); }
+
+    // planes as written by rgbaToYuv420()
+    void writeFrame(const uint8_t *y, const uint8_t *u, const uint8_t *v) {
+        size_t lumaBytes = (size_t)width * height;
+        size_t chromaBytes = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+        file << "FRAME\n";
+        file.write((const char *)y, lumaBytes);
+        file.write((const char *)u, chromaBytes);
+        file.write((const char *)v, chromaBytes);
+    }
+
+    void close() {
+        if (file.is_open()) file.close();
+    }
+
+private:
+    std::ofstream file;
+    int width;
+    int height;
+};
+
+// RGBA8 -> QOI file contents, rows read bottom-up with flipY (glReadPixels order)
+inline void encodeQoi(const uint8_t *rgba, int width, int height, bool flipY, std::vector<uint8_t> &out) {
+    out.clear();
+    out.reserve((size_t)width * height * 5 / 2 + 22);
+
+    const uint8_t header[] = {'q', 'o', 'i', 'f',
+                              (uint8_t)(width >> 24), (uint8_t)(width >> 16), (uint8_t)(width >> 8), (uint8_t)width,
+                              (uint8_t)(height >> 24), (uint8_t)(height >> 16), (uint8_t)(height >> 8), (uint8_t)height,
+                              4, 0}; // RGBA, sRGB
+    out.insert(out.end(), header, header + sizeof(header));
+
+    uint8_t index[64][4];
+    memset(index, 0, sizeof(index));
+    uint8_t previous[4] = {0, 0, 0, 255};
+    int run = 0;
+    const size_t total = (size_t)width * height;
+
+    for (int row = 0; row < height; row++) {
+        const uint8_t *p = rgba + (size_t)(flipY ? height - 1 - row : row) * width * 4;
+        for (int x = 0; x < width; x++, p += 4) {
+            if (memcmp(p, previous, 4) == 0) {
+                run++;
+                if (run == 62 || (size_t)row * width + x + 1 == total) {
+                    out.push_back((uint8_t)(0xC0 | (run - 1))); // QOI_OP_RUN
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                out.push_back((uint8_t)(0xC0 | (run - 1)));
+                run = 0;
+            }
+
+            int slot = (p[0] * 3 + p[1] * 5 + p[2] * 7 + p[3] * 11) % 64;
+            if (memcmp(index[slot], p, 4) == 0) {
+                out.push_back((uint8_t)slot); // QOI_OP_INDEX
+            } else {
+                memcpy(index[slot], p, 4);
+                if (p[3] == previous[3]) {
+                    int8_t dr = (int8_t)(p[0] - previous[0]);
+                    int8_t dg = (int8_t)(p[1] - previous[1]);
+                    int8_t db = (int8_t)(p[2] - previous[2]);
+                    int8_t drg = (int8_t)(dr - dg), dbg = (int8_t)(db - dg);
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        out.push_back((uint8_t)(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2))); // QOI_OP_DIFF
+                    } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                        out.push_back((uint8_t)(0x80 | (dg + 32))); // QOI_OP_LUMA
+                        out.push_back((uint8_t)((drg + 8) << 4 | (dbg + 8)));
+                    } else {
+                        const uint8_t op[] = {0xFE, p[0], p[1], p[2]}; // QOI_OP_RGB
+                        out.insert(out.end(), op, op + 4);
+                    }
+                } else {
+                    const uint8_t op[] = {0xFF, p[0], p[1], p[2], p[3]}; // QOI_OP_RGBA
+                    out.insert(out.end(), op, op + 5);
+                }
+            }
+            memcpy(previous, p, 4);
+        }
+    }
+
+    const uint8_t end[] = {0, 0, 0, 0, 0, 0, 0, 1};
+    out.insert(out.end(), end, end + sizeof(end));
+}
+
+inline bool writeFile(const std::string &path, const std::vector<uint8_t> &bytes) {
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+    if (!file) {
+        std::cout << "ERROR::FRAME_WRITER::FILE_NOT_WRITTEN " << path << std::endl;
+        return false;
+    }
+    file.write((const char *)&bytes[0], bytes.size());
+    return true;
+}
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <cstdint>
+#include <cmath>
+
+#include "glm/glm.hpp"
+
+#include "random.h"
+#include "swept_collision.h"
+
+// Pong simulation, one fixed step at a time.
+//
+// The whole match is the GameState below, a few dozen bytes of plain data
+// that can be copied, compared and sent as is. stepGame() only depends on the
+// state, the inputs of the tick and the step size, so the same inputs give
+// the same match (the serve angles come from the seed and the tick, not from
+// a global generator). Only correctly rounded operations are used (no
+// transcendental functions, which differ between C libraries) so machines
+// agree bit for bit, as rollback and replays need; build with
+// -ffp-contract=off so the compiler does not fuse them into FMAs either.
+//
+// Field coordinates: the origin is the centre, x to the right, y up, the
+// field spans [-halfSize, halfSize]. Player 0 defends the left goal.
+
+// one tick of one player: -1 down, 0 still, +1 up
+struct PaddleInput {
+    int8_t move;
+};
+
+struct GameConfig {
+    glm::vec2 halfSize;
+    float paddleX;          // |x| of the paddle centres
+    glm::vec2 paddleHalf;   // paddle half extents
+    float paddleSpeed;      // units per second
+    float ballRadius;
+    float serveSpeed;
+    float speedUp;          // ball speed factor on every paddle hit
+    float maxSpeed;
+    float maxServeSlope;    // vertical / horizontal speed of a serve
+    float spin;             // vertical speed added per unit of hit offset from the paddle centre
+
+    GameConfig()
+        : halfSize(4.0f / 3.0f, 1.0f), paddleX(1.2f), paddleHalf(0.025f, 0.15f), paddleSpeed(1.8f),
+          ballRadius(0.025f), serveSpeed(1.0f), speedUp(1.05f), maxSpeed(4.0f), maxServeSlope(0.55f),
+          spin(0.75f) {}
+};
+
+struct GameState {
+    glm::vec2 ball;
+    glm::vec2 ballVelocity;
+    float paddleY[2];
+    uint16_t score[2];
+    uint32_t tick;
+    uint32_t seed;
+};
+
+// ball in the centre, launched towards `side` (0 left, 1 right)
+inline void serveBall(const GameConfig &config, GameState &state, int side) {
+    uint64_t bits = splitMix64(((uint64_t)state.seed << 32) | state.tick);
+    float u = (float)(bits >> 40) * (1.0f / 16777216.0f); // [0, 1)
+    float slope = (2.0f * u - 1.0f) * config.maxServeSlope;
+    float direction = side == 0 ? -1.0f : 1.0f;
+    state.ball = glm::vec2(0.0f);
+    state.ballVelocity = glm::vec2(direction, slope) * (config.serveSpeed / std::sqrt(1.0f + slope * slope));
+}
+
+inline void resetGame(const GameConfig &config, GameState &state, uint32_t seed) {
+    state.paddleY[0] = state.paddleY[1] = 0.0f;
+    state.score[0] = state.score[1] = 0;
+    state.tick = 0;
+    state.seed = seed;
+    serveBall(config, state, seed & 1u);
+}
+
+inline float paddleCentreX(const GameConfig &config, int side) {
+    return side == 0 ? -config.paddleX : config.paddleX;
+}
+
+// paddles to their position at the end of the step, `start` and `velocity`
+// describe the straight move in between the ball is swept against
+inline void movePaddles(const GameConfig &config, GameState &state, const PaddleInput input[2], float dt,
+                        float start[2], float velocity[2]) {
+    const float paddleLimit = config.halfSize.y - config.paddleHalf.y;
+    const float perSecond = 1.0f / dt;
+    for (int side = 0; side < 2; side++) {
+        float y = state.paddleY[side] + (float)input[side].move * config.paddleSpeed * dt;
+        start[side] = state.paddleY[side];
+        state.paddleY[side] = glm::clamp(y, -paddleLimit, paddleLimit);
+        velocity[side] = (state.paddleY[side] - start[side]) * perSecond;
+    }
+}
+
+// goals: the point to the other side, the next serve to the player who conceded
+inline void endStep(const GameConfig &config, GameState &state) {
+    state.tick++;
+    if (state.ball.x < -config.halfSize.x) {
+        state.score[1]++;
+        serveBall(config, state, 0);
+    } else if (state.ball.x > config.halfSize.x) {
+        state.score[0]++;
+        serveBall(config, state, 1);
+    }
+}
+
+// walls and paddle hits a ball can have in one step, the rest of a step with
+// more is dropped (it takes a ball wedged between a paddle and a wall)
+static const int MAX_STEP_EVENTS = 8;
+static const float SWEEP_MARGIN = 1e-3f;
+
+// The ball moves from event to event within the step: the earliest of the
+// wall it is heading to and the paddle on the side it is heading to, swept
+// against the paddle's own move (see swept_collision.h). Hits are exact at any
+// speed and step size, a server can tick at 20 Hz without the ball going
+// through paddles.
+inline void stepGame(const GameConfig &config, GameState &state, const PaddleInput input[2], float dt) {
+    float paddleStart[2], paddleVelocity[2];
+    movePaddles(config, state, input, dt, paddleStart, paddleVelocity);
+
+    const float wall = config.halfSize.y - config.ballRadius;
+    float elapsed = 0.0f;
+    for (int event = 0; event < MAX_STEP_EVENTS; event++) {
+        float remaining = dt - elapsed;
+        if (!(remaining > 0.0f)) break;
+        glm::vec2 motion = state.ballVelocity * remaining;
+
+        // top and bottom walls, as a fraction of the motion (> 1: not this step)
+        float tWall = 2.0f;
+        if (state.ballVelocity.y > 0.0f && state.ball.y + motion.y > wall) tWall = (wall - state.ball.y) / motion.y;
+        else if (state.ballVelocity.y < 0.0f && state.ball.y + motion.y < -wall) tWall = (-wall - state.ball.y) / motion.y;
+        tWall = sweepMax(tWall, 0.0f);
+
+        // nowhere near the paddle (with a margin well above rounding): no need to sweep
+        int side = state.ballVelocity.x < 0.0f ? 0 : 1;
+        float paddleX = paddleCentreX(config, side), endX = state.ball.x + motion.x;
+        float reach = config.ballRadius + SWEEP_MARGIN;
+        bool nearPaddle = sweepMax(state.ball.x, endX) + reach >= paddleX - config.paddleHalf.x &&
+                          sweepMin(state.ball.x, endX) - reach <= paddleX + config.paddleHalf.x;
+        if (!nearPaddle && tWall > 1.0f) {
+            state.ball += motion;
+            break;
+        }
+
+        float paddleY = paddleStart[side] + paddleVelocity[side] * elapsed;
+        glm::vec2 paddle(paddleX, paddleY);
+        glm::vec2 relative(motion.x, motion.y - paddleVelocity[side] * remaining);
+        SweepHit hit;
+        bool paddleHit = sweepCircleAabb(state.ball, relative, config.ballRadius, paddle - config.paddleHalf,
+                                         paddle + config.paddleHalf, hit) && hit.t <= tWall;
+        float t = paddleHit ? hit.t : tWall;
+        if (t > 1.0f) {
+            state.ball += motion;
+            break;
+        }
+        state.ball += motion * t;
+        elapsed += remaining * t;
+        if (!paddleHit) {
+            state.ballVelocity.y = -state.ballVelocity.y;
+            continue;
+        }
+
+        paddleY = paddleStart[side] + paddleVelocity[side] * elapsed;
+        float front = side == 0 ? 1.0f : -1.0f;
+        if (hit.normal.x * front > 0.0f) {
+            // the face or its corners: towards the other side, faster and with some spin
+            state.ballVelocity.x = front * std::fabs(state.ballVelocity.x);
+            state.ballVelocity.y += (state.ball.y - paddleY) / config.paddleHalf.y * config.spin;
+            float speed = std::sqrt(state.ballVelocity.x * state.ballVelocity.x +
+                                    state.ballVelocity.y * state.ballVelocity.y);
+            float target = sweepMin(speed * config.speedUp, config.maxSpeed);
+            float scale = target / speed;
+            state.ballVelocity.x *= scale;
+            state.ballVelocity.y *= scale;
+        } else {
+            // top, bottom or back: bounced off like a wall that moves, the point is still lost
+            float vx = state.ballVelocity.x, vy = state.ballVelocity.y - paddleVelocity[side];
+            float along = vx * hit.normal.x + vy * hit.normal.y;
+            if (along < 0.0f) {
+                vx -= 2.0f * along * hit.normal.x;
+                vy -= 2.0f * along * hit.normal.y;
+            }
+            state.ballVelocity.x = vx;
+            state.ballVelocity.y = vy + paddleVelocity[side];
+        }
+    }
+
+    endStep(config, state);
+}
+
+// stepGame() over many matches sharing `config`, for servers and batched
+// self-play. A float8 version (the ball events of 8 matches in lanes, the
+// states gathered and scattered every tick) lost to this loop in self-play
+// and at best tied with it on the server: most ticks are a straight move the
+// scalar code does in a few nanoseconds. bench/step_bench.cpp times a
+// candidate against the loop.
+inline void stepGames(const GameConfig &config, GameState *const states[], const PaddleInput *const inputs[],
+                      size_t count, float dt) {
+    for (size_t i = 0; i < count; i++) stepGame(config, *states[i], inputs[i], dt);
+}
+
+#endif
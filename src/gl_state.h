@@ -0,0 +1,234 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <GL/glew.h>
+
+// Shadow copy of the GL binding state, to skip calls that would not change
+// anything. Program, VAO, buffer, texture, framebuffer, blend and viewport
+// changes should all go through here (see glState()); after raw GL calls that
+// touch the same state, call invalidate() so the next request is issued again.
+//
+// Objects must be deleted through here too: GL unbinds a deleted name and
+// hands it out again from the next glGen*, so a shadow entry still holding
+// it would skip the bind of the new object. The delete wrappers forget only
+// the bindings of the names they delete.
+class GLStateCache {
+
+public:
+    // calls issued to the driver vs. skipped because the state was already set
+    struct Counters {
+        unsigned int issued = 0;
+        unsigned int elided = 0;
+    };
+    Counters frame;     // since the last endFrame()
+    Counters lastFrame; // the previous frame, for display
+
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+    GLStateCache() { invalidate(); }
+
+    // forget everything, the next call of each kind is always issued
+    void invalidate() {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        for (int i = 0; i < BUFFER_TARGETS; i++) buffers[i] = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++) {
+            textures[i] = UNKNOWN;
+            textureTargets[i] = 0;
+        }
+        drawFramebuffer = readFramebuffer = UNKNOWN;
+        blend = -1;
+        blendSrc = blendDst = UNKNOWN;
+        viewport[0] = viewport[1] = viewport[2] = viewport[3] = -1;
+    }
+
+    void endFrame() {
+        lastFrame = frame;
+        frame = Counters();
+    }
+
+    void useProgram(GLuint id) {
+        if (!changed(program, id)) return;
+        glUseProgram(id);
+    }
+
+    void bindVertexArray(GLuint id) {
+        if (!changed(vertexArray, id)) return;
+        glBindVertexArray(id);
+        // the element array binding is part of the VAO
+        buffers[targetSlot(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+    }
+
+    void bindBuffer(GLenum target, GLuint id) {
+        int slot = targetSlot(target);
+        if (slot >= 0 && !changed(buffers[slot], id)) return;
+        if (slot < 0) frame.issued++;
+        glBindBuffer(target, id);
+    }
+
+    // indexed bindings (UBO ranges...) also change the generic binding point
+    void bindBufferRange(GLenum target, GLuint index, GLuint id, GLintptr offset, GLsizeiptr size) {
+        frame.issued++;
+        glBindBufferRange(target, index, id, offset, size);
+        int slot = targetSlot(target);
+        if (slot >= 0) buffers[slot] = id;
+    }
+
+    void bindTexture(unsigned int unit, GLenum target, GLuint id) {
+        if (unit < MAX_TEXTURE_UNITS && textures[unit] == id && textureTargets[unit] == target) {
+            frame.elided++;
+            return;
+        }
+        activeTexture(unit);
+        frame.issued++;
+        glBindTexture(target, id);
+        if (unit < MAX_TEXTURE_UNITS) {
+            textures[unit] = id;
+            textureTargets[unit] = target;
+        }
+    }
+
+    // GL_FRAMEBUFFER sets both the draw and the read binding
+    void bindFramebuffer(GLenum target, GLuint id) {
+        bool draw = target != GL_READ_FRAMEBUFFER, read = target != GL_DRAW_FRAMEBUFFER;
+        if ((!draw || drawFramebuffer == id) && (!read || readFramebuffer == id)) {
+            frame.elided++;
+            return;
+        }
+        frame.issued++;
+        if (draw) drawFramebuffer = id;
+        if (read) readFramebuffer = id;
+        glBindFramebuffer(target, id);
+    }
+
+    void setBlend(bool enabled) {
+        if (blend == (int)enabled) {
+            frame.elided++;
+            return;
+        }
+        frame.issued++;
+        blend = enabled;
+        if (enabled) glEnable(GL_BLEND);
+        else glDisable(GL_BLEND);
+    }
+
+    void blendFunc(GLenum src, GLenum dst) {
+        if (blendSrc == src && blendDst == dst) {
+            frame.elided++;
+            return;
+        }
+        frame.issued++;
+        blendSrc = src;
+        blendDst = dst;
+        glBlendFunc(src, dst);
+    }
+
+    void setViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+        if (viewport[0] == x && viewport[1] == y && viewport[2] == width && viewport[3] == height) {
+            frame.elided++;
+            return;
+        }
+        frame.issued++;
+        viewport[0] = x;
+        viewport[1] = y;
+        viewport[2] = width;
+        viewport[3] = height;
+        glViewport(x, y, width, height);
+    }
+
+    void deleteBuffers(GLsizei n, const GLuint *ids) {
+        for (GLsizei i = 0; i < n; i++)
+            for (int slot = 0; slot < BUFFER_TARGETS; slot++) forget(buffers[slot], ids[i]);
+        glDeleteBuffers(n, ids);
+    }
+
+    void deleteTextures(GLsizei n, const GLuint *ids) {
+        for (GLsizei i = 0; i < n; i++)
+            for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) forget(textures[unit], ids[i]);
+        glDeleteTextures(n, ids);
+    }
+
+    void deleteVertexArrays(GLsizei n, const GLuint *ids) {
+        for (GLsizei i = 0; i < n; i++) {
+            if (vertexArray != ids[i] || ids[i] == 0) continue;
+            vertexArray = UNKNOWN;
+            buffers[targetSlot(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+        }
+        glDeleteVertexArrays(n, ids);
+    }
+
+    // a program in use is only freed once another one replaces it, its name
+    // is forgotten all the same
+    void deleteProgram(GLuint id) {
+        forget(program, id);
+        glDeleteProgram(id);
+    }
+
+    void deleteFramebuffers(GLsizei n, const GLuint *ids) {
+        for (GLsizei i = 0; i < n; i++) {
+            forget(drawFramebuffer, ids[i]);
+            forget(readFramebuffer, ids[i]);
+        }
+        glDeleteFramebuffers(n, ids);
+    }
+
+    GLuint currentProgram() const { return program; }
+
+private:
+    enum { BUFFER_TARGETS = 6 };
+
+    GLuint program;
+    GLuint vertexArray;
+    GLuint buffers[BUFFER_TARGETS];
+    GLuint activeUnit;
+    GLuint textures[MAX_TEXTURE_UNITS];
+    GLenum textureTargets[MAX_TEXTURE_UNITS];
+    GLuint drawFramebuffer, readFramebuffer;
+    int blend;
+    GLenum blendSrc, blendDst;
+    GLint viewport[4];
+
+    // updates the shadow value and counts the call either way
+    bool changed(GLuint &current, GLuint wanted) {
+        if (current == wanted) {
+            frame.elided++;
+            return false;
+        }
+        frame.issued++;
+        current = wanted;
+        return true;
+    }
+
+    // a deleted name is no longer bound, and 0 cannot be deleted
+    static void forget(GLuint &current, GLuint deleted) {
+        if (deleted != 0 && current == deleted) current = UNKNOWN;
+    }
+
+    void activeTexture(unsigned int unit) {
+        if (!changed(activeUnit, unit)) return;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // targets whose binding is shadowed, -1 for the others (always issued)
+    static int targetSlot(GLenum target) {
+        switch (target) {
+            case GL_ARRAY_BUFFER:         return 0;
+            case GL_ELEMENT_ARRAY_BUFFER: return 1;
+            case GL_UNIFORM_BUFFER:       return 2;
+            case GL_PIXEL_PACK_BUFFER:    return 3;
+            case GL_PIXEL_UNPACK_BUFFER:  return 4;
+            case GL_COPY_WRITE_BUFFER:    return 5;
+            default:                      return -1;
+        }
+    }
+};
+
+// the cache of the current (single) GL context
+inline GLStateCache &glState() {
+    static GLStateCache cache;
+    return cache;
+}
+
+#endif
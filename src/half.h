@@ -0,0 +1,227 @@
+#ifndef HALF_H
+#define HALF_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/packing.hpp"
+
+// Half float and normalized integer conversions, one value or whole arrays
+// at a time, for vertex attributes and pixels uploaded to the GPU.
+//
+// glm::packHalf1x16 / detail::toFloat16 convert one scalar with a chain of
+// branches. Here the conversions use F16C (vcvtps2ph / vcvtph2ps) when the
+// build enables it (make SIMD=avx2) and a branch-light bit trick otherwise.
+// Both paths give the same bits for every input: halves round to nearest
+// even (GLM's own converter is off by one ulp on some inputs), and a NaN
+// keeps the top of its payload and comes out quiet, as vcvtps2ph /
+// vcvtph2ps do. The normalized formats give the same bits as
+// glm::packUnorm1x8 / packSnorm1x16.
+
+#if defined(__F16C__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+inline uint32_t floatBits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+inline float bitsFloat(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+// float -> half without F16C, round to nearest even (F. Giesen,
+// "float_to_half_fast3_rtne")
+inline uint16_t floatToHalfSoftware(float value) {
+    const uint32_t f32Infinity = 255u << 23;
+    const uint32_t f16Max = (127u + 16u) << 23;
+    const uint32_t denormMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+    uint32_t f = floatBits(value);
+    uint32_t sign = f & 0x80000000u;
+    f ^= sign;
+
+    uint32_t o;
+    if (f >= f16Max) {
+        // overflow to infinity; NaN keeps the top 10 bits of its payload, quiet
+        o = f > f32Infinity ? 0x7E00u | ((f >> 13) & 0x3FFu) : 0x7C00u;
+    } else if (f < (113u << 23)) {
+        // subnormal or zero: let the FPU do the rounding
+        o = floatBits(bitsFloat(f) + bitsFloat(denormMagic)) - denormMagic;
+    } else {
+        uint32_t mantissaOdd = (f >> 13) & 1u;
+        f += ((uint32_t)(15 - 127) << 23) + 0xFFFu;
+        f += mantissaOdd;
+        o = f >> 13;
+    }
+    return (uint16_t)(o | (sign >> 16));
+}
+
+// half -> float without F16C, exact
+inline float halfToFloatSoftware(uint16_t value) {
+    const uint32_t shiftedExponent = 0x7C00u << 13;
+    uint32_t o = ((uint32_t)value & 0x7FFFu) << 13;
+    uint32_t exponent = o & shiftedExponent;
+    o += (127u - 15u) << 23;
+    if (exponent == shiftedExponent) {
+        o += (128u - 16u) << 23; // Inf / NaN
+        if (o & 0x7FFFFFu) o |= 0x400000u; // a signalling NaN comes out quiet
+    } else if (exponent == 0) {
+        o += 1u << 23;           // zero / subnormal: renormalize
+        o = floatBits(bitsFloat(o) - bitsFloat(113u << 23));
+    }
+    return bitsFloat(o | (((uint32_t)value & 0x8000u) << 16));
+}
+
+inline uint16_t floatToHalf(float value) {
+#if defined(__F16C__)
+    return (uint16_t)_cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT);
+#else
+    return floatToHalfSoftware(value);
+#endif
+}
+
+inline float halfToFloat(uint16_t value) {
+#if defined(__F16C__)
+    return _cvtsh_ss(value);
+#else
+    return halfToFloatSoftware(value);
+#endif
+}
+
+// Bulk conversions. `count` is the number of scalars, the vecN overloads
+// take the number of vectors.
+
+inline void packHalf(const float *src, uint16_t *dst, size_t count) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i *)(dst + i), h);
+    }
+#endif
+    for (; i < count; i++)
+        dst[i] = floatToHalf(src[i]);
+}
+
+inline void unpackHalf(const uint16_t *src, float *dst, size_t count) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(src + i))));
+#endif
+    for (; i < count; i++)
+        dst[i] = halfToFloat(src[i]);
+}
+
+inline void packHalf(const glm::vec2 *src, glm::u16vec2 *dst, size_t count) {
+    packHalf(&src[0].x, &dst[0].x, count * 2);
+}
+inline void packHalf(const glm::vec3 *src, glm::u16vec3 *dst, size_t count) {
+    packHalf(&src[0].x, &dst[0].x, count * 3);
+}
+inline void packHalf(const glm::vec4 *src, glm::u16vec4 *dst, size_t count) {
+    packHalf(&src[0].x, &dst[0].x, count * 4);
+}
+inline void unpackHalf(const glm::u16vec4 *src, glm::vec4 *dst, size_t count) {
+    unpackHalf(&src[0].x, &dst[0].x, count * 4);
+}
+
+#if defined(__AVX2__)
+// round(x) with ties away from zero, like glm::round / std::round
+inline __m256 roundHalfAway8(__m256 x) {
+    __m256 signBit = _mm256_set1_ps(-0.0f);
+    __m256 a = _mm256_andnot_ps(signBit, x);
+    __m256 t = _mm256_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m256 up = _mm256_cmp_ps(_mm256_sub_ps(a, t), _mm256_set1_ps(0.5f), _CMP_GE_OQ);
+    t = _mm256_add_ps(t, _mm256_and_ps(up, _mm256_set1_ps(1.0f)));
+    return _mm256_or_ps(t, _mm256_and_ps(signBit, x));
+}
+#endif
+
+// same as glm::packUnorm1x8 per element (packUnorm4x8 for vec4 colours)
+inline void packUnorm8(const float *src, uint8_t *dst, size_t count) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), scale = _mm256_set1_ps(255.0f);
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), zero), one);
+        __m256i n = _mm256_cvttps_epi32(roundHalfAway8(_mm256_mul_ps(v, scale)));
+        // 8 x int32 -> 8 x uint8, values are already in [0, 255]
+        __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(n), _mm256_extracti128_si256(n, 1));
+        _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(w, w));
+    }
+#endif
+    for (; i < count; i++)
+        dst[i] = glm::packUnorm1x8(src[i]);
+}
+
+inline void unpackUnorm8(const uint8_t *src, float *dst, size_t count) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256 scale = _mm256_set1_ps(0.0039215686274509803921568627451f); // 1 / 255
+    for (; i + 8 <= count; i += 8) {
+        __m256i n = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(n), scale));
+    }
+#endif
+    for (; i < count; i++)
+        dst[i] = glm::unpackUnorm1x8(src[i]);
+}
+
+// same as glm::packSnorm1x16 per element
+inline void packSnorm16(const float *src, int16_t *dst, size_t count) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256 lo = _mm256_set1_ps(-1.0f), hi = _mm256_set1_ps(1.0f), scale = _mm256_set1_ps(32767.0f);
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), lo), hi);
+        __m256i n = _mm256_cvttps_epi32(roundHalfAway8(_mm256_mul_ps(v, scale)));
+        __m128i w = _mm_packs_epi32(_mm256_castsi256_si128(n), _mm256_extracti128_si256(n, 1));
+        _mm_storeu_si128((__m128i *)(dst + i), w);
+    }
+#endif
+    for (; i < count; i++) {
+        uint16_t packed = glm::packSnorm1x16(src[i]);
+        memcpy(&dst[i], &packed, sizeof(packed));
+    }
+}
+
+inline void unpackSnorm16(const int16_t *src, float *dst, size_t count) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256 lo = _mm256_set1_ps(-1.0f), hi = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(3.0518509475997192297128208258309e-5f); // 1 / 32767
+    for (; i + 8 <= count; i += 8) {
+        __m256i n = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+        __m256 v = _mm256_mul_ps(_mm256_cvtepi32_ps(n), scale);
+        _mm256_storeu_ps(dst + i, _mm256_min_ps(_mm256_max_ps(v, lo), hi));
+    }
+#endif
+    for (; i < count; i++) {
+        uint16_t packed;
+        memcpy(&packed, &src[i], sizeof(packed));
+        dst[i] = glm::unpackSnorm1x16(packed);
+    }
+}
+
+inline void packUnorm8(const glm::vec4 *src, glm::u8vec4 *dst, size_t count) {
+    packUnorm8(&src[0].x, &dst[0].x, count * 4);
+}
+inline void unpackUnorm8(const glm::u8vec4 *src, glm::vec4 *dst, size_t count) {
+    unpackUnorm8(&src[0].x, &dst[0].x, count * 4);
+}
+
+// one colour as normalized RGBA8 in a word, red in the low byte: the colour
+// attribute of the particle and glyph instances
+inline uint32_t packColor(const glm::vec4 &color) {
+    glm::vec4 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+    return (uint32_t)c.r | (uint32_t)c.g << 8 | (uint32_t)c.b << 16 | (uint32_t)c.a << 24;
+}
+
+#endif
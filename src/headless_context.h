@@ -0,0 +1,186 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <GL/glew.h>
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+
+#if defined(HEADLESS_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#elif defined(HEADLESS_OSMESA)
+#include <GL/osmesa.h>
+#endif
+
+// GL 3.3 core context without a window or a display, for CI and render
+// farms (Mesa llvmpipe works). Selected at build time, see HEADLESS in the
+// Makefile:
+//
+// - HEADLESS_EGL: EGL on the surfaceless platform (EGL_MESA_platform_surfaceless),
+//   else the default display, made current without a surface
+//   (EGL_KHR_surfaceless_context) or with a 1x1 pbuffer.
+// - HEADLESS_OSMESA: OSMesa rendering into a client buffer.
+//
+// There is no default framebuffer worth drawing to: render into a
+// RenderTarget (render_target.h).
+class HeadlessContext {
+
+public:
+    enum Backend { BACKEND_NONE, BACKEND_EGL, BACKEND_OSMESA };
+    Backend backend;
+
+    HeadlessContext() : backend(BACKEND_NONE) {
+#if defined(HEADLESS_EGL)
+        display = EGL_NO_DISPLAY;
+        surface = EGL_NO_SURFACE;
+        context = EGL_NO_CONTEXT;
+#elif defined(HEADLESS_OSMESA)
+        context = NULL;
+#endif
+    }
+    ~HeadlessContext() { destroy(); }
+
+    // creates the context and makes it current on this thread
+    bool create(int width, int height) {
+#if defined(HEADLESS_EGL)
+        return createEGL();
+#elif defined(HEADLESS_OSMESA)
+        return createOSMesa(width, height);
+#else
+        std::cout << "ERROR::HEADLESS::NO_BACKEND build with HEADLESS=egl or HEADLESS=osmesa" << std::endl;
+        return false;
+#endif
+    }
+
+    void destroy() {
+#if defined(HEADLESS_EGL)
+        if (display != EGL_NO_DISPLAY) {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+            if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+            eglTerminate(display);
+        }
+        display = EGL_NO_DISPLAY;
+        surface = EGL_NO_SURFACE;
+        context = EGL_NO_CONTEXT;
+#elif defined(HEADLESS_OSMESA)
+        if (context) OSMesaDestroyContext(context);
+        context = NULL;
+#endif
+        backend = BACKEND_NONE;
+    }
+
+    const char *name() const {
+        switch (backend) {
+            case BACKEND_EGL:    return "EGL";
+            case BACKEND_OSMESA: return "OSMesa";
+            default:             return "none";
+        }
+    }
+
+private:
+#if defined(HEADLESS_EGL)
+    EGLDisplay display;
+    EGLSurface surface;
+    EGLContext context;
+
+    static bool hasExtension(const char *list, const char *name) {
+        if (!list) return false;
+        size_t length = strlen(name);
+        for (const char *p = strstr(list, name); p; p = strstr(p + length, name))
+            if ((p == list || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0')) return true;
+        return false;
+    }
+
+    bool createEGL() {
+        const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay && hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+        EGLint major = 0, minor = 0;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+            std::cout << "ERROR::HEADLESS::EGL_INITIALIZE_FAILED" << std::endl;
+            display = EGL_NO_DISPLAY;
+            return false;
+        }
+        bool surfaceless = hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+        const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+            std::cout << "ERROR::HEADLESS::EGL_NO_CONFIG" << std::endl;
+            destroy();
+            return false;
+        }
+
+        eglBindAPI(EGL_OPENGL_API);
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+            EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+        if (context == EGL_NO_CONTEXT) {
+            std::cout << "ERROR::HEADLESS::EGL_CREATE_CONTEXT_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            destroy();
+            return false;
+        }
+
+        if (!surfaceless) {
+            const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+            surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+        }
+        if (!eglMakeCurrent(display, surface, surface, context)) {
+            std::cout << "ERROR::HEADLESS::EGL_MAKE_CURRENT_FAILED" << std::endl;
+            destroy();
+            return false;
+        }
+        backend = BACKEND_EGL;
+        return true;
+    }
+#elif defined(HEADLESS_OSMESA)
+    OSMesaContext context;
+    std::vector<unsigned char> buffer; // OSMesa wants a color buffer even if we draw to FBOs
+
+    bool createOSMesa(int width, int height) {
+        const int attribs[] = {
+            OSMESA_FORMAT, OSMESA_RGBA,
+            OSMESA_DEPTH_BITS, 24,
+            OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+            OSMESA_CONTEXT_MAJOR_VERSION, 3,
+            OSMESA_CONTEXT_MINOR_VERSION, 3,
+            0
+        };
+        context = OSMesaCreateContextAttribs(attribs, NULL);
+        if (!context) {
+            std::cout << "ERROR::HEADLESS::OSMESA_CREATE_CONTEXT_FAILED" << std::endl;
+            return false;
+        }
+        buffer.resize((size_t)width * height * 4);
+        if (!OSMesaMakeCurrent(context, &buffer[0], GL_UNSIGNED_BYTE, width, height)) {
+            std::cout << "ERROR::HEADLESS::OSMESA_MAKE_CURRENT_FAILED" << std::endl;
+            destroy();
+            return false;
+        }
+        backend = BACKEND_OSMESA;
+        return true;
+    }
+#endif
+
+    HeadlessContext(const HeadlessContext &);
+    HeadlessContext &operator=(const HeadlessContext &);
+};
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstdint>
+
+#include "spsc_queue.h"
+#include "game.h"
+
+// Paddle input, timestamped when it happens rather than when a frame looks.
+//
+// The GLFW key callback stamps every press / release with the monotonic clock
+// and pushes it into a lock-free single producer / single consumer queue. The
+// simulation drains the queue one fixed step at a time, taking only the
+// events up to the wall-clock end of that step (FrameScheduler::wallTime), so
+// a key pressed halfway through a frame moves the paddle from the right tick
+// instead of from the next frame, and a press and release between two ticks
+// still counts. The last step of a frame also takes the events polled after
+// the frame started, which no step end reaches.
+//
+// GLFW delivers events on the main thread only, from glfwPollEvents() /
+// glfwWaitEvents*(). Set FrameScheduler::waitEvents so the time the frame
+// spends waiting is spent receiving events, which keeps the timestamps
+// accurate to the event rather than to the frame.
+class InputSystem {
+
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    enum Action { ACTION_UP, ACTION_DOWN, ACTION_COUNT };
+    static const int PLAYERS = 2;
+
+    struct Event {
+        Clock::time_point time;
+        uint8_t player;
+        uint8_t action;
+        bool pressed;
+    };
+
+    // events lost because the queue was full (the consumer stopped draining)
+    unsigned long overflows;
+
+    InputSystem() : overflows(0), previousCallback(NULL) {
+        for (int i = 0; i < MAX_BINDINGS; i++) bindings[i].key = -1;
+        for (int p = 0; p < PLAYERS; p++) {
+            for (int a = 0; a < ACTION_COUNT; a++) held[p][a] = pressedInTick[p][a] = false;
+        }
+        // W / S for the left paddle, the arrows for the right one
+        bind(GLFW_KEY_W, 0, ACTION_UP);
+        bind(GLFW_KEY_S, 0, ACTION_DOWN);
+        bind(GLFW_KEY_UP, 1, ACTION_UP);
+        bind(GLFW_KEY_DOWN, 1, ACTION_DOWN);
+    }
+
+    // producer side: installs the key callback (the window user pointer is taken)
+    void attach(GLFWwindow *window) {
+        glfwSetWindowUserPointer(window, this);
+        previousCallback = glfwSetKeyCallback(window, keyCallback);
+    }
+
+    bool bind(int key, int player, Action action) {
+        for (int i = 0; i < MAX_BINDINGS; i++) {
+            if (bindings[i].key == -1 || bindings[i].key == key) {
+                Binding binding = {key, (uint8_t)player, (uint8_t)action};
+                bindings[i] = binding;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // producer side, also usable without GLFW (bots, replays, tests)
+    void push(const Event &event) {
+        if (!queue.push(event)) overflows++;
+    }
+
+    // consumer side: applies the events up to `until` and returns the input of
+    // each player for the tick ending then
+    void consume(Clock::time_point until, PaddleInput out[PLAYERS]) {
+        const Event *event;
+        while ((event = queue.peek()) && event->time <= until) {
+            held[event->player][event->action] = event->pressed;
+            if (event->pressed) pressedInTick[event->player][event->action] = true;
+            Event done;
+            queue.pop(done);
+        }
+        for (int p = 0; p < PLAYERS; p++) {
+            bool up = held[p][ACTION_UP] || pressedInTick[p][ACTION_UP];
+            bool down = held[p][ACTION_DOWN] || pressedInTick[p][ACTION_DOWN];
+            out[p].move = (int8_t)((up ? 1 : 0) - (down ? 1 : 0));
+            pressedInTick[p][ACTION_UP] = pressedInTick[p][ACTION_DOWN] = false;
+        }
+    }
+
+private:
+    static const int MAX_BINDINGS = 16;
+    struct Binding {
+        int key;
+        uint8_t player;
+        uint8_t action;
+    };
+    Binding bindings[MAX_BINDINGS];
+
+    SpscQueue<Event, 256> queue;
+    GLFWkeyfun previousCallback;
+
+    // consumer only
+    bool held[PLAYERS][ACTION_COUNT];
+    bool pressedInTick[PLAYERS][ACTION_COUNT]; // pressed since the last tick, even if already released
+
+    static void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+        Clock::time_point now = Clock::now();
+        InputSystem *input = (InputSystem *)glfwGetWindowUserPointer(window);
+        if (!input) return;
+        if (input->previousCallback) input->previousCallback(window, key, scancode, action, mods);
+        if (action == GLFW_REPEAT) return;
+        for (int i = 0; i < MAX_BINDINGS && input->bindings[i].key != -1; i++) {
+            if (input->bindings[i].key != key) continue;
+            Event event = {now, input->bindings[i].player, input->bindings[i].action, action == GLFW_PRESS};
+            input->push(event);
+        }
+    }
+
+    InputSystem(const InputSystem &);
+    InputSystem &operator=(const InputSystem &);
+};
+
+#endif
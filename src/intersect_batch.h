@@ -0,0 +1,221 @@
+#ifndef INTERSECT_BATCH_H
+#define INTERSECT_BATCH_H
+
+#include <cstdint>
+#include <limits>
+
+#include "glm/glm.hpp"
+
+#include "simd.h"
+#include "bounds.h"
+
+// Batched versions of the glm/gtx/intersect.hpp queries: one ray (or one
+// swept circle) against a whole SoA primitive set, 8 primitives per step.
+//
+// Each query returns the nearest hit. If hitMask is not NULL it receives one
+// byte per group of 8 primitives, bit i set when primitive 8 * group + i is
+// hit within [0, maxDistance].
+
+struct BatchHit {
+    float distance; // ray parameter of the nearest hit
+    int index;      // primitive index, -1 if nothing was hit
+};
+
+// keeps the per-lane nearest hit while walking the groups
+struct NearestLanes {
+    float8 bestT;
+    float8 bestIndex;
+
+    NearestLanes() : bestT(float8::broadcast(std::numeric_limits<float>::infinity())),
+                     bestIndex(float8::broadcast(-1.0f)) {}
+
+    void update(const mask8 &hit, const float8 &t, size_t group) {
+        mask8 closer = hit & (t < bestT);
+        bestT = select(closer, t, bestT);
+        bestIndex = select(closer, float8::iota((float)(group * 8)), bestIndex);
+    }
+    BatchHit reduce() const {
+        float t[8], idx[8];
+        bestT.store(t);
+        bestIndex.store(idx);
+        BatchHit hit = {std::numeric_limits<float>::infinity(), -1};
+        for (int i = 0; i < 8; i++) {
+            if (idx[i] >= 0.0f && t[i] < hit.distance) {
+                hit.distance = t[i];
+                hit.index = (int)idx[i];
+            }
+        }
+        return hit;
+    }
+};
+
+// dir must be normalized, as for glm::intersectRaySphere
+inline BatchHit intersectRaySpheres(const glm::vec3 &orig, const glm::vec3 &dir, const SphereSoA &spheres,
+                                    float maxDistance = std::numeric_limits<float>::infinity(),
+                                    uint8_t *hitMask = NULL) {
+    const float8 ox = float8::broadcast(orig.x), oy = float8::broadcast(orig.y), oz = float8::broadcast(orig.z);
+    const float8 dx = float8::broadcast(dir.x), dy = float8::broadcast(dir.y), dz = float8::broadcast(dir.z);
+    const float8 zero = float8::broadcast(0.0f), tMax = float8::broadcast(maxDistance);
+    NearestLanes nearest;
+
+    for (size_t g = 0; g < spheres.groups(); g++) {
+        size_t i = g * 8;
+        float8 ocx = float8::load(spheres[SphereSoA::X] + i) - ox;
+        float8 ocy = float8::load(spheres[SphereSoA::Y] + i) - oy;
+        float8 ocz = float8::load(spheres[SphereSoA::Z] + i) - oz;
+        float8 r = float8::load(spheres[SphereSoA::R] + i);
+
+        float8 tca = fmadd(ocx, dx, fmadd(ocy, dy, ocz * dz));
+        float8 d2 = fmadd(ocx, ocx, fmadd(ocy, ocy, ocz * ocz)) - tca * tca;
+        float8 r2 = r * r;
+        mask8 hit = (d2 <= r2) & mask8::firstLanes(spheres.size() - i);
+        float8 thc = sqrt(max(r2 - d2, zero));
+        float8 t0 = tca - thc;
+        // origin inside the sphere: the exit point is the hit, like glm
+        float8 t = select(t0 >= zero, t0, tca + thc);
+        hit = hit & (t >= zero) & (t <= tMax);
+
+        nearest.update(hit, t, g);
+        if (hitMask) hitMask[g] = (uint8_t)hit.bits();
+    }
+    return nearest.reduce();
+}
+
+// slab test, dir does not need to be normalized; an origin inside a box hits at 0
+inline BatchHit intersectRayAabbs(const glm::vec3 &orig, const glm::vec3 &dir, const AabbSoA &boxes,
+                                  float maxDistance = std::numeric_limits<float>::infinity(),
+                                  uint8_t *hitMask = NULL) {
+    const glm::vec3 inv = 1.0f / dir;
+    const float8 ox = float8::broadcast(orig.x), oy = float8::broadcast(orig.y), oz = float8::broadcast(orig.z);
+    const float8 ix = float8::broadcast(inv.x), iy = float8::broadcast(inv.y), iz = float8::broadcast(inv.z);
+    const float8 zero = float8::broadcast(0.0f), tMax = float8::broadcast(maxDistance);
+    NearestLanes nearest;
+
+    for (size_t g = 0; g < boxes.groups(); g++) {
+        size_t i = g * 8;
+        float8 tx1 = (float8::load(boxes[AabbSoA::MIN_X] + i) - ox) * ix;
+        float8 tx2 = (float8::load(boxes[AabbSoA::MAX_X] + i) - ox) * ix;
+        float8 ty1 = (float8::load(boxes[AabbSoA::MIN_Y] + i) - oy) * iy;
+        float8 ty2 = (float8::load(boxes[AabbSoA::MAX_Y] + i) - oy) * iy;
+        float8 tz1 = (float8::load(boxes[AabbSoA::MIN_Z] + i) - oz) * iz;
+        float8 tz2 = (float8::load(boxes[AabbSoA::MAX_Z] + i) - oz) * iz;
+
+        float8 tNear = max(max(min(tx1, tx2), min(ty1, ty2)), min(tz1, tz2));
+        float8 tFar = min(min(max(tx1, tx2), max(ty1, ty2)), max(tz1, tz2));
+        float8 t = max(tNear, zero);
+        mask8 hit = (tFar >= t) & (t <= tMax) & mask8::firstLanes(boxes.size() - i);
+
+        nearest.update(hit, t, g);
+        if (hitMask) hitMask[g] = (uint8_t)hit.bits();
+    }
+    return nearest.reduce();
+}
+
+// Moller-Trumbore, double sided like glm::intersectRayTriangle
+inline BatchHit intersectRayTriangles(const glm::vec3 &orig, const glm::vec3 &dir, const TriangleSoA &tris,
+                                      float maxDistance = std::numeric_limits<float>::infinity(),
+                                      uint8_t *hitMask = NULL) {
+    const float8 ox = float8::broadcast(orig.x), oy = float8::broadcast(orig.y), oz = float8::broadcast(orig.z);
+    const float8 dx = float8::broadcast(dir.x), dy = float8::broadcast(dir.y), dz = float8::broadcast(dir.z);
+    const float8 zero = float8::broadcast(0.0f), one = float8::broadcast(1.0f);
+    const float8 eps = float8::broadcast(std::numeric_limits<float>::epsilon());
+    const float8 tMax = float8::broadcast(maxDistance);
+    NearestLanes nearest;
+
+    for (size_t g = 0; g < tris.groups(); g++) {
+        size_t i = g * 8;
+        float8 e1x = float8::load(tris[TriangleSoA::E1_X] + i);
+        float8 e1y = float8::load(tris[TriangleSoA::E1_Y] + i);
+        float8 e1z = float8::load(tris[TriangleSoA::E1_Z] + i);
+        float8 e2x = float8::load(tris[TriangleSoA::E2_X] + i);
+        float8 e2y = float8::load(tris[TriangleSoA::E2_Y] + i);
+        float8 e2z = float8::load(tris[TriangleSoA::E2_Z] + i);
+
+        // p = cross(dir, e2)
+        float8 px = dy * e2z - dz * e2y;
+        float8 py = dz * e2x - dx * e2z;
+        float8 pz = dx * e2y - dy * e2x;
+        float8 det = fmadd(e1x, px, fmadd(e1y, py, e1z * pz));
+        mask8 hit = (abs(det) > eps) & mask8::firstLanes(tris.size() - i);
+        float8 invDet = one / select(hit, det, one);
+
+        float8 sx = ox - float8::load(tris[TriangleSoA::V0_X] + i);
+        float8 sy = oy - float8::load(tris[TriangleSoA::V0_Y] + i);
+        float8 sz = oz - float8::load(tris[TriangleSoA::V0_Z] + i);
+        float8 u = fmadd(sx, px, fmadd(sy, py, sz * pz)) * invDet;
+
+        // q = cross(s, e1)
+        float8 qx = sy * e1z - sz * e1y;
+        float8 qy = sz * e1x - sx * e1z;
+        float8 qz = sx * e1y - sy * e1x;
+        float8 v = fmadd(dx, qx, fmadd(dy, qy, dz * qz)) * invDet;
+        float8 t = fmadd(e2x, qx, fmadd(e2y, qy, e2z * qz)) * invDet;
+
+        hit = hit & (u >= zero) & (v >= zero) & (u + v <= one) & (t > eps) & (t <= tMax);
+
+        nearest.update(hit, t, g);
+        if (hitMask) hitMask[g] = (uint8_t)hit.bits();
+    }
+    return nearest.reduce();
+}
+
+// Circle of `radius` moving from `center` to `center + motion` against 2D
+// segments. The distance is the fraction of `motion` travelled at first
+// contact (0 if already touching), only hits in [0, 1] are reported.
+// This is a ray cast against each segment grown into a capsule: the two
+// offset sides plus the two end caps.
+inline BatchHit intersectSweptCircleSegments(const glm::vec2 &center, const glm::vec2 &motion, float radius,
+                                             const SegmentSoA &segments, uint8_t *hitMask = NULL) {
+    const float inf = std::numeric_limits<float>::infinity();
+    const float8 cx = float8::broadcast(center.x), cy = float8::broadcast(center.y);
+    const float8 mx = float8::broadcast(motion.x), my = float8::broadcast(motion.y);
+    const float8 r = float8::broadcast(radius), r2 = float8::broadcast(radius * radius);
+    const float8 zero = float8::broadcast(0.0f), one = float8::broadcast(1.0f);
+    const float8 tiny = float8::broadcast(1e-12f), infinity = float8::broadcast(inf);
+    const float8 mm = float8::broadcast(glm::dot(motion, motion));
+    NearestLanes nearest;
+
+    for (size_t g = 0; g < segments.groups(); g++) {
+        size_t i = g * 8;
+        float8 ax = float8::load(segments[SegmentSoA::A_X] + i);
+        float8 ay = float8::load(segments[SegmentSoA::A_Y] + i);
+        float8 abx = float8::load(segments[SegmentSoA::B_X] + i) - ax;
+        float8 aby = float8::load(segments[SegmentSoA::B_Y] + i) - ay;
+        float8 len2 = max(fmadd(abx, abx, aby * aby), tiny);
+
+        // sides: signed distance to the supporting line along its normal
+        float8 invLen = one / sqrt(len2);
+        float8 nx = -aby * invLen, ny = abx * invLen;
+        float8 acx = cx - ax, acy = cy - ay;
+        float8 dist = fmadd(acx, nx, acy * ny);
+        float8 vel = fmadd(mx, nx, my * ny);
+        float8 side = select(dist >= zero, one, -one);
+        float8 approach = -(vel * side);
+        float8 tSide = (abs(dist) - r) / select(approach > zero, approach, one);
+        tSide = select(abs(dist) <= r, zero, tSide);
+        float8 ux = fmadd(mx, tSide, acx), uy = fmadd(my, tSide, acy);
+        float8 along = fmadd(ux, abx, uy * aby) / len2;
+        mask8 sideHit = ((approach > zero) | (abs(dist) <= r)) & (tSide >= zero) & (along >= zero) & (along <= one);
+        float8 t = select(sideHit, tSide, infinity);
+
+        // caps at a and b: |c + m t - p|^2 = r^2
+        for (int cap = 0; cap < 2; cap++) {
+            float8 ox = cap ? acx - abx : acx;
+            float8 oy = cap ? acy - aby : acy;
+            float8 b = fmadd(ox, mx, oy * my);
+            float8 c = fmadd(ox, ox, oy * oy) - r2;
+            float8 disc = b * b - mm * c;
+            float8 tCap = (-b - sqrt(max(disc, zero))) / max(mm, tiny);
+            tCap = select(c <= zero, zero, tCap);
+            mask8 capHit = (disc >= zero) & (tCap >= zero) & ((c <= zero) | (mm > tiny));
+            t = select(capHit, min(t, tCap), t);
+        }
+
+        mask8 hit = (t <= one) & mask8::firstLanes(segments.size() - i);
+        nearest.update(hit, t, g);
+        if (hitMask) hitMask[g] = (uint8_t)hit.bits();
+    }
+    return nearest.reduce();
+}
+
+#endif
@@ -1,12 +1,39 @@
 #include "shader.h"
-
+#include "gl_state.h"
+#include "render_queue.h"
+#include "stream_buffer.h"
+#include "std140.h"
+#include "shader_watcher.h"
+#include "shader_variants.h"
+#include "headless_context.h"
+#include "render_target.h"
+#include "frame_readback.h"
+#include "frame_capture.h"
+#include "frame_scheduler.h"
+#include "game.h"
+#include "ai.h"
+#include "particles.h"
+#include "particle_renderer.h"
+#include "sdf_font.h"
+#include "text_renderer.h"
+#include "input.h"
+#include "rollback.h"
+#include "replay.h"
+
+#ifdef __APPLE__
 #include <GLUT/glut.h>
+#endif
 #include <GLFW/glfw3.h>
 
 #include "stb_image.h"
 
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
 #include <cmath>
+#include <chrono>
+#include <algorithm>
 
 // Import OpenGL Mathematics
 #include "glm/glm.hpp"
@@ -20,38 +47,155 @@ const unsigned int SCR_HEIGHT = 600;
 // Declare functions
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
+bool writeScreenshot(const char *path, const FrameReadback::Frame &frame);
 
-int main()
+int main(int argc, char **argv)
 {
-    // Initialize GLFW and configure
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // safe on mac
-
-    // Create a window object
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
-    {
-      std::cout << "Failed to create GLFW window" << std::endl;
-      glfwTerminate();
-      return -1;
+    // --headless renders offscreen, without a window or a display (CI, render farms):
+    //   --frames N          frames to render before exiting (default 120)
+    //   --screenshot F.ppm  save the last frame
+    // --capture F.y4m|F.qoi records every frame, windowed or headless
+    // Frame pacing (see frame_scheduler.h):
+    //   --swap-interval N   vsync every N refreshes, 0 = off (default 1)
+    //   --fps N             frame rate cap without vsync
+    //   --late-input        sleep before sampling input rather than in the swap
+    //   --sim-rate N        fixed simulation steps per second (default 120)
+    // Online match against another instance, rollback netcode over UDP:
+    //   --port N            local UDP port
+    //   --peer HOST:PORT    the other side (without it, the first one to send)
+    //   --player 0|1        the paddle played here, left or right
+    // Replays (inputs and keyframes, see replay.h):
+    //   --record F.replay   record the match (online, the ticks confirmed by then)
+    //   --replay F.replay   play a recorded match instead
+    //   --seek TICK         start the replay there
+    //   --replay-speed N    ticks played per simulation step (fast-forward)
+    // --ai easy|normal|hard  the computer plays the right paddle (local match)
+    // Particles (sparks, trails, goal explosions):
+    //   --particles N         keep N more alive from a fountain, to load test
+    //   --particle-threads N  update and upload them on N workers besides this thread
+    FrameScheduler scheduler;
+    scheduler.settings.simulationRate = 120.0;
+    bool headless = false;
+    unsigned long frameLimit = 120;
+    const char *screenshotPath = NULL;
+    const char *capturePath = NULL;
+    int netPort = -1, localPlayer = 0;
+    const char *peerAddress = NULL;
+    const char *recordPath = NULL, *replayPath = NULL;
+    unsigned long replaySeek = 0, replaySpeed = 1;
+    bool aiOpponent = false;
+    unsigned long stressParticles = 0;
+    unsigned int particleThreads = 0;
+    AiSettings aiSettings;
+    for (int i = 1; i < argc; i++) {
+      std::string arg = argv[i];
+      if (arg == "--headless") headless = true;
+      else if (arg == "--frames" && i + 1 < argc) frameLimit = strtoul(argv[++i], NULL, 10);
+      else if (arg == "--screenshot" && i + 1 < argc) screenshotPath = argv[++i];
+      else if (arg == "--capture" && i + 1 < argc) capturePath = argv[++i];
+      else if (arg == "--swap-interval" && i + 1 < argc) scheduler.settings.swapInterval = atoi(argv[++i]);
+      else if (arg == "--fps" && i + 1 < argc) scheduler.settings.targetFps = atof(argv[++i]);
+      else if (arg == "--late-input") scheduler.settings.lateInput = true;
+      else if (arg == "--sim-rate" && i + 1 < argc) scheduler.settings.simulationRate = atof(argv[++i]);
+      else if (arg == "--port" && i + 1 < argc) netPort = atoi(argv[++i]);
+      else if (arg == "--peer" && i + 1 < argc) peerAddress = argv[++i];
+      else if (arg == "--player" && i + 1 < argc) localPlayer = atoi(argv[++i]) == 1 ? 1 : 0;
+      else if (arg == "--record" && i + 1 < argc) recordPath = argv[++i];
+      else if (arg == "--replay" && i + 1 < argc) replayPath = argv[++i];
+      else if (arg == "--seek" && i + 1 < argc) replaySeek = strtoul(argv[++i], NULL, 10);
+      else if (arg == "--replay-speed" && i + 1 < argc) replaySpeed = strtoul(argv[++i], NULL, 10);
+      else if (arg == "--ai" && i + 1 < argc) {
+        std::string level = argv[++i];
+        aiOpponent = true;
+        aiSettings = level == "easy" ? AiSettings::easy() : level == "hard" ? AiSettings::hard() : AiSettings::normal();
+      }
+      else if (arg == "--particles" && i + 1 < argc) stressParticles = strtoul(argv[++i], NULL, 10);
+      else if (arg == "--particle-threads" && i + 1 < argc) particleThreads = (unsigned int)atoi(argv[++i]);
+      else std::cout << "Unknown argument " << arg << std::endl;
+    }
+
+    GLFWwindow* window = NULL;
+    HeadlessContext headlessContext;
+    InputSystem input;
+    if (headless) {
+      // GL 3.3 core context through EGL or OSMesa
+      if (!headlessContext.create(SCR_WIDTH, SCR_HEIGHT)) return -1;
+      std::cout << "Headless context: " << headlessContext.name() << std::endl;
+      // no display to sync to: frames are 1/60 s apart whatever the render speed, so runs are reproducible
+      scheduler.settings.swapInterval = 0;
+      scheduler.settings.fixedFrameTime = 1.0 / 60.0;
+    }
+    else {
+      // Initialize GLFW and configure
+      glfwInit();
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+      glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+      glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // safe on mac
+
+      // Create a window object
+      window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+      if (window == NULL)
+      {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+      }
+      glfwMakeContextCurrent(window);
+      glfwSwapInterval(scheduler.settings.swapInterval);
+      const GLFWvidmode *mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+      if (mode && mode->refreshRate > 0) scheduler.settings.refreshRate = mode->refreshRate;
+      // For resizing the window > set the callback function
+      glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); 
+      // Paddle keys are queued with their timestamps, also while the frame waits
+      input.attach(window);
+      scheduler.waitEvents = [](double seconds) { glfwWaitEventsTimeout(seconds); };
     }
-    glfwMakeContextCurrent(window);
-    // For resizing the window > set the callback function
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); 
 
-    // Initialise GLEW
-    if(GLEW_OK != glewInit()){
+    // Initialise GLEW (core profile entry points need glewExperimental)
+    glewExperimental = GL_TRUE;
+    GLenum glewStatus = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // a GLX build of GLEW loads the GL functions first, then fails to find an X display
+    if (headless && glewStatus == GLEW_ERROR_NO_GLX_DISPLAY) glewStatus = GLEW_OK;
+#endif
+    if(GLEW_OK != glewStatus){
       std::cout << "Failed to initialize GLEW" << std::endl;
 
       return -1;
     }
 
-    // Create a shader object
-    Shader ourShader("/Users/simonbelanger/Documents/Personnel/Code/cpp/learnOpenGL/bin/Shaders/vShader.glsl", 
-    "/Users/simonbelanger/Documents/Personnel/Code/cpp/learnOpenGL/bin/Shaders/fShader.glsl");
+    // Compile shaders on the driver threads when possible (hot reload)
+    Shader::enableParallelCompile();
+
+    // Create a shader object (paths relative to the project root). fShader.glsl
+    // is specialised by TEXTURE_COUNT, one program per permutation.
+    ShaderVariants shaderVariants;
+    ShaderDefines twoTextures;
+    twoTextures["TEXTURE_COUNT"] = "2";
+    Shader &ourShader = *shaderVariants.get("bin/Shaders/vShader.glsl", "bin/Shaders/fShader.glsl", twoTextures);
+    ShaderDefines noTexture;
+    noTexture["TEXTURE_COUNT"] = "0";
+    Shader &flatShader = *shaderVariants.get("bin/Shaders/vShader.glsl", "bin/Shaders/fShader.glsl", noTexture);
+
+    // the other permutations are prepared in the background
+    std::vector<ShaderVariants::Request> permutations;
+    for (int textures = 0; textures < 2; textures++) {
+      ShaderVariants::Request request = {"bin/Shaders/vShader.glsl", "bin/Shaders/fShader.glsl", ShaderDefines()};
+      request.defines["TEXTURE_COUNT"] = std::to_string(textures);
+      permutations.push_back(request);
+    }
+    shaderVariants.prewarm(permutations);
+
+    Shader &particleShader = *shaderVariants.get("bin/Shaders/vParticle.glsl", "bin/Shaders/fParticle.glsl",
+                                                  ShaderDefines());
+    Shader &textShader = *shaderVariants.get("bin/Shaders/vText.glsl", "bin/Shaders/fText.glsl", ShaderDefines());
+
+    // Reload the shaders when their files are saved, the prewarmed
+    // permutations too as they come in
+    ShaderWatcher shaderWatcher;
+    shaderVariants.setWatcher(&shaderWatcher);
+    shaderWatcher.start();
 
     // Rectangle to render in Normalized Device Coordinates (NDC)
     float vertices[] = {
@@ -72,12 +216,12 @@ int main()
     glGenBuffers(1, &VBO);      // Vertex Array Buffer
     glGenBuffers(1, &EBO);      // Element Array Buffer
 
-    glBindVertexArray(VAO);
+    glState().bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);  
+    glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);  
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
     // Linking position vertex attributes
@@ -93,7 +237,7 @@ int main()
     // Load a texture
     unsigned int texture1, texture2;
     glGenTextures(1, &texture1);
-    glBindTexture(GL_TEXTURE_2D, texture1);
+    glState().bindTexture(0, GL_TEXTURE_2D, texture1);
     // set the texture wrapping/filtering options (on the currently bound texture object)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -101,7 +245,7 @@ int main()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     //load and generate the texture
     int width, height, nrChannels;
-    unsigned char *data = stbi_load("/Users/simonbelanger/Documents/Personnel/Code/cpp/learnOpenGL/bin/Textures/container.jpg", 
+    unsigned char *data = stbi_load("bin/Textures/container.jpg", 
                           &width, &height, &nrChannels, 0);
     if (data) {
       glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
@@ -113,7 +257,7 @@ int main()
     stbi_image_free(data);
 
     glGenTextures(1, &texture2);
-    glBindTexture(GL_TEXTURE_2D, texture2);
+    glState().bindTexture(0, GL_TEXTURE_2D, texture2);
     // set the texture wrapping/filtering options (on the currently bound texture object)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -122,7 +266,7 @@ int main()
     
     //load and generate another texture
     stbi_set_flip_vertically_on_load(true);  
-    data = stbi_load("/Users/simonbelanger/Documents/Personnel/Code/cpp/learnOpenGL/bin/Textures/awesomeface.png", 
+    data = stbi_load("bin/Textures/awesomeface.png", 
                           &width, &height, &nrChannels, 0);
     if (data) {
       glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
@@ -133,60 +277,358 @@ int main()
     }
     stbi_image_free(data);
 
+    // Particle sprite, white with the shape in the alpha channel
+    unsigned int particleTexture;
+    glGenTextures(1, &particleTexture);
+    glState().bindTexture(0, GL_TEXTURE_2D, particleTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    data = stbi_load("bin/Textures/particle.png", &width, &height, &nrChannels, 4);
+    if (data) {
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+      glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    else {
+      std::cout << "Failed to load texture" << std::endl;
+    }
+    stbi_image_free(data);
+
     ourShader.use(); // don't forget to activate the shader before setting uniforms!  
-    glUniform1i(glGetUniformLocation(ourShader.ID, "texture1"), 0); // set it manually
-    ourShader.setInt("texture2", 1); // or with shader class
+    ourShader.setInt("texture1", 0); // through the shader class so a reload keeps them
+    ourShader.setInt("texture2", 1);
+    particleShader.use();
+    particleShader.setInt("sprite", 0);
+    textShader.use();
+    textShader.setInt("atlas", 0);
+
+    // Score and HUD font, a distance field atlas generated on every core the
+    // first time and read from the cache after that
+    SdfFont font;
+    {
+      ThreadPool fontPool;
+      font.loadOrGenerate("bin/Textures/hud_font.sdf", &fontPool);
+    }
+    if (!font.stats.fromCache) std::cout << "SDF font generated in " << font.stats.generateMs << " ms" << std::endl;
+    TextRenderer *textRenderer = new TextRenderer(font, 256);
+
+    // Draws are sorted by shader and textures before being issued
+    RenderQueue renderQueue;
+    unsigned int containerShader = renderQueue.addShader(&ourShader);
+    GLuint containerTextureIDs[] = {texture1, texture2};
+    unsigned int containerTextures = renderQueue.addTextureSet(containerTextureIDs, 2);
+    unsigned int gameShader = renderQueue.addShader(&flatShader);
+    unsigned int gameTextures = renderQueue.addTextureSet(NULL, 0);
+    unsigned int particleShaderIndex = renderQueue.addShader(&particleShader);
+    unsigned int particleTextures = renderQueue.addTextureSet(&particleTexture, 1);
+    unsigned int textShaderIndex = renderQueue.addShader(&textShader);
+    unsigned int textTextures = renderQueue.addTextureSet(&textRenderer->atlasTexture, 1);
+
+    // Uniform blocks: one "Frame" block shared by every program, and the
+    // "Object" blocks of all draws packed in one buffer (see render_queue.h)
+    StreamBuffer *uniformStream = new StreamBuffer(GL_UNIFORM_BUFFER, 256 * 1024);
+    renderQueue.setObjectUniforms(uniformStream);
+    GLint uniformAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+
+    // Headless: draw into a framebuffer object and copy the frames back asynchronously
+    RenderTarget *renderTarget = NULL;
+    FrameReadback *readback = NULL;
+    if (headless) {
+      renderTarget = new RenderTarget(SCR_WIDTH, SCR_HEIGHT);
+      readback = new FrameReadback(SCR_WIDTH, SCR_HEIGHT);
+    }
+
+    // Video capture, read back and written on a worker thread
+    FrameCapture *capture = NULL;
+    if (capturePath) {
+      int captureWidth = SCR_WIDTH, captureHeight = SCR_HEIGHT;
+      if (!headless) glfwGetFramebufferSize(window, &captureWidth, &captureHeight);
+      capture = new FrameCapture(capturePath, captureWidth, captureHeight);
+    }
+
+    // Pong, stepped at the simulation rate and drawn between the last two steps
+    GameConfig gameConfig;
+    GameState game, previousGame;
+    resetGame(gameConfig, game, 1u);
+    previousGame = game;
+
+    // Playback replaces the live match
+    ReplayPlayer replay;
+    if (replayPath) {
+      if (!replay.load(replayPath)) return -1;
+      replay.seek((uint32_t)replaySeek);
+      game = previousGame = replay.current();
+      std::cout << "Replay: " << replay.tickCount << " ticks, from tick " << replay.currentTick() << std::endl;
+    }
+
+    // Online, the session owns the match and the steps must all be the same size
+    UdpTransport udp;
+    RollbackSession *session = NULL;
+    if (netPort >= 0 || peerAddress) {
+      if (scheduler.settings.simulationRate <= 0) scheduler.settings.simulationRate = 120.0;
+      if (!udp.open(netPort >= 0 ? netPort : 0) || (peerAddress && !udp.connect(peerAddress))) return -1;
+      session = new RollbackSession(gameConfig, 1u, (float)scheduler.stepSeconds(), localPlayer, &udp);
+    }
+
+    AiPlayer aiPlayer(game.seed);
+
+    // Online, only the confirmed ticks are recorded: a predicted one may
+    // still be rolled back
+    ReplayWriter recorder;
+    uint32_t recordedTicks = 0;
+    if (recordPath && !replayPath)
+      recorder.open(recordPath, gameConfig, 1u, (float)scheduler.stepSeconds());
+
+    // Particles, drawn in one instanced draw after the rest
+    ThreadPool *particlePool = particleThreads ? new ThreadPool(particleThreads) : NULL;
+    size_t particleCapacity = 64 * 1024 + stressParticles;
+    ParticleSystem particles(particleCapacity);
+    ParticleRenderer *particleRenderer = new ParticleRenderer(particleCapacity);
+    Pcg32 particleRng(1u);
+    double particleTime = scheduler.renderTime(), particleUpdateMs = 0.0, particleUploadMs = 0.0;
+    size_t particlePeak = 0;
+
+    unsigned long framesRendered = 0, callsIssued = 0, callsElided = 0;
 
     // Render loop
-    while(!glfwWindowShouldClose(window)){
+    while(headless ? framesRendered < frameLimit : !glfwWindowShouldClose(window)){
+
+      // Waits for the frame's start time, input is sampled right after
+      scheduler.beginFrame();
 
       // Input
-      processInput(window);
+      InputSystem::Clock::time_point polled = InputSystem::Clock::time_point::min();
+      if (!headless) {
+        glfwPollEvents();
+        polled = InputSystem::Clock::now();
+        processInput(window);
+      }
+
+      // Swap in shaders edited since the last frame, and prewarmed variants
+      shaderWatcher.update();
+      shaderVariants.update();
+
+      // Fixed steps, each with the input events up to its end. The last one
+      // also takes everything polled above: the frame starts before the poll,
+      // and those events would otherwise wait for the next frame
+      int steps = scheduler.simulationSteps();
+      for (int step = 0; step < steps; step++) {
+        double stepEnd = scheduler.simulationTime() - (steps - 1 - step) * scheduler.stepSeconds();
+        InputSystem::Clock::time_point until = scheduler.wallTime(stepEnd);
+        if (step == steps - 1) until = std::max(until, polled);
+        PaddleInput paddles[InputSystem::PLAYERS];
+        input.consume(until, paddles);
+        previousGame = game;
+        if (replayPath) {
+          replay.advance((uint32_t)replaySpeed);
+          game = replay.current();
+        }
+        else if (session) {
+          // either key set moves the local paddle
+          session->advance(paddles[0].move ? paddles[0] : paddles[1]);
+          game = session->current();
+          GameState confirmedState;
+          PaddleInput confirmedInputs[2];
+          while (session->confirmedInputs(recordedTicks, confirmedState, confirmedInputs)) {
+            recorder.record(confirmedState, confirmedInputs);
+            recordedTicks++;
+          }
+        }
+        else {
+          if (aiOpponent) paddles[1] = aiInput(gameConfig, aiSettings, game, 1, aiPlayer, (float)scheduler.stepSeconds());
+          recorder.record(game, paddles);
+          stepGame(gameConfig, game, paddles, (float)scheduler.stepSeconds());
+        }
+        emitGameParticles(particles, gameConfig, previousGame, game, particleRng);
+      }
+      float time = (float)scheduler.renderTime();
+
+      // Particles move once a frame, by the time rendered since the last one
+      std::chrono::steady_clock::time_point particleStart = std::chrono::steady_clock::now();
+      float particleDt = (float)(scheduler.renderTime() - particleTime);
+      particleTime = scheduler.renderTime();
+      if (stressParticles && particles.size() < particleCapacity) {
+        ParticleBurst fountain;
+        fountain.position = glm::vec2(0.0f, -gameConfig.halfSize.y);
+        fountain.count = (int)std::min<size_t>(particleCapacity - particles.size(), stressParticles / 30 + 1);
+        fountain.direction = glm::half_pi<float>();
+        fountain.spread = 1.0f;
+        fountain.speedMin = 1.0f;
+        fountain.speedMax = 2.5f;
+        fountain.lifetimeMin = 1.0f;
+        fountain.lifetimeMax = 2.0f;
+        fountain.size = 0.01f;
+        fountain.color = glm::vec4(0.3f, 0.6f, 1.0f, 0.5f);
+        particles.emit(fountain, particleRng);
+      }
+      particles.update(particleDt, particlePool);
+      particlePeak = std::max(particlePeak, particles.size());
+      particleUpdateMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                                    particleStart).count();
 
       // Rendering
+      if (renderTarget) renderTarget->bind();
       glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
       glClear(GL_COLOR_BUFFER_BIT);
 
-      // bind texture
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, texture1);
-      glActiveTexture(GL_TEXTURE1);
-      glBindTexture(GL_TEXTURE_2D, texture2);
+      // Per-frame uniforms, uploaded once for all programs
+      uniformStream->beginFrame();
+      glm::mat4 viewProjection = glm::mat4(1.0f); // vertices are already in NDC
+      size_t frameBlockSize = Std140Writer().write(viewProjection).write(0.0f).size();
+      StreamBuffer::Allocation frameBlock = uniformStream->allocate(frameBlockSize, uniformAlignment);
+      if (frameBlock.ptr) {
+        Std140Writer(frameBlock.ptr).write(viewProjection).write(time);
+        uniformStream->commit(frameBlock);
+        glState().bindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, uniformStream->ID,
+                                  frameBlock.offset, frameBlock.size);
+      }
 
       // Rotating over time
       glm::mat4 trans = glm::mat4(1.0f);
       trans = glm::translate(trans, glm::vec3(0.5f, -0.5f, 0.0f));                          
-      trans = glm::rotate(trans, (float)glfwGetTime(), glm::vec3(0.0f, 0.0f, 1.0f));
-      unsigned int transformLoc = glGetUniformLocation(ourShader.ID, "transform");
-      glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(trans));
+      trans = glm::rotate(trans, time, glm::vec3(0.0f, 0.0f, 1.0f));
 
-      // Render first container (rotating)
-      ourShader.use();
-      glBindVertexArray(VAO);
-      glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+      // Queue first container (rotating)
+      DrawCommand container = {VAO, GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, trans};
+      renderQueue.submit(RenderQueue::makeKey(0, containerShader, containerTextures, 0.5f), container);
 
       // Scaling over time
       trans = glm::mat4(1.0f);       
       trans = glm::translate(trans, glm::vec3(-0.5f, 0.5f, 0.0f));                          
-      trans = glm::scale(trans, glm::vec3(sin((float)glfwGetTime()) / 2.0f + 0.5f, sin((float)glfwGetTime()) / 2.0f + 0.5f, 1.0f));
-      glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(trans));
+      trans = glm::scale(trans, glm::vec3(sin(time) / 2.0f + 0.5f, sin(time) / 2.0f + 0.5f, 1.0f));
+
+      // Queue second container (scaling)
+      container.transform = trans;
+      renderQueue.submit(RenderQueue::makeKey(0, containerShader, containerTextures, 0.5f), container);
+
+      // Queue the game on top: paddles and ball, unit quads scaled from field units to NDC
+      float alpha = (float)scheduler.interpolation();
+      bool rallying = previousGame.score[0] == game.score[0] && previousGame.score[1] == game.score[1];
+      glm::mat4 fieldToNdc = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / gameConfig.halfSize, 1.0f));
+      DrawCommand piece = {VAO, GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, glm::mat4(1.0f)};
+      for (int side = 0; side < 2; side++) {
+        float y = glm::mix(previousGame.paddleY[side], game.paddleY[side], alpha);
+        piece.transform = glm::translate(fieldToNdc, glm::vec3(paddleCentreX(gameConfig, side), y, 0.0f));
+        piece.transform = glm::scale(piece.transform, glm::vec3(2.0f * gameConfig.paddleHalf, 1.0f));
+        renderQueue.submit(RenderQueue::makeKey(1, gameShader, gameTextures, 0.5f), piece);
+      }
+      glm::vec2 ball = rallying ? glm::mix(previousGame.ball, game.ball, alpha) : game.ball;
+      piece.transform = glm::translate(fieldToNdc, glm::vec3(ball, 0.0f));
+      piece.transform = glm::scale(piece.transform, glm::vec3(glm::vec2(2.0f * gameConfig.ballRadius), 1.0f));
+      renderQueue.submit(RenderQueue::makeKey(1, gameShader, gameTextures, 0.5f), piece);
+
+      // Sort the draws and issue them, binding shader and textures once per bucket
+      renderQueue.flush();
+
+      // Then the particles, added up over the rest
+      particleStart = std::chrono::steady_clock::now();
+      DrawCommand particleDraw;
+      if (particleRenderer->prepare(particles, fieldToNdc, particleDraw, particlePool)) {
+        glState().setBlend(true);
+        glState().blendFunc(GL_SRC_ALPHA, GL_ONE);
+        renderQueue.submit(RenderQueue::makeKey(2, particleShaderIndex, particleTextures, 0.5f), particleDraw);
+        renderQueue.flush();
+        glState().setBlend(false);
+      }
+      particleRenderer->endFrame();
+      particleUploadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                                    particleStart).count();
+
+      // Score and HUD over everything, one draw for all the text
+      const glm::vec4 scoreColor(1.0f, 1.0f, 1.0f, 0.9f), hudColor(0.8f, 0.9f, 1.0f, 0.7f);
+      float top = gameConfig.halfSize.y - 0.08f;
+      textRenderer->add(std::to_string(game.score[0]), glm::vec2(-0.12f, top - 0.18f), 0.18f, scoreColor,
+                        TextRenderer::RIGHT);
+      textRenderer->add(std::to_string(game.score[1]), glm::vec2(0.12f, top - 0.18f), 0.18f, scoreColor);
+      std::string mode = replayPath ? "REPLAY " + std::to_string(replay.currentTick())
+                       : session ? "ONLINE P" + std::to_string(localPlayer + 1)
+                       : aiOpponent ? "VS AI" : "2 PLAYERS";
+      textRenderer->add(mode, glm::vec2(-gameConfig.halfSize.x + 0.05f, -gameConfig.halfSize.y + 0.05f), 0.05f,
+                        hudColor);
+      DrawCommand textDraw;
+      if (textRenderer->prepare(fieldToNdc, textDraw)) {
+        glState().setBlend(true);
+        glState().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        renderQueue.submit(RenderQueue::makeKey(3, textShaderIndex, textTextures, 0.5f), textDraw);
+        renderQueue.flush();
+        glState().setBlend(false);
+      }
+      textRenderer->endFrame();
+
+      uniformStream->endFrame();
+      scheduler.endWork();
+
+      if (capture) capture->capture(renderTarget ? renderTarget->framebuffer : 0);
+
+      if (headless) {
+        // Collect the finished copies, waiting only when every buffer is in use
+        FrameReadback::Frame frame;
+        while (readback->acquire(frame, readback->full())) readback->release();
+        readback->request(renderTarget->framebuffer, framesRendered);
+      }
+      else {
+        // Swap the buffers, blocks until the vblank with a swap interval
+        glfwSwapBuffers(window);   
+      }
+      scheduler.endFrame();
+
+      // State changes issued vs. skipped this frame
+      glState().endFrame();
+      framesRendered++;
+      callsIssued += glState().lastFrame.issued;
+      callsElided += glState().lastFrame.elided;
+    }
 
-      // Render second container (scaling)
-      ourShader.use();
-      glBindVertexArray(VAO);
-      glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    if (framesRendered > 0) {
+      std::cout << "GL state calls per frame: " << (double)callsIssued / framesRendered << " issued, "
+                << (double)callsElided / framesRendered << " elided" << std::endl;
+    }
+    scheduler.printStats(std::cout);
+    if (framesRendered > 0) {
+      std::cout << "Particles: " << particles.size() << " live at the end (peak " << particlePeak << ", "
+                << particles.stats.dropped << " dropped), update " << particleUpdateMs / framesRendered
+                << " ms, upload and draw " << particleUploadMs / framesRendered << " ms a frame" << std::endl;
+    }
+    if (session) {
+      std::cout << "Rollback: " << session->stats.rollbacks << " rollbacks, " << session->stats.resimulatedTicks
+                << " ticks resimulated (deepest " << session->stats.deepestRollback << "), "
+                << session->stats.stalls << " stalls, " << session->stats.desyncs << " desyncs" << std::endl;
+    }
 
-      // Check/Call events and swap the buffers
-      glfwSwapBuffers(window);   
-      glfwPollEvents(); 
+    if (headless) {
+      // The last frames are still in flight
+      FrameReadback::Frame frame;
+      while (readback->acquire(frame, true)) {
+        if (screenshotPath && frame.index + 1 == framesRendered) writeScreenshot(screenshotPath, frame);
+        readback->release();
+      }
     }
 
-    // Clean GLFW resources
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+    if (capture) {
+      capture->finish();
+      std::cout << "Captured " << capture->stats.written << " frames to " << capturePath << " ("
+                << capture->stats.stalls << " stalls, " << capture->stats.dropped << " dropped)" << std::endl;
+    }
 
-    glfwTerminate();
+    // Clean GLFW resources
+    glState().deleteVertexArrays(1, &VAO);
+    glState().deleteBuffers(1, &VBO);
+    glState().deleteBuffers(1, &EBO);
+    delete particleRenderer;
+    delete textRenderer;
+    delete particlePool;
+    delete capture;
+    delete readback;
+    delete renderTarget;
+    delete uniformStream;
+    delete session;
+    recorder.close();
+    shaderWatcher.stop();
+
+    if (headless) headlessContext.destroy();
+    else glfwTerminate();
   
     return 0;
 }
@@ -194,7 +636,7 @@ int main()
 // Function to execute when resizing the window
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-  glViewport(0, 0, width, height);
+  glState().setViewport(0, 0, width, height);
 }
 
 // Function to check if the escape key has been pressed
@@ -202,4 +644,25 @@ void processInput(GLFWwindow *window)
 {
     if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
-}
\ No newline at end of file
+}
+// Binary PPM of a read back frame (rows are bottom-up in GL)
+bool writeScreenshot(const char *path, const FrameReadback::Frame &frame)
+{
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+    if (!file) {
+        std::cout << "ERROR::SCREENSHOT::FILE_NOT_WRITTEN " << path << std::endl;
+        return false;
+    }
+    file << "P6\n" << frame.width << " " << frame.height << "\n255\n";
+    std::vector<char> row(frame.width * 3);
+    for (int y = frame.height - 1; y >= 0; y--) {
+        const unsigned char *src = frame.pixels + (size_t)y * frame.width * 4;
+        for (int x = 0; x < frame.width; x++) {
+            row[x * 3 + 0] = src[x * 4 + 0];
+            row[x * 3 + 1] = src[x * 4 + 1];
+            row[x * 3 + 2] = src[x * 4 + 2];
+        }
+        file.write(&row[0], row.size());
+    }
+    return true;
+}
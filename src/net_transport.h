@@ -0,0 +1,182 @@
+#ifndef NET_TRANSPORT_H
+#define NET_TRANSPORT_H
+
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <iostream>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "random.h"
+
+// Datagram transports for the netcode (rollback.h).
+//
+// Both are unreliable and unordered on purpose: the protocol above resends
+// what was not acknowledged, so a lost packet costs nothing but latency.
+// receive() never blocks and returns 0 when nothing is waiting.
+class Transport {
+
+public:
+    virtual ~Transport() {}
+    virtual bool send(const uint8_t *data, size_t size) = 0;
+    virtual size_t receive(uint8_t *data, size_t capacity) = 0;
+};
+
+// Non-blocking UDP socket talking to one peer. Without a peer address the
+// first packet received sets it (the side that listens).
+class UdpTransport : public Transport {
+
+public:
+    UdpTransport() : socketFd(-1), hasPeer(false) {
+        memset(&peer, 0, sizeof(peer));
+    }
+    ~UdpTransport() {
+        if (socketFd >= 0) close(socketFd);
+    }
+
+    // port 0 lets the system pick one
+    bool open(unsigned short port) {
+        socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (socketFd < 0) {
+            std::cout << "ERROR::UDP::SOCKET_NOT_CREATED" << std::endl;
+            return false;
+        }
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+        if (bind(socketFd, (sockaddr *)&address, sizeof(address)) < 0) {
+            std::cout << "ERROR::UDP::BIND_FAILED " << port << std::endl;
+            return false;
+        }
+        fcntl(socketFd, F_SETFL, fcntl(socketFd, F_GETFL, 0) | O_NONBLOCK);
+        return true;
+    }
+
+    // "host:port"
+    bool connect(const std::string &hostPort) {
+        size_t colon = hostPort.find_last_of(':');
+        if (colon == std::string::npos) {
+            std::cout << "ERROR::UDP::BAD_ADDRESS " << hostPort << std::endl;
+            return false;
+        }
+        addrinfo hints, *result = NULL;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        std::string host = hostPort.substr(0, colon), port = hostPort.substr(colon + 1);
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+            std::cout << "ERROR::UDP::ADDRESS_NOT_RESOLVED " << hostPort << std::endl;
+            return false;
+        }
+        memcpy(&peer, result->ai_addr, sizeof(peer));
+        freeaddrinfo(result);
+        hasPeer = true;
+        return true;
+    }
+
+    bool send(const uint8_t *data, size_t size) {
+        if (socketFd < 0 || !hasPeer) return false;
+        return sendto(socketFd, data, size, 0, (const sockaddr *)&peer, sizeof(peer)) == (ssize_t)size;
+    }
+
+    size_t receive(uint8_t *data, size_t capacity) {
+        if (socketFd < 0) return 0;
+        for (;;) {
+            sockaddr_in from;
+            socklen_t fromSize = sizeof(from);
+            ssize_t size = recvfrom(socketFd, data, capacity, 0, (sockaddr *)&from, &fromSize);
+            if (size <= 0) return 0;
+            if (!hasPeer) {
+                peer = from;
+                hasPeer = true;
+            }
+            // anything not from the peer is ignored
+            if (from.sin_addr.s_addr == peer.sin_addr.s_addr && from.sin_port == peer.sin_port) return (size_t)size;
+        }
+    }
+
+private:
+    int socketFd;
+    sockaddr_in peer;
+    bool hasPeer;
+
+    UdpTransport(const UdpTransport &);
+    UdpTransport &operator=(const UdpTransport &);
+};
+
+// In-process stand-in for a network link, e.g. src/bench/rollback_bench.cpp:
+// two endpoints joined by pair(), with one-way latency, jitter and loss.
+// Endpoints may be used from different threads.
+class LoopbackTransport : public Transport {
+
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    double latency; // seconds, one way
+    double jitter;  // seconds, added uniformly in [0, jitter]
+    double loss;    // probability of dropping a packet
+
+    LoopbackTransport(uint64_t seed = 1u)
+        : latency(0.0), jitter(0.0), loss(0.0), other(NULL), random(Pcg32::forStream(seed, 0x4C4F4F50u)) {}
+
+    static void pair(LoopbackTransport &a, LoopbackTransport &b) {
+        a.other = &b;
+        b.other = &a;
+    }
+
+    bool send(const uint8_t *data, size_t size) {
+        if (!other) return false;
+        if (unit() < loss) return true; // lost on the way
+        Packet packet;
+        packet.deliverAt = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                              std::chrono::duration<double>(latency + unit() * jitter));
+        packet.bytes.assign(data, data + size);
+        std::lock_guard<std::mutex> lock(other->mutex);
+        other->inbox.push_back(packet);
+        return true;
+    }
+
+    size_t receive(uint8_t *data, size_t capacity) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Clock::time_point now = Clock::now();
+        // with jitter packets overtake each other, like on a real network
+        for (size_t i = 0; i < inbox.size(); i++) {
+            if (inbox[i].deliverAt > now) continue;
+            size_t size = inbox[i].bytes.size() < capacity ? inbox[i].bytes.size() : capacity;
+            if (size) memcpy(data, &inbox[i].bytes[0], size);
+            inbox.erase(inbox.begin() + i);
+            return size;
+        }
+        return 0;
+    }
+
+private:
+    struct Packet {
+        Clock::time_point deliverAt;
+        std::vector<uint8_t> bytes;
+    };
+    LoopbackTransport *other;
+    std::mutex mutex;
+    std::deque<Packet> inbox;
+    Pcg32 random; // sender side only
+
+    double unit() { return (random.nextUInt() >> 8) * (1.0 / 16777216.0); }
+
+    LoopbackTransport(const LoopbackTransport &);
+    LoopbackTransport &operator=(const LoopbackTransport &);
+};
+
+#endif
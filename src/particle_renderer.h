@@ -0,0 +1,122 @@
+#ifndef PARTICLE_RENDERER_H
+#define PARTICLE_RENDERER_H
+
+#include <GL/glew.h>
+
+#include <cstring>
+
+#include "glm/glm.hpp"
+
+#include "gl_state.h"
+#include "stream_buffer.h"
+#include "render_queue.h"
+#include "thread_pool.h"
+#include "particles.h"
+
+// Draws a ParticleSystem as one instanced draw of a textured quad.
+//
+// The particle arrays go to the GPU the way they are stored: x, y, fade,
+// size and colour are copied as five plain arrays into this frame's region of
+// a StreamBuffer and each is an instanced attribute (divisor 1) of its own,
+// so there is no interleaving pass, only memcpy. The vertex shader
+// (bin/Shaders/vParticle.glsl) places and fades the quad from them.
+//
+// Attribute locations: 0 corner, 1 texture coords, then per instance 2 x,
+// 3 y, 4 fade, 5 size, 6 colour (normalized RGBA8).
+class ParticleRenderer {
+
+public:
+    GLuint vertexArray;
+
+    explicit ParticleRenderer(size_t capacity)
+        : stream(GL_ARRAY_BUFFER, (GLsizeiptr)(capacity * BYTES_PER_PARTICLE + ATTRIBUTES * ALIGNMENT)) {
+        const float quad[] = {
+            // corner       // texture coords
+            0.5f,  0.5f,    1.0f, 1.0f,
+            0.5f, -0.5f,    1.0f, 0.0f,
+           -0.5f, -0.5f,    0.0f, 0.0f,
+           -0.5f,  0.5f,    0.0f, 1.0f
+        };
+        const unsigned int indices[] = {0, 1, 3, 1, 2, 3};
+        glGenVertexArrays(1, &vertexArray);
+        glGenBuffers(1, &quadBuffer);
+        glGenBuffers(1, &indexBuffer);
+        glState().bindVertexArray(vertexArray);
+        glState().bindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+        glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        for (GLuint location = 2; location < 2 + ATTRIBUTES; location++) {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+    }
+
+    ~ParticleRenderer() {
+        glState().deleteVertexArrays(1, &vertexArray);
+        glState().deleteBuffers(1, &quadBuffer);
+        glState().deleteBuffers(1, &indexBuffer);
+    }
+
+    // uploads the live particles, false when there is nothing to draw; the
+    // copies are split over the pool when there is one
+    bool prepare(const ParticleSystem &particles, const glm::mat4 &transform, DrawCommand &command,
+                 ThreadPool *pool = NULL) {
+        stream.beginFrame();
+        const size_t count = particles.size();
+        if (count == 0) return false;
+        const size_t arrayBytes = (count * sizeof(float) + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+        StreamBuffer::Allocation block = stream.allocate((GLsizeiptr)(arrayBytes * ATTRIBUTES), ALIGNMENT);
+        if (!block.ptr) return false;
+
+        const void *sources[ATTRIBUTES] = {
+            particles.field(ParticleSystem::X), particles.field(ParticleSystem::Y),
+            particles.field(ParticleSystem::FADE), particles.field(ParticleSystem::SIZE),
+            particles.packedColors()
+        };
+        char *dst = (char *)block.ptr;
+        const size_t CHUNK = 64 * 1024; // floats a task
+        size_t chunks = (count + CHUNK - 1) / CHUNK;
+        auto copy = [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; c++) {
+                size_t first = c % chunks * CHUNK, n = count - first < CHUNK ? count - first : CHUNK;
+                size_t a = c / chunks;
+                memcpy(dst + a * arrayBytes + first * 4, (const char *)sources[a] + first * 4, n * 4);
+            }
+        };
+        if (pool && chunks > 1) pool->parallelFor(chunks * ATTRIBUTES, 1, copy);
+        else copy(0, chunks * ATTRIBUTES);
+        stream.commit(block);
+
+        // the arrays move around the buffer from frame to frame
+        glState().bindVertexArray(vertexArray);
+        glState().bindBuffer(GL_ARRAY_BUFFER, stream.ID);
+        for (GLuint a = 0; a < 4; a++)
+            glVertexAttribPointer(2 + a, 1, GL_FLOAT, GL_FALSE, 0, (void *)(block.offset + a * arrayBytes));
+        glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (void *)(block.offset + 4 * arrayBytes));
+
+        DrawCommand draw = {vertexArray, GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, transform, (GLsizei)count};
+        command = draw;
+        return true;
+    }
+
+    // after the draw was issued, fences this frame's copies
+    void endFrame() { stream.endFrame(); }
+
+private:
+    static const GLuint ATTRIBUTES = 5;
+    static const size_t BYTES_PER_PARTICLE = ATTRIBUTES * 4;
+    static const size_t ALIGNMENT = 64;
+
+    StreamBuffer stream;
+    GLuint quadBuffer, indexBuffer;
+
+    ParticleRenderer(const ParticleRenderer &);
+    ParticleRenderer &operator=(const ParticleRenderer &);
+};
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/constants.hpp"
+
+#include "simd.h"
+#include "half.h"
+#include "bounds.h"
+#include "random.h"
+#include "thread_pool.h"
+#include "game.h"
+
+// Particles: ball-hit sparks, goal explosions, the ball's trail.
+//
+// Every attribute is its own array (SoAArrays), allocated once for the
+// capacity, so update() streams through them in float8 groups: velocity,
+// position and the share of life left, which is also what the shader fades
+// by. At a million particles that is memory bound, so nothing is kept that
+// can be derived: no age, no seconds left, one fade and its rate.
+//
+// Particles never die in the middle of the kernel; it only leaves a bit per
+// dead lane, and a serial pass then swap-removes them from the highest index
+// down, each replaced by the last live particle. The live ones stay packed
+// in [0, size()) with no free list and no holes, ready to upload as they
+// are. Order is lost, which additive blending does not care about.
+//
+// With a ThreadPool the groups are split over the workers; the removal pass
+// only reads the dead bits, a few bytes a thousand particles.
+//
+// Built without AVX2 the groups are stepped a particle at a time, which is
+// as fast as the loop gets there; the update as a whole then trails a plain
+// loop over an array of structs that removes in place (see particles_bench).
+
+// a spray of particles from one point
+struct ParticleBurst {
+    glm::vec2 position;
+    glm::vec2 velocity;    // added to every particle, e.g. what the emitter carries
+    int count;
+    float direction;       // radians, centre of the spray
+    float spread;          // radians around it, 2 pi for every direction
+    float speedMin, speedMax;
+    float lifetimeMin, lifetimeMax; // seconds
+    float size;
+    glm::vec4 color;
+
+    ParticleBurst()
+        : position(0.0f), velocity(0.0f), count(1), direction(0.0f), spread(glm::two_pi<float>()),
+          speedMin(0.0f), speedMax(1.0f), lifetimeMin(0.5f), lifetimeMax(1.0f), size(0.02f), color(1.0f) {}
+};
+
+class ParticleSystem {
+
+public:
+    enum {
+        X, Y, VELOCITY_X, VELOCITY_Y,
+        FADE,      // share of the life left, 1 at birth, dead at 0
+        FADE_RATE, // 1 / lifetime in seconds
+        SIZE, FIELDS
+    };
+
+    struct Settings {
+        glm::vec2 gravity; // units / s^2
+        float drag;        // share of the velocity lost per second
+
+        Settings() : gravity(0.0f, -1.5f), drag(1.5f) {}
+    };
+    Settings settings;
+
+    struct Stats {
+        size_t dropped = 0; // emitted past the capacity
+        size_t died = 0;    // in the last update()
+    };
+    Stats stats;
+
+    explicit ParticleSystem(size_t capacity) : live(0), maximum(capacity) {
+        arrays.resize(capacity);
+        colors.resize(capacity);
+        deadBits.resize(arrays.groups());
+    }
+
+    size_t size() const { return live; }
+    size_t capacity() const { return maximum; }
+    const float *field(int k) const { return arrays[k]; }
+    const uint32_t *packedColors() const { return colors.data(); } // RGBA8, red in the low byte
+
+    void clear() { live = 0; }
+
+    void emit(const ParticleBurst &burst, Pcg32 &rng) {
+        uint32_t color = packColor(burst.color);
+        for (int n = 0; n < burst.count; n++) {
+            if (live == maximum) {
+                stats.dropped += burst.count - n;
+                return;
+            }
+            size_t i = live++;
+            float angle = burst.direction + burst.spread * (unitRand(rng) - 0.5f);
+            float speed = linearRand(rng, burst.speedMin, burst.speedMax);
+            float lifetime = linearRand(rng, burst.lifetimeMin, burst.lifetimeMax);
+            arrays[X][i] = burst.position.x;
+            arrays[Y][i] = burst.position.y;
+            arrays[VELOCITY_X][i] = burst.velocity.x + speed * std::cos(angle);
+            arrays[VELOCITY_Y][i] = burst.velocity.y + speed * std::sin(angle);
+            arrays[FADE][i] = 1.0f;
+            arrays[FADE_RATE][i] = 1.0f / lifetime;
+            arrays[SIZE][i] = burst.size;
+            colors[i] = color;
+        }
+    }
+
+    void update(float dt, ThreadPool *pool = NULL) {
+        const size_t groups = (live + 7) / 8;
+        const float damping = std::exp(-settings.drag * dt);
+        if (pool && groups > 2 * GRAIN) {
+            pool->parallelFor(groups, GRAIN, [this, dt, damping](size_t begin, size_t end) {
+                step(begin, end, dt, damping);
+            });
+        } else {
+            step(0, groups, dt, damping);
+        }
+        removeDead(groups);
+    }
+
+private:
+    static const size_t GRAIN = 1024; // groups, 8k particles a task
+
+    SoAArrays<FIELDS> arrays;
+    std::vector<uint32_t> colors;
+    std::vector<uint8_t> deadBits; // a bit per lane, by group
+    size_t live, maximum;
+
+    // Without AVX2 the float8 fallback loses to plain scalar code, so that
+    // build runs the same math a particle at a time.
+    void step(size_t begin, size_t end, float dt, float damping) {
+#if !SIMD_AVX2
+        const float pushX = settings.gravity.x * dt, pushY = settings.gravity.y * dt;
+        float *vxs = arrays[VELOCITY_X], *vys = arrays[VELOCITY_Y], *xs = arrays[X], *ys = arrays[Y];
+        float *fades = arrays[FADE];
+        const float *rates = arrays[FADE_RATE];
+        for (size_t g = begin; g < end; g++) {
+            size_t first = g * 8, lanes = live - first < 8 ? live - first : 8;
+            int dead = 0;
+            for (size_t lane = 0; lane < lanes; lane++) {
+                size_t i = first + lane;
+                float vx = (vxs[i] + pushX) * damping, vy = (vys[i] + pushY) * damping;
+                vxs[i] = vx;
+                vys[i] = vy;
+                xs[i] = vx * dt + xs[i];
+                ys[i] = vy * dt + ys[i];
+                float fade = fades[i] - rates[i] * dt;
+                fades[i] = fade;
+                if (fade <= 0.0f) dead |= 1 << lane;
+            }
+            deadBits[g] = (uint8_t)dead;
+        }
+#else
+        const float8 elapsed = float8::broadcast(dt), zero = float8::broadcast(0.0f);
+        const float8 pushX = float8::broadcast(settings.gravity.x * dt);
+        const float8 pushY = float8::broadcast(settings.gravity.y * dt);
+        const float8 keep = float8::broadcast(damping);
+        for (size_t g = begin; g < end; g++) {
+            size_t i = g * 8;
+            float8 vx = (float8::load(arrays[VELOCITY_X] + i) + pushX) * keep;
+            float8 vy = (float8::load(arrays[VELOCITY_Y] + i) + pushY) * keep;
+            float8 x = fmadd(vx, elapsed, float8::load(arrays[X] + i));
+            float8 y = fmadd(vy, elapsed, float8::load(arrays[Y] + i));
+            float8 fade = float8::load(arrays[FADE] + i) - float8::load(arrays[FADE_RATE] + i) * elapsed;
+            vx.store(arrays[VELOCITY_X] + i);
+            vy.store(arrays[VELOCITY_Y] + i);
+            x.store(arrays[X] + i);
+            y.store(arrays[Y] + i);
+            fade.store(arrays[FADE] + i);
+            deadBits[g] = (uint8_t)((fade <= zero) & mask8::firstLanes(live - i)).bits();
+        }
+#endif
+    }
+
+    // highest first: every index above the one removed is alive by then, so
+    // the last particle moved down is too
+    void removeDead(size_t groups) {
+        size_t died = 0;
+        for (size_t g = groups; g-- > 0;) {
+            int bits = deadBits[g];
+            for (int lane = 7; bits; lane--) {
+                if (!(bits & (1 << lane))) continue;
+                bits &= ~(1 << lane);
+                size_t i = g * 8 + lane, last = --live;
+                died++;
+                if (i == last) continue;
+                for (int k = 0; k < FIELDS; k++) arrays[k][i] = arrays[k][last];
+                colors[i] = colors[last];
+            }
+        }
+        stats.died = died;
+    }
+
+    ParticleSystem(const ParticleSystem &);
+    ParticleSystem &operator=(const ParticleSystem &);
+};
+
+// what a step of the match throws up: a trail behind the ball, sparks off
+// the paddles, an explosion where a goal went in
+inline void emitGameParticles(ParticleSystem &particles, const GameConfig &config, const GameState &before,
+                              const GameState &after, Pcg32 &rng) {
+    bool goal = after.score[0] != before.score[0] || after.score[1] != before.score[1];
+    if (goal) {
+        ParticleBurst burst;
+        burst.position = glm::clamp(before.ball, -config.halfSize, config.halfSize);
+        burst.count = 1500;
+        burst.speedMin = 0.2f;
+        burst.speedMax = 2.5f;
+        burst.lifetimeMin = 0.6f;
+        burst.lifetimeMax = 1.6f;
+        burst.size = 0.03f;
+        burst.color = glm::vec4(1.0f, 0.55f, 0.15f, 1.0f);
+        particles.emit(burst, rng);
+        return;
+    }
+
+    ParticleBurst trail;
+    trail.position = after.ball;
+    trail.velocity = after.ballVelocity * 0.1f;
+    trail.count = 3;
+    trail.speedMax = 0.08f;
+    trail.lifetimeMin = 0.2f;
+    trail.lifetimeMax = 0.4f;
+    trail.size = 2.0f * config.ballRadius;
+    trail.color = glm::vec4(0.5f, 0.7f, 1.0f, 0.6f);
+    particles.emit(trail, rng);
+
+    if ((before.ballVelocity.x < 0.0f) != (after.ballVelocity.x < 0.0f)) {
+        ParticleBurst sparks;
+        sparks.position = after.ball;
+        sparks.count = 120;
+        sparks.direction = std::atan2(after.ballVelocity.y, after.ballVelocity.x);
+        sparks.spread = 2.0f;
+        sparks.speedMin = 0.5f;
+        sparks.speedMax = 2.0f;
+        sparks.lifetimeMin = 0.2f;
+        sparks.lifetimeMax = 0.7f;
+        sparks.size = 0.015f;
+        sparks.color = glm::vec4(1.0f, 0.95f, 0.6f, 1.0f);
+        particles.emit(sparks, rng);
+    }
+}
+
+#endif
@@ -0,0 +1,264 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+
+#include "glm/glm.hpp"
+
+#include "game.h"
+#include "simd.h"
+
+// Neural network bots: inference of a small MLP trained offline.
+//
+// The weights come from a flat binary file, written by the training scripts
+// straight from their tensors (little endian):
+//
+//   header   "PMLP", version, input count (POLICY_INPUTS), layer count
+//   layers   output count, activation (0 linear, 1 relu, 2 tanh),
+//            weights as outputs x inputs floats (row major, the layout of a
+//            torch nn.Linear), then the outputs bias floats
+//
+// The last layer has 3 outputs, the scores of moving down, staying and moving
+// up; act() picks the best. Observations are seen from the left seat (x
+// mirrored for the right one) and scaled to about [-1, 1], so one network
+// plays either side.
+//
+// act() runs the batch 16 rows at a time through every layer, the rows staying
+// in two stack buffers that fit the L1 cache. A layer is a small GEMM: 4 rows
+// by 16 outputs of accumulators, each weight row loaded once for the 4 rows
+// and each input broadcast once for 16 outputs, FMA with make SIMD=avx2. It
+// allocates nothing and only reads the network, so threads can share one.
+
+static const int POLICY_INPUTS = 6;
+
+struct PolicyObservation {
+    glm::vec2 ball;     // over the field half size
+    glm::vec2 velocity; // over the maximum ball speed
+    glm::vec2 paddles;  // own y, opponent y, over the field half height
+};
+static_assert(sizeof(PolicyObservation) == POLICY_INPUTS * sizeof(float), "observations are copied as float rows");
+
+inline PolicyObservation observePolicy(const GameConfig &config, const GameState &state, int side) {
+    PolicyObservation observation;
+    float mirror = side == 0 ? 1.0f : -1.0f;
+    observation.ball = glm::vec2(mirror * state.ball.x, state.ball.y) / config.halfSize;
+    observation.velocity = glm::vec2(mirror * state.ballVelocity.x, state.ballVelocity.y) / config.maxSpeed;
+    observation.paddles = glm::vec2(state.paddleY[side], state.paddleY[1 - side]) / config.halfSize.y;
+    return observation;
+}
+
+class MlpPolicy {
+
+public:
+    static const uint32_t VERSION = 1;
+    static const int MAX_WIDTH = 256; // outputs of a layer
+    static const int TILE_ROWS = 16;  // rows run through the network together
+    enum Activation { LINEAR, RELU, TANH };
+
+    MlpPolicy() {}
+
+    bool load(const std::string &path) {
+        layers.clear();
+        std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+        if (!file) {
+            std::cout << "ERROR::POLICY::FILE_NOT_FOUND " << path << std::endl;
+            return false;
+        }
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        size_t offset = 16;
+        if (bytes.size() < offset || memcmp(&bytes[0], "PMLP", 4) != 0 || readU32(bytes, 4) != VERSION ||
+            readU32(bytes, 8) != (uint32_t)POLICY_INPUTS) {
+            std::cout << "ERROR::POLICY::BAD_HEADER " << path << std::endl;
+            return false;
+        }
+        uint32_t layerCount = readU32(bytes, 12);
+        int inputs = POLICY_INPUTS;
+        for (uint32_t l = 0; l < layerCount; l++) {
+            if (offset + 8 > bytes.size()) break;
+            uint32_t outputs = readU32(bytes, offset), activation = readU32(bytes, offset + 4);
+            offset += 8;
+            size_t floats = ((size_t)outputs + 1) * (size_t)inputs;
+            if (outputs == 0 || outputs > (uint32_t)MAX_WIDTH || activation > TANH ||
+                offset + (floats - inputs + outputs) * 4 > bytes.size()) {
+                std::cout << "ERROR::POLICY::BAD_LAYER " << l << " " << path << std::endl;
+                layers.clear();
+                return false;
+            }
+            // transposed to inputs x padded outputs, the rows a tile of outputs loads
+            Layer layer;
+            layer.inputs = inputs;
+            layer.outputs = (int)outputs;
+            layer.stride = ((int)outputs + 7) & ~7;
+            layer.activation = (Activation)activation;
+            layer.weights.assign((size_t)inputs * layer.stride, 0.0f);
+            layer.bias.assign(layer.stride, 0.0f);
+            for (uint32_t o = 0; o < outputs; o++) {
+                for (int i = 0; i < inputs; i++)
+                    layer.weights[(size_t)i * layer.stride + o] = readF32(bytes, offset + ((size_t)o * inputs + i) * 4);
+            }
+            offset += (size_t)outputs * inputs * 4;
+            for (uint32_t o = 0; o < outputs; o++) layer.bias[o] = readF32(bytes, offset + (size_t)o * 4);
+            offset += (size_t)outputs * 4;
+            layers.push_back(layer);
+            inputs = (int)outputs;
+        }
+        if (layers.size() != layerCount || layerCount == 0 || layers.back().outputs != 3) {
+            std::cout << "ERROR::POLICY::BAD_NETWORK " << path << std::endl;
+            layers.clear();
+            return false;
+        }
+        return true;
+    }
+
+    bool loaded() const { return !layers.empty(); }
+    size_t layerCount() const { return layers.size(); }
+
+    // multiply-adds a row, for throughput figures
+    size_t flopsPerRow() const {
+        size_t macs = 0;
+        for (size_t l = 0; l < layers.size(); l++) macs += (size_t)layers[l].inputs * layers[l].outputs;
+        return macs * 2;
+    }
+
+    // the move with the best score, for each observation
+    void act(const PolicyObservation *observations, size_t count, PaddleInput *moves) const {
+        run(observations, count, [moves](size_t row, const float *scores) {
+            int best = 0;
+            if (scores[1] > scores[best]) best = 1;
+            if (scores[2] > scores[best]) best = 2;
+            moves[row].move = (int8_t)(best - 1);
+        });
+    }
+
+    // the 3 scores of each observation
+    void forward(const PolicyObservation *observations, size_t count, float *scores) const {
+        run(observations, count, [scores](size_t row, const float *out) {
+            for (int i = 0; i < 3; i++) scores[row * 3 + i] = out[i];
+        });
+    }
+
+private:
+    struct Layer {
+        int inputs, outputs, stride; // stride: outputs padded to 8, zero weights
+        Activation activation;
+        std::vector<float> weights;  // inputs x stride
+        std::vector<float> bias;     // stride
+    };
+
+    std::vector<Layer> layers;
+
+    static uint32_t readU32(const std::vector<uint8_t> &bytes, size_t offset) {
+        return (uint32_t)bytes[offset] | (uint32_t)bytes[offset + 1] << 8 | (uint32_t)bytes[offset + 2] << 16 |
+               (uint32_t)bytes[offset + 3] << 24;
+    }
+    static float readF32(const std::vector<uint8_t> &bytes, size_t offset) {
+        uint32_t bits = readU32(bytes, offset);
+        float value;
+        memcpy(&value, &bits, 4);
+        return value;
+    }
+
+    // sink(row, scores) for every row, a tile at a time
+    template <typename Sink>
+    void run(const PolicyObservation *observations, size_t count, Sink sink) const {
+        if (layers.empty()) return;
+        alignas(32) float buffers[2][TILE_ROWS * MAX_WIDTH];
+        for (size_t first = 0; first < count; first += TILE_ROWS) {
+            size_t rows = count - first < (size_t)TILE_ROWS ? count - first : (size_t)TILE_ROWS;
+            // padding rows are zeros, computed and dropped
+            size_t paddedRows = (rows + 3) & ~(size_t)3;
+            memcpy(buffers[0], observations + first, rows * sizeof(PolicyObservation));
+            memset(buffers[0] + rows * POLICY_INPUTS, 0, (paddedRows - rows) * sizeof(PolicyObservation));
+            int in = 0, inputStride = POLICY_INPUTS;
+            for (size_t l = 0; l < layers.size(); l++) {
+                gemm(layers[l], buffers[in], inputStride, buffers[1 - in], paddedRows);
+                inputStride = layers[l].stride;
+                in = 1 - in;
+            }
+            for (size_t r = 0; r < rows; r++) sink(first + r, buffers[in] + r * inputStride);
+        }
+    }
+
+    // out = activation(in x weights + bias), rows a multiple of 4
+    static void gemm(const Layer &layer, const float *in, int inputStride, float *out, size_t rows) {
+        const int stride = layer.stride;
+        for (size_t r = 0; r < rows; r += 4) {
+            const float *x = in + r * inputStride;
+            float *y = out + r * stride;
+            int c = 0;
+            for (; c + 16 <= stride; c += 16) tile16(layer, x, inputStride, y, c);
+            if (c < stride) tile8(layer, x, inputStride, y, c);
+        }
+    }
+
+    // 4 rows by 16 outputs from column c, the accumulators spelled out so
+    // they stay in registers
+    static void tile16(const Layer &layer, const float *x, int inputStride, float *y, int c) {
+        const int stride = layer.stride;
+        const float *w = &layer.weights[0] + c;
+        const float *x0 = x, *x1 = x + inputStride, *x2 = x + 2 * inputStride, *x3 = x + 3 * inputStride;
+        float8 b0 = float8::load(&layer.bias[0] + c), b1 = float8::load(&layer.bias[0] + c + 8);
+        float8 a00 = b0, a01 = b1, a10 = b0, a11 = b1, a20 = b0, a21 = b1, a30 = b0, a31 = b1;
+        for (int k = 0; k < layer.inputs; k++, w += stride) {
+            float8 w0 = float8::load(w), w1 = float8::load(w + 8);
+            float8 v = float8::broadcast(x0[k]);
+            a00 = fmadd(v, w0, a00);
+            a01 = fmadd(v, w1, a01);
+            v = float8::broadcast(x1[k]);
+            a10 = fmadd(v, w0, a10);
+            a11 = fmadd(v, w1, a11);
+            v = float8::broadcast(x2[k]);
+            a20 = fmadd(v, w0, a20);
+            a21 = fmadd(v, w1, a21);
+            v = float8::broadcast(x3[k]);
+            a30 = fmadd(v, w0, a30);
+            a31 = fmadd(v, w1, a31);
+        }
+        float *y0 = y + c, *y1 = y0 + stride, *y2 = y1 + stride, *y3 = y2 + stride;
+        activate(layer, a00, y0);
+        activate(layer, a01, y0 + 8);
+        activate(layer, a10, y1);
+        activate(layer, a11, y1 + 8);
+        activate(layer, a20, y2);
+        activate(layer, a21, y2 + 8);
+        activate(layer, a30, y3);
+        activate(layer, a31, y3 + 8);
+    }
+
+    // 4 rows by the last 8 outputs
+    static void tile8(const Layer &layer, const float *x, int inputStride, float *y, int c) {
+        const int stride = layer.stride;
+        const float *w = &layer.weights[0] + c;
+        const float *x0 = x, *x1 = x + inputStride, *x2 = x + 2 * inputStride, *x3 = x + 3 * inputStride;
+        float8 a0 = float8::load(&layer.bias[0] + c), a1 = a0, a2 = a0, a3 = a0;
+        for (int k = 0; k < layer.inputs; k++, w += stride) {
+            float8 w0 = float8::load(w);
+            a0 = fmadd(float8::broadcast(x0[k]), w0, a0);
+            a1 = fmadd(float8::broadcast(x1[k]), w0, a1);
+            a2 = fmadd(float8::broadcast(x2[k]), w0, a2);
+            a3 = fmadd(float8::broadcast(x3[k]), w0, a3);
+        }
+        float *y0 = y + c;
+        activate(layer, a0, y0);
+        activate(layer, a1, y0 + stride);
+        activate(layer, a2, y0 + 2 * stride);
+        activate(layer, a3, y0 + 3 * stride);
+    }
+
+    static void activate(const Layer &layer, const float8 &sum, float *out) {
+        if (layer.activation == RELU) max(sum, float8::broadcast(0.0f)).store(out);
+        else if (layer.activation == TANH) tanh(sum).store(out);
+        else sum.store(out);
+    }
+
+    MlpPolicy(const MlpPolicy &);
+    MlpPolicy &operator=(const MlpPolicy &);
+};
+
+#endif
@@ -0,0 +1,284 @@
+#ifndef QUAT_BATCH_H
+#define QUAT_BATCH_H
+
+#include <vector>
+#include <cstddef>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include "simd.h"
+#include "bounds.h"
+
+// Batched quaternion interpolation and dual quaternion skinning, 8 elements
+// per step (see simd.h), over SoA arrays of bones or vertices. The
+// matrices match glm::mat4_cast exactly; slerp uses a polynomial in place of
+// acos/sin and stays within 3e-5 of glm::slerp.
+
+struct QuatSoA : SoAArrays<4> {
+    enum { X, Y, Z, W };
+    void add(const glm::quat &q) {
+        push({q.x, q.y, q.z, q.w});
+    }
+    glm::quat get(size_t i) const {
+        return glm::quat(data[W][i], data[X][i], data[Y][i], data[Z][i]);
+    }
+};
+
+struct Vec3SoA : SoAArrays<3> {
+    enum { X, Y, Z };
+    void add(const glm::vec3 &v) {
+        push({v.x, v.y, v.z});
+    }
+    glm::vec3 get(size_t i) const {
+        return glm::vec3(data[X][i], data[Y][i], data[Z][i]);
+    }
+};
+
+// unit dual quaternion: rotation in `real`, translation t in dual = 0.5 * (0, t) * real
+struct DualQuatSoA {
+    QuatSoA real;
+    QuatSoA dual;
+
+    void add(const glm::quat &rotation, const glm::vec3 &translation) {
+        real.add(rotation);
+        dual.add(glm::quat(0.0f, translation) * rotation * 0.5f);
+    }
+    void resize(size_t n) {
+        real.resize(n);
+        dual.resize(n);
+    }
+    size_t size() const { return real.size(); }
+    size_t groups() const { return real.groups(); }
+};
+
+// up to four bones per vertex, unused slots have weight 0
+struct SkinInfluenceSoA {
+    std::vector<int> bone[4];
+    std::vector<float> weight[4];
+    size_t count = 0;
+
+    void add(const glm::ivec4 &bones, const glm::vec4 &weights) {
+        if (count % 8 == 0) {
+            for (int k = 0; k < 4; k++) {
+                bone[k].resize(count + 8, 0);
+                weight[k].resize(count + 8, 0.0f);
+            }
+        }
+        for (int k = 0; k < 4; k++) {
+            bone[k][count] = bones[k];
+            weight[k][count] = weights[k];
+        }
+        count++;
+    }
+    size_t size() const { return count; }
+    size_t groups() const { return (count + 7) / 8; }
+};
+
+struct Quat8 {
+    float8 x, y, z, w;
+
+    static Quat8 load(const QuatSoA &q, size_t i) {
+        Quat8 r = {float8::load(q[QuatSoA::X] + i), float8::load(q[QuatSoA::Y] + i),
+                   float8::load(q[QuatSoA::Z] + i), float8::load(q[QuatSoA::W] + i)};
+        return r;
+    }
+    static Quat8 gather(const QuatSoA &q, const int *idx) {
+        Quat8 r = {float8::gather(q[QuatSoA::X], idx), float8::gather(q[QuatSoA::Y], idx),
+                   float8::gather(q[QuatSoA::Z], idx), float8::gather(q[QuatSoA::W], idx)};
+        return r;
+    }
+    void store(QuatSoA &q, size_t i) const {
+        x.store(q[QuatSoA::X] + i);
+        y.store(q[QuatSoA::Y] + i);
+        z.store(q[QuatSoA::Z] + i);
+        w.store(q[QuatSoA::W] + i);
+    }
+};
+
+inline float8 dot(const Quat8 &a, const Quat8 &b) {
+    return fmadd(a.x, b.x, fmadd(a.y, b.y, fmadd(a.z, b.z, a.w * b.w)));
+}
+
+// sin(t * theta) / sin(theta) with cos(theta) = x in [0, 1], as a polynomial
+// (D. Eberly, "A Fast and Accurate Algorithm for Computing SLERP")
+inline float8 slerpWeight(const float8 &t, const float8 &xm1) {
+    const float mu = 1.85298109240830f;
+    const float8 one = float8::broadcast(1.0f);
+    float8 tt = t * t;
+    float8 acc = one;
+    for (int i = 8; i >= 1; i--) {
+        float u = 1.0f / (float)(i * (2 * i + 1));
+        float v = (float)i / (float)(2 * i + 1);
+        if (i == 8) {
+            u *= mu;
+            v *= mu;
+        }
+        float8 b = (tt * float8::broadcast(u) - float8::broadcast(v)) * xm1;
+        acc = fmadd(b, acc, one);
+    }
+    return t * acc;
+}
+
+// out[i] = slerp(a[i], b[i], t[i]) along the shortest arc, like glm::slerp.
+// t holds a.size() values and does not need padding.
+inline void slerpBatch(const QuatSoA &a, const QuatSoA &b, const float *t, QuatSoA &out) {
+    const float8 zero = float8::broadcast(0.0f), one = float8::broadcast(1.0f);
+    out.resize(a.size());
+    for (size_t g = 0; g < a.groups(); g++) {
+        size_t i = g * 8;
+        Quat8 qa = Quat8::load(a, i), qb = Quat8::load(b, i);
+        float8 tt = float8::loadPartial(t + i, a.size() - i);
+
+        float8 cosTheta = dot(qa, qb);
+        float8 sign = select(cosTheta < zero, -one, one);
+        float8 xm1 = abs(cosTheta) - one;
+        float8 wa = slerpWeight(one - tt, xm1);
+        float8 wb = slerpWeight(tt, xm1) * sign;
+
+        Quat8 r = {fmadd(qa.x, wa, qb.x * wb), fmadd(qa.y, wa, qb.y * wb),
+                   fmadd(qa.z, wa, qb.z * wb), fmadd(qa.w, wa, qb.w * wb)};
+        r.store(out, i);
+    }
+}
+
+// normalized lerp along the shortest arc, cheaper than slerp for small angles
+inline void nlerpBatch(const QuatSoA &a, const QuatSoA &b, const float *t, QuatSoA &out) {
+    const float8 zero = float8::broadcast(0.0f), one = float8::broadcast(1.0f);
+    out.resize(a.size());
+    for (size_t g = 0; g < a.groups(); g++) {
+        size_t i = g * 8;
+        Quat8 qa = Quat8::load(a, i), qb = Quat8::load(b, i);
+        float8 tt = float8::loadPartial(t + i, a.size() - i);
+
+        float8 wb = select(dot(qa, qb) < zero, -tt, tt);
+        float8 wa = one - tt;
+        Quat8 r = {fmadd(qa.x, wa, qb.x * wb), fmadd(qa.y, wa, qb.y * wb),
+                   fmadd(qa.z, wa, qb.z * wb), fmadd(qa.w, wa, qb.w * wb)};
+        // padding lanes are all zero, keep them finite
+        float8 invLen = one / sqrt(max(dot(r, r), float8::broadcast(1e-30f)));
+        r.x = r.x * invLen;
+        r.y = r.y * invLen;
+        r.z = r.z * invLen;
+        r.w = r.w * invLen;
+        r.store(out, i);
+    }
+}
+
+// writes the 3x3 rotation and translation columns of 8 matrices
+inline void storeMat4Lanes(const float8 (&rot)[9], const float8 (&tr)[3], glm::mat4 *out, size_t count) {
+    float r[9][8], t[3][8];
+    for (int k = 0; k < 9; k++) rot[k].store(r[k]);
+    for (int k = 0; k < 3; k++) tr[k].store(t[k]);
+    for (size_t l = 0; l < count && l < 8; l++) {
+        out[l] = glm::mat4(r[0][l], r[1][l], r[2][l], 0.0f,
+                           r[3][l], r[4][l], r[5][l], 0.0f,
+                           r[6][l], r[7][l], r[8][l], 0.0f,
+                           t[0][l], t[1][l], t[2][l], 1.0f);
+    }
+}
+
+// rotation part, same layout as glm::mat3_cast
+inline void rotationColumns(const Quat8 &q, float8 (&m)[9]) {
+    const float8 one = float8::broadcast(1.0f), two = float8::broadcast(2.0f);
+    float8 xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float8 xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float8 wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    m[0] = one - two * (yy + zz);
+    m[1] = two * (xy + wz);
+    m[2] = two * (xz - wy);
+    m[3] = two * (xy - wz);
+    m[4] = one - two * (xx + zz);
+    m[5] = two * (yz + wx);
+    m[6] = two * (xz + wy);
+    m[7] = two * (yz - wx);
+    m[8] = one - two * (xx + yy);
+}
+
+// out[i] = glm::mat4_cast(q[i]), out must hold q.size() matrices
+inline void toMat4Batch(const QuatSoA &q, glm::mat4 *out) {
+    const float8 zero = float8::broadcast(0.0f);
+    for (size_t g = 0; g < q.groups(); g++) {
+        size_t i = g * 8;
+        float8 m[9];
+        float8 t[3] = {zero, zero, zero};
+        rotationColumns(Quat8::load(q, i), m);
+        storeMat4Lanes(m, t, out + i, q.size() - i);
+    }
+}
+
+// rigid transform of unit dual quaternions, translation = 2 * dual * conj(real)
+inline void toMat4Batch(const DualQuatSoA &dq, glm::mat4 *out) {
+    const float8 two = float8::broadcast(2.0f);
+    for (size_t g = 0; g < dq.groups(); g++) {
+        size_t i = g * 8;
+        Quat8 r = Quat8::load(dq.real, i), d = Quat8::load(dq.dual, i);
+        float8 m[9];
+        rotationColumns(r, m);
+        float8 t[3] = {
+            two * (r.w * d.x - d.w * r.x + (r.y * d.z - r.z * d.y)),
+            two * (r.w * d.y - d.w * r.y + (r.z * d.x - r.x * d.z)),
+            two * (r.w * d.z - d.w * r.z + (r.x * d.y - r.y * d.x))};
+        storeMat4Lanes(m, t, out + i, dq.size() - i);
+    }
+}
+
+// Dual quaternion linear blending: out[v] = normalize(sum_k w_k * bones[b_k]),
+// with each bone flipped onto the hemisphere of the first one so the blend
+// does not take the long way around.
+inline void blendDualQuatsBatch(const DualQuatSoA &bones, const SkinInfluenceSoA &skin, DualQuatSoA &out) {
+    const float8 zero = float8::broadcast(0.0f), one = float8::broadcast(1.0f);
+    out.resize(skin.size());
+    for (size_t g = 0; g < skin.groups(); g++) {
+        size_t i = g * 8;
+        Quat8 real = {zero, zero, zero, zero}, dual = {zero, zero, zero, zero}, pivot = real;
+        for (int k = 0; k < 4; k++) {
+            Quat8 r = Quat8::gather(bones.real, &skin.bone[k][i]);
+            Quat8 d = Quat8::gather(bones.dual, &skin.bone[k][i]);
+            float8 w = float8::load(&skin.weight[k][i]);
+            if (k == 0) pivot = r;
+            else w = select(dot(r, pivot) < zero, -w, w);
+            real.x = fmadd(r.x, w, real.x); real.y = fmadd(r.y, w, real.y);
+            real.z = fmadd(r.z, w, real.z); real.w = fmadd(r.w, w, real.w);
+            dual.x = fmadd(d.x, w, dual.x); dual.y = fmadd(d.y, w, dual.y);
+            dual.z = fmadd(d.z, w, dual.z); dual.w = fmadd(d.w, w, dual.w);
+        }
+        float8 invLen = one / sqrt(max(dot(real, real), float8::broadcast(1e-30f)));
+        real.x = real.x * invLen; real.y = real.y * invLen; real.z = real.z * invLen; real.w = real.w * invLen;
+        dual.x = dual.x * invLen; dual.y = dual.y * invLen; dual.z = dual.z * invLen; dual.w = dual.w * invLen;
+        real.store(out.real, i);
+        dual.store(out.dual, i);
+    }
+}
+
+// out[v] = dq[v] applied to in[v], the last step of dual quaternion skinning
+inline void skinPositionsBatch(const DualQuatSoA &dq, const Vec3SoA &in, Vec3SoA &out) {
+    const float8 two = float8::broadcast(2.0f);
+    out.resize(in.size());
+    for (size_t g = 0; g < in.groups(); g++) {
+        size_t i = g * 8;
+        Quat8 r = Quat8::load(dq.real, i), d = Quat8::load(dq.dual, i);
+        float8 px = float8::load(in[Vec3SoA::X] + i);
+        float8 py = float8::load(in[Vec3SoA::Y] + i);
+        float8 pz = float8::load(in[Vec3SoA::Z] + i);
+
+        // rotation: p + 2 r x (r x p + w p)
+        float8 cx = fmadd(r.w, px, r.y * pz - r.z * py);
+        float8 cy = fmadd(r.w, py, r.z * px - r.x * pz);
+        float8 cz = fmadd(r.w, pz, r.x * py - r.y * px);
+        px = fmadd(two, r.y * cz - r.z * cy, px);
+        py = fmadd(two, r.z * cx - r.x * cz, py);
+        pz = fmadd(two, r.x * cy - r.y * cx, pz);
+
+        // translation: 2 (w d - dw r + r x d)
+        px = fmadd(two, r.w * d.x - d.w * r.x + (r.y * d.z - r.z * d.y), px);
+        py = fmadd(two, r.w * d.y - d.w * r.y + (r.z * d.x - r.x * d.z), py);
+        pz = fmadd(two, r.w * d.z - d.w * r.z + (r.x * d.y - r.y * d.x), pz);
+
+        px.store(out[Vec3SoA::X] + i);
+        py.store(out[Vec3SoA::Y] + i);
+        pz.store(out[Vec3SoA::Z] + i);
+    }
+}
+
+#endif
@@ -0,0 +1,231 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/constants.hpp"
+
+// Random numbers with explicit generator state.
+//
+// glm::linearRand & co. (glm/gtc/random.inl) go through std::rand(), which is
+// process-global and locked in glibc. Everything here takes the generator as
+// a parameter instead, so each thread / match owns its own stream and results
+// are reproducible from (seed, stream).
+
+// SplitMix64 finaliser, used to derive seeds and as the counter-based mixer
+inline uint64_t splitMix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// PCG32 (XSH-RR), sequential generator with 64 bits of state
+class Pcg32 {
+
+public:
+    uint64_t state;
+    uint64_t inc;
+
+    Pcg32(uint64_t seed = 0x853C49E6748FEA9BULL, uint64_t stream = 0xDA3E39CB94B95BDBULL) {
+        reseed(seed, stream);
+    }
+
+    // independent generator for (seed, streamId), e.g. one per thread or match.
+    // both state and increment are hashed so neighbouring ids are not correlated
+    static Pcg32 forStream(uint64_t seed, uint64_t streamId) {
+        uint64_t key = splitMix64(seed ^ splitMix64(streamId));
+        return Pcg32(splitMix64(key), splitMix64(key + 1));
+    }
+
+    void reseed(uint64_t seed, uint64_t stream) {
+        state = 0u;
+        inc = (stream << 1u) | 1u;
+        nextUInt();
+        state += seed;
+        nextUInt();
+    }
+
+    uint32_t nextUInt() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + inc;
+        uint32_t xorShifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+        uint32_t rot = (uint32_t)(old >> 59u);
+        return (xorShifted >> rot) | (xorShifted << ((32u - rot) & 31u));
+    }
+};
+
+// Counter-based generator: value i of a stream is a pure function of
+// (key, i), so any element can be computed independently of the others.
+// Loops filling arrays have no carried dependency and a stream can be
+// split by handing out counter ranges.
+class CounterRng {
+
+public:
+    uint64_t key;
+    uint64_t counter;
+
+    CounterRng(uint64_t seed = 0u, uint64_t streamId = 0u, uint64_t first = 0u)
+        : key(splitMix64(seed ^ splitMix64(streamId))), counter(first) {}
+
+    uint32_t at(uint64_t index) const {
+        return (uint32_t)(splitMix64(key + index * 0x9E3779B97F4A7C15ULL) >> 32u);
+    }
+    uint32_t nextUInt() {
+        return at(counter++);
+    }
+    // reserve `count` values for someone else (a worker, a sub-system...)
+    CounterRng split(uint64_t count) {
+        CounterRng sub(*this);
+        counter += count;
+        return sub;
+    }
+};
+
+// [0, 1) with 24 bits of mantissa
+inline float uintToUnitFloat(uint32_t bits) {
+    return (float)(bits >> 8u) * (1.0f / 16777216.0f);
+}
+
+template <typename Rng>
+inline float unitRand(Rng &rng) {
+    return uintToUnitFloat(rng.nextUInt());
+}
+
+// same distributions as glm/gtc/random.hpp, with a generator argument
+
+template <typename Rng>
+inline float linearRand(Rng &rng, float min, float max) {
+    return min + (max - min) * unitRand(rng);
+}
+template <typename Rng>
+inline glm::vec2 linearRand(Rng &rng, const glm::vec2 &min, const glm::vec2 &max) {
+    float x = unitRand(rng);
+    float y = unitRand(rng);
+    return min + (max - min) * glm::vec2(x, y);
+}
+template <typename Rng>
+inline glm::vec3 linearRand(Rng &rng, const glm::vec3 &min, const glm::vec3 &max) {
+    float x = unitRand(rng);
+    float y = unitRand(rng);
+    float z = unitRand(rng);
+    return min + (max - min) * glm::vec3(x, y, z);
+}
+
+// Box-Muller rather than glm's rejection loop: fixed cost of two draws
+template <typename Rng>
+inline float gaussRand(Rng &rng, float mean, float deviation) {
+    float u1 = 1.0f - unitRand(rng); // (0, 1], keeps log() finite
+    float u2 = unitRand(rng);
+    return mean + deviation * std::sqrt(-2.0f * std::log(u1)) * std::cos(glm::two_pi<float>() * u2);
+}
+
+template <typename Rng>
+inline glm::vec2 circularRand(Rng &rng, float radius) {
+    float a = glm::two_pi<float>() * unitRand(rng);
+    return glm::vec2(std::cos(a), std::sin(a)) * radius;
+}
+
+template <typename Rng>
+inline glm::vec2 diskRand(Rng &rng, float radius) {
+    float a = glm::two_pi<float>() * unitRand(rng);
+    float r = std::sqrt(unitRand(rng)) * radius;
+    return glm::vec2(std::cos(a), std::sin(a)) * r;
+}
+
+template <typename Rng>
+inline glm::vec3 sphericalRand(Rng &rng, float radius) {
+    float z = 2.0f * unitRand(rng) - 1.0f;
+    float a = glm::two_pi<float>() * unitRand(rng);
+    float r = std::sqrt(1.0f - z * z);
+    return glm::vec3(r * std::cos(a), r * std::sin(a), z) * radius;
+}
+
+template <typename Rng>
+inline glm::vec3 ballRand(Rng &rng, float radius) {
+    glm::vec3 dir = sphericalRand(rng, 1.0f);
+    return dir * (std::cbrt(unitRand(rng)) * radius);
+}
+
+// Batched fills.
+// The generic versions walk the generator sequentially. The CounterRng
+// overloads give element i the counters [first + i * N, first + (i + 1) * N)
+// where N is the number of draws per sample, so the loop body only depends on i.
+
+template <typename Rng>
+inline void fillLinearRand(Rng &rng, glm::vec2 *out, size_t count, const glm::vec2 &min, const glm::vec2 &max) {
+    for (size_t i = 0; i < count; i++)
+        out[i] = linearRand(rng, min, max);
+}
+template <typename Rng>
+inline void fillLinearRand(Rng &rng, glm::vec3 *out, size_t count, const glm::vec3 &min, const glm::vec3 &max) {
+    for (size_t i = 0; i < count; i++)
+        out[i] = linearRand(rng, min, max);
+}
+template <typename Rng>
+inline void fillCircularRand(Rng &rng, glm::vec2 *out, size_t count, float radius) {
+    for (size_t i = 0; i < count; i++)
+        out[i] = circularRand(rng, radius);
+}
+template <typename Rng>
+inline void fillDiskRand(Rng &rng, glm::vec2 *out, size_t count, float radius) {
+    for (size_t i = 0; i < count; i++)
+        out[i] = diskRand(rng, radius);
+}
+template <typename Rng>
+inline void fillBallRand(Rng &rng, glm::vec3 *out, size_t count, float radius) {
+    for (size_t i = 0; i < count; i++)
+        out[i] = ballRand(rng, radius);
+}
+
+inline void fillLinearRand(CounterRng &rng, glm::vec2 *out, size_t count, const glm::vec2 &min, const glm::vec2 &max) {
+    const uint64_t base = rng.counter;
+    for (size_t i = 0; i < count; i++) {
+        glm::vec2 u(uintToUnitFloat(rng.at(base + 2 * i)), uintToUnitFloat(rng.at(base + 2 * i + 1)));
+        out[i] = min + (max - min) * u;
+    }
+    rng.counter += 2 * count;
+}
+inline void fillLinearRand(CounterRng &rng, glm::vec3 *out, size_t count, const glm::vec3 &min, const glm::vec3 &max) {
+    const uint64_t base = rng.counter;
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 u(uintToUnitFloat(rng.at(base + 3 * i)),
+                    uintToUnitFloat(rng.at(base + 3 * i + 1)),
+                    uintToUnitFloat(rng.at(base + 3 * i + 2)));
+        out[i] = min + (max - min) * u;
+    }
+    rng.counter += 3 * count;
+}
+inline void fillCircularRand(CounterRng &rng, glm::vec2 *out, size_t count, float radius) {
+    const uint64_t base = rng.counter;
+    for (size_t i = 0; i < count; i++) {
+        float a = glm::two_pi<float>() * uintToUnitFloat(rng.at(base + i));
+        out[i] = glm::vec2(std::cos(a), std::sin(a)) * radius;
+    }
+    rng.counter += count;
+}
+inline void fillDiskRand(CounterRng &rng, glm::vec2 *out, size_t count, float radius) {
+    const uint64_t base = rng.counter;
+    for (size_t i = 0; i < count; i++) {
+        float a = glm::two_pi<float>() * uintToUnitFloat(rng.at(base + 2 * i));
+        float r = std::sqrt(uintToUnitFloat(rng.at(base + 2 * i + 1))) * radius;
+        out[i] = glm::vec2(std::cos(a), std::sin(a)) * r;
+    }
+    rng.counter += 2 * count;
+}
+inline void fillBallRand(CounterRng &rng, glm::vec3 *out, size_t count, float radius) {
+    const uint64_t base = rng.counter;
+    for (size_t i = 0; i < count; i++) {
+        float z = 2.0f * uintToUnitFloat(rng.at(base + 3 * i)) - 1.0f;
+        float a = glm::two_pi<float>() * uintToUnitFloat(rng.at(base + 3 * i + 1));
+        float r = std::sqrt(1.0f - z * z);
+        float len = std::cbrt(uintToUnitFloat(rng.at(base + 3 * i + 2))) * radius;
+        out[i] = glm::vec3(r * std::cos(a), r * std::sin(a), z) * len;
+    }
+    rng.counter += 3 * count;
+}
+
+#endif
@@ -0,0 +1,242 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#include "glm/glm.hpp"
+
+#include "shader.h"
+#include "gl_state.h"
+#include "stream_buffer.h"
+#include "std140.h"
+
+// Per-frame draw list sorted by a 64-bit key.
+//
+// Every draw is submitted with a key made of (from the most significant bits)
+// layer, shader, texture set and depth, plus a small command. flush() radix
+// sorts the keys and walks them in order, switching program and textures only
+// where the shader or texture field changes, so draws sharing state end up
+// next to each other whatever order they were submitted in.
+//
+// With setObjectUniforms(), the per-draw data of shaders declaring an
+// "Object" uniform block is written once per flush into a stream buffer and
+// each draw only binds its range; other shaders get a glUniform call.
+
+struct DrawCommand {
+    GLuint vertexArray;
+    GLenum mode;
+    GLsizei indexCount;
+    GLenum indexType;
+    const void *indexOffset;
+    glm::mat4 transform;
+    GLsizei instanceCount; // 0 for a plain draw
+};
+
+// textures bound together for one draw, one per unit
+struct TextureSet {
+    static const int MAX_UNITS = 4;
+    GLuint textures[MAX_UNITS];
+    int units;
+};
+
+class RenderQueue {
+
+public:
+    // bit layout of the sort key
+    static const int LAYER_BITS = 8, SHADER_BITS = 12, TEXTURE_BITS = 20, DEPTH_BITS = 24;
+    static const int DEPTH_SHIFT = 0;
+    static const int TEXTURE_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+    static const int SHADER_SHIFT = TEXTURE_SHIFT + TEXTURE_BITS;
+    static const int LAYER_SHIFT = SHADER_SHIFT + SHADER_BITS;
+
+    // switches actually performed by the last flush()
+    struct Stats {
+        unsigned int draws = 0;
+        unsigned int programChanges = 0;
+        unsigned int textureChanges = 0;
+    };
+    Stats stats;
+
+    RenderQueue() : objectUniforms(NULL), objectAlignment(256), objectStride(0) {}
+
+    // shaders and texture sets are referred to by the index returned here
+    unsigned int addShader(Shader *shader) {
+        ShaderEntry entry = {shader, -1, false, 0};
+        refresh(entry);
+        shaders.push_back(entry);
+        return (unsigned int)shaders.size() - 1;
+    }
+    unsigned int addTextureSet(const GLuint *textures, int units) {
+        TextureSet set;
+        set.units = units < TextureSet::MAX_UNITS ? units : TextureSet::MAX_UNITS;
+        for (int i = 0; i < set.units; i++) set.textures[i] = textures[i];
+        textureSets.push_back(set);
+        return (unsigned int)textureSets.size() - 1;
+    }
+
+    // stream buffer (GL_UNIFORM_BUFFER) holding the "Object" blocks
+    void setObjectUniforms(StreamBuffer *buffer) {
+        objectUniforms = buffer;
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        objectAlignment = alignment;
+        objectStride = (objectBlockSize() + objectAlignment - 1) / objectAlignment * objectAlignment;
+    }
+
+    // depth in [0, 1]; pass backToFront for blended layers
+    static uint64_t makeKey(unsigned int layer, unsigned int shader, unsigned int textureSet,
+                            float depth, bool backToFront = false) {
+        const uint32_t depthMax = (1u << DEPTH_BITS) - 1u;
+        float d = glm::clamp(depth, 0.0f, 1.0f);
+        uint32_t depthBits = (uint32_t)(d * (float)depthMax);
+        if (backToFront) depthBits = depthMax - depthBits;
+        return ((uint64_t)(layer & ((1u << LAYER_BITS) - 1u)) << LAYER_SHIFT) |
+               ((uint64_t)(shader & ((1u << SHADER_BITS) - 1u)) << SHADER_SHIFT) |
+               ((uint64_t)(textureSet & ((1u << TEXTURE_BITS) - 1u)) << TEXTURE_SHIFT) |
+               ((uint64_t)depthBits << DEPTH_SHIFT);
+    }
+
+    void submit(uint64_t key, const DrawCommand &command) {
+        keys.push_back(key);
+        order.push_back((uint32_t)commands.size());
+        commands.push_back(command);
+    }
+
+    // sort, issue every draw and empty the queue
+    void flush() {
+        stats = Stats();
+        radixSort();
+
+        // all object blocks in one upload, in draw order
+        StreamBuffer::Allocation blocks = {NULL, 0, 0};
+        if (objectUniforms && !keys.empty()) {
+            blocks = objectUniforms->allocate(objectStride * (GLsizeiptr)keys.size(), objectAlignment);
+            if (blocks.ptr) {
+                for (size_t i = 0; i < keys.size(); i++)
+                    writeObjectBlock((char *)blocks.ptr + i * objectStride, commands[order[i]]);
+                objectUniforms->commit(blocks);
+            }
+        }
+
+        uint64_t previous = ~0ull;
+        GLint transformLoc = -1;
+        bool objectBlock = false;
+        for (size_t i = 0; i < keys.size(); i++) {
+            uint64_t key = keys[i];
+            unsigned int shader = field(key, SHADER_SHIFT, SHADER_BITS);
+            unsigned int textureSet = field(key, TEXTURE_SHIFT, TEXTURE_BITS);
+
+            // state changes only at bucket boundaries
+            if (i == 0 || shader != field(previous, SHADER_SHIFT, SHADER_BITS)) {
+                if (shaders[shader].generation != shaders[shader].shader->generation)
+                    refresh(shaders[shader]); // hot reloaded, locations may have moved
+                shaders[shader].shader->use();
+                transformLoc = shaders[shader].transformLoc;
+                objectBlock = shaders[shader].objectBlock && blocks.ptr;
+                stats.programChanges++;
+            }
+            if (i == 0 || textureSet != field(previous, TEXTURE_SHIFT, TEXTURE_BITS)) {
+                const TextureSet &set = textureSets[textureSet];
+                for (int unit = 0; unit < set.units; unit++)
+                    glState().bindTexture(unit, GL_TEXTURE_2D, set.textures[unit]);
+                stats.textureChanges++;
+            }
+            previous = key;
+
+            const DrawCommand &cmd = commands[order[i]];
+            if (objectBlock)
+                glState().bindBufferRange(GL_UNIFORM_BUFFER, OBJECT_UNIFORMS_BINDING, objectUniforms->ID,
+                                          blocks.offset + (GLintptr)i * objectStride, objectBlockSize());
+            else if (transformLoc >= 0)
+                glUniformMatrix4fv(transformLoc, 1, GL_FALSE, &cmd.transform[0][0]);
+            glState().bindVertexArray(cmd.vertexArray);
+            if (cmd.instanceCount > 0)
+                glDrawElementsInstanced(cmd.mode, cmd.indexCount, cmd.indexType, cmd.indexOffset, cmd.instanceCount);
+            else
+                glDrawElements(cmd.mode, cmd.indexCount, cmd.indexType, cmd.indexOffset);
+            stats.draws++;
+        }
+
+        keys.clear();
+        order.clear();
+        commands.clear();
+    }
+
+private:
+    struct ShaderEntry {
+        Shader *shader;
+        GLint transformLoc;
+        bool objectBlock;
+        unsigned int generation;
+    };
+    std::vector<ShaderEntry> shaders;
+    std::vector<TextureSet> textureSets;
+
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> order; // command index of each key
+    std::vector<DrawCommand> commands;
+    std::vector<uint64_t> keysTmp;
+    std::vector<uint32_t> orderTmp;
+
+    StreamBuffer *objectUniforms;
+    GLsizeiptr objectAlignment; // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    GLsizeiptr objectStride;    // block size rounded up to the alignment
+
+    // layout (std140) uniform Object { mat4 transform; };
+    static void writeObjectBlock(void *dst, const DrawCommand &cmd) {
+        Std140Writer(dst).write(cmd.transform);
+    }
+    static GLsizeiptr objectBlockSize() {
+        return (GLsizeiptr)Std140Writer().write(glm::mat4(1.0f)).size();
+    }
+
+    static void refresh(ShaderEntry &entry) {
+        entry.transformLoc = glGetUniformLocation(entry.shader->ID, "transform");
+        entry.objectBlock = entry.shader->hasUniformBlock("Object");
+        entry.generation = entry.shader->generation;
+    }
+
+    static unsigned int field(uint64_t key, int shift, int bits) {
+        return (unsigned int)((key >> shift) & ((1ull << bits) - 1ull));
+    }
+
+    // LSD radix sort on bytes, carrying the command index along. Passes where
+    // every key has the same byte (unused layers, depth ignored...) are skipped.
+    void radixSort() {
+        const size_t n = keys.size();
+        if (n < 2) return;
+        keysTmp.resize(n);
+        orderTmp.resize(n);
+
+        size_t histogram[8][256];
+        memset(histogram, 0, sizeof(histogram));
+        for (size_t i = 0; i < n; i++)
+            for (int pass = 0; pass < 8; pass++)
+                histogram[pass][(keys[i] >> (pass * 8)) & 0xFF]++;
+
+        for (int pass = 0; pass < 8; pass++) {
+            size_t *count = histogram[pass];
+            if (count[(keys[0] >> (pass * 8)) & 0xFF] == n) continue;
+
+            size_t offset = 0;
+            for (int b = 0; b < 256; b++) {
+                size_t c = count[b];
+                count[b] = offset;
+                offset += c;
+            }
+            for (size_t i = 0; i < n; i++) {
+                size_t dst = count[(keys[i] >> (pass * 8)) & 0xFF]++;
+                keysTmp[dst] = keys[i];
+                orderTmp[dst] = order[i];
+            }
+            keys.swap(keysTmp);
+            order.swap(orderTmp);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <GL/glew.h>
+
+#include <iostream>
+
+#include "gl_state.h"
+
+// Offscreen framebuffer: an RGBA8 color texture and a depth/stencil
+// renderbuffer. Draw into it with bind(), read it back with FrameReadback.
+class RenderTarget {
+
+public:
+    GLuint framebuffer;
+    GLuint color; // GL_TEXTURE_2D, can be sampled once rendered
+    GLuint depthStencil;
+    int width;
+    int height;
+
+    RenderTarget(int width, int height) : width(width), height(height) {
+        glGenTextures(1, &color);
+        glState().bindTexture(0, GL_TEXTURE_2D, color);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        glGenRenderbuffers(1, &depthStencil);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthStencil);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+        glGenFramebuffers(1, &framebuffer);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencil);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::RENDER_TARGET::FRAMEBUFFER_INCOMPLETE" << std::endl;
+    }
+
+    ~RenderTarget() {
+        glState().deleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &depthStencil); // renderbuffer bindings are not shadowed
+        glState().deleteTextures(1, &color);
+    }
+
+    // draw and read from this target, with a full viewport
+    void bind() {
+        glState().bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glState().setViewport(0, 0, width, height);
+    }
+
+private:
+    RenderTarget(const RenderTarget &);
+    RenderTarget &operator=(const RenderTarget &);
+};
+
+#endif
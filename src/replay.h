@@ -0,0 +1,338 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+
+#include "game.h"
+
+// Match replays: the inputs of every tick plus a keyframe now and then.
+//
+// The simulation is deterministic (game.h), so the inputs are the match; a
+// keyframe is only there so playback can start anywhere without simulating
+// from the first tick. File layout (little endian):
+//
+//   header   "PRPL", version, step (float), seed, GameConfig bytes
+//   records  varint((ticks since the previous record << 1) | keyframe)
+//              input change: one byte, 2 bits per player (move + 1)
+//              keyframe:     the 9 words of the GameState, each XORed with
+//                            the previous keyframe and written as a varint
+//   index    tick count, then (tick, offset of the record) per keyframe
+//   footer   offset of the index (u32)
+//
+// Inputs only change a few times a second, so most ticks cost nothing, and
+// close floats XOR to small numbers (same sign, exponent and leading mantissa
+// bits) which keeps keyframes to a few dozen bytes. A ten minute match at
+// 120 Hz takes tens of kilobytes where its states would take megabytes.
+
+inline void writeVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+// false on truncated input
+inline bool readVarint(const uint8_t *&in, const uint8_t *end, uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && in < end; shift += 7) {
+        uint8_t byte = *in++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+class ReplayWriter {
+
+public:
+    static const uint32_t VERSION = 1;
+    static const int STATE_WORDS = sizeof(GameState) / 4;
+
+    ReplayWriter() : written(0), keyframeInterval(600), lastTick(0), ticks(0), recording(false) {}
+    ~ReplayWriter() { close(); }
+
+    // keyframeInterval: ticks between keyframes, seeking resimulates at most that many
+    bool open(const std::string &path, const GameConfig &config, uint32_t seed, float stepSeconds,
+              uint32_t keyframeInterval = 600) {
+        file.open(path.c_str(), std::ios::out | std::ios::binary);
+        if (!file) {
+            std::cout << "ERROR::REPLAY::FILE_NOT_OPENED " << path << std::endl;
+            return false;
+        }
+        this->keyframeInterval = keyframeInterval ? keyframeInterval : 1;
+        bytes.clear();
+        index.clear();
+        const char magic[4] = {'P', 'R', 'P', 'L'};
+        bytes.insert(bytes.end(), magic, magic + 4);
+        writeU32(bytes, VERSION);
+        uint32_t step;
+        memcpy(&step, &stepSeconds, 4);
+        writeU32(bytes, step);
+        writeU32(bytes, seed);
+        writeU32(bytes, sizeof(GameConfig));
+        const uint8_t *configBytes = (const uint8_t *)&config;
+        bytes.insert(bytes.end(), configBytes, configBytes + sizeof(GameConfig));
+        memset(previousKeyframe, 0, sizeof(previousKeyframe));
+        lastInputs = 0xFF;
+        lastTick = 0;
+        ticks = 0;
+        recording = true;
+        return true;
+    }
+
+    // every tick, with the state at its start and the inputs it is stepped with
+    void record(const GameState &state, const PaddleInput input[2]) {
+        if (!recording) return;
+        if (ticks % keyframeInterval == 0) {
+            index.push_back(ticks);
+            index.push_back((uint32_t)bytes.size());
+            writeVarint(bytes, (uint64_t)(ticks - lastTick) << 1 | 1u);
+            uint32_t words[STATE_WORDS];
+            memcpy(words, &state, sizeof(words));
+            for (int i = 0; i < STATE_WORDS; i++) writeVarint(bytes, words[i] ^ previousKeyframe[i]);
+            memcpy(previousKeyframe, words, sizeof(words));
+            lastTick = ticks;
+            lastInputs = 0xFF; // the inputs follow every keyframe, playback can start there
+        }
+        uint8_t packed = packInputs(input);
+        if (packed != lastInputs) {
+            writeVarint(bytes, (uint64_t)(ticks - lastTick) << 1);
+            bytes.push_back(packed);
+            lastInputs = packed;
+            lastTick = ticks;
+        }
+        ticks++;
+        // everything but the index is final, hand it to the file now and then
+        if (bytes.size() >= 64 * 1024) flush();
+    }
+
+    void close() {
+        if (!recording) return;
+        uint32_t indexOffset = written + (uint32_t)bytes.size();
+        writeU32(bytes, ticks);
+        writeU32(bytes, (uint32_t)index.size() / 2);
+        for (size_t i = 0; i < index.size(); i++) writeU32(bytes, index[i]);
+        writeU32(bytes, indexOffset);
+        flush();
+        file.close();
+        recording = false;
+    }
+
+    uint32_t tickCount() const { return ticks; }
+    size_t size() const { return written + bytes.size(); }
+
+    static uint8_t packInputs(const PaddleInput input[2]) {
+        return (uint8_t)((input[0].move + 1) | (input[1].move + 1) << 2);
+    }
+    static void writeU32(std::vector<uint8_t> &out, uint32_t value) {
+        for (int i = 0; i < 4; i++) out.push_back((uint8_t)(value >> (8 * i)));
+    }
+
+private:
+    std::ofstream file;
+    std::vector<uint8_t> bytes;  // not written yet
+    uint32_t written;            // bytes already in the file
+    std::vector<uint32_t> index; // (tick, offset) pairs
+    uint32_t keyframeInterval;
+    uint32_t previousKeyframe[STATE_WORDS];
+    uint8_t lastInputs;
+    uint32_t lastTick; // of the last record
+    uint32_t ticks;
+    bool recording;
+
+    // keyframe offsets are absolute, so the bytes are only ever appended
+    void flush() {
+        if (bytes.empty()) return;
+        file.write((const char *)&bytes[0], bytes.size());
+        written += (uint32_t)bytes.size();
+        bytes.clear();
+    }
+
+    ReplayWriter(const ReplayWriter &);
+    ReplayWriter &operator=(const ReplayWriter &);
+};
+
+// Plays a replay back: seek() restores the nearest keyframe at or before the
+// tick and resimulates the rest, advance() steps forward as fast as the
+// simulation goes (millions of ticks per second, no rendering needed).
+class ReplayPlayer {
+
+public:
+    GameConfig config;
+    uint32_t seed;
+    float stepSeconds;
+    uint32_t tickCount;
+
+    ReplayPlayer() : seed(0), stepSeconds(0.0f), tickCount(0), tick(0), cursor(0), nextRecordTick(0),
+                     keyframeCount(0) {
+        memset(&state, 0, sizeof(state));
+        memset(inputs, 0, sizeof(inputs));
+    }
+
+    bool load(const std::string &path) {
+        std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+        if (!file) {
+            std::cout << "ERROR::REPLAY::FILE_NOT_FOUND " << path << std::endl;
+            return false;
+        }
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if (bytes.size() < 24 || memcmp(&bytes[0], "PRPL", 4) != 0 || readU32(4) != ReplayWriter::VERSION ||
+            readU32(16) != sizeof(GameConfig) || bytes.size() < 20 + sizeof(GameConfig) + 12) {
+            std::cout << "ERROR::REPLAY::BAD_FILE " << path << std::endl;
+            return false;
+        }
+        uint32_t step = readU32(8);
+        memcpy(&stepSeconds, &step, 4);
+        seed = readU32(12);
+        memcpy(&config, &bytes[20], sizeof(GameConfig));
+        recordsStart = 20 + (uint32_t)sizeof(GameConfig);
+
+        // in size_t: offsets and counts come from the file and may be anything
+        size_t footer = bytes.size() - 4, offset = readU32(footer);
+        if (offset < recordsStart || offset + 8 > footer) {
+            std::cout << "ERROR::REPLAY::BAD_INDEX " << path << std::endl;
+            return false;
+        }
+        indexOffset = (uint32_t)offset;
+        tickCount = readU32(indexOffset);
+        keyframeCount = readU32(indexOffset + 4);
+        if (!keyframeCount || (size_t)keyframeCount > (footer - offset - 8) / 8) {
+            std::cout << "ERROR::REPLAY::BAD_INDEX " << path << std::endl;
+            return false;
+        }
+        // seek() starts from the first keyframe, at tick 0, and bisects the others
+        for (uint32_t k = 0; k < keyframeCount; k++) {
+            bool ordered = k ? keyframeTick(k) > keyframeTick(k - 1) && keyframeOffset(k) > keyframeOffset(k - 1)
+                             : keyframeTick(0) == 0;
+            if (!ordered || keyframeOffset(k) < recordsStart || keyframeOffset(k) >= indexOffset ||
+                keyframeTick(k) > tickCount) {
+                std::cout << "ERROR::REPLAY::BAD_INDEX keyframe " << k << " of " << path << std::endl;
+                return false;
+            }
+        }
+        return seek(0);
+    }
+
+    uint32_t currentTick() const { return tick; }
+    const GameState &current() const { return state; }
+    bool finished() const { return tick >= tickCount; }
+
+    // state at the start of `target`
+    bool seek(uint32_t target) {
+        if (target > tickCount) target = tickCount;
+        // last keyframe at or before the target (the first one is at tick 0)
+        uint32_t lo = 0, hi = keyframeCount;
+        while (hi - lo > 1) {
+            uint32_t mid = (lo + hi) / 2;
+            if (keyframeTick(mid) <= target) lo = mid;
+            else hi = mid;
+        }
+        // keyframes are XORed with the previous one: decode them from the first
+        memset(keyframeWords, 0, sizeof(keyframeWords));
+        cursor = recordsStart;
+        tick = 0;
+        nextRecordTick = 0;
+        for (uint32_t k = 0; k <= lo; k++) {
+            cursor = keyframeOffset(k);
+            tick = keyframeTick(k);
+            if (!readRecord()) return false;
+        }
+        if (!readPendingRecords()) return false;
+        advance(target - tick);
+        return tick == target;
+    }
+
+    // fast-forward, returns the ticks actually stepped
+    uint32_t advance(uint32_t ticks) {
+        uint32_t done = 0;
+        for (; done < ticks && tick < tickCount; done++) {
+            stepGame(config, state, inputs, stepSeconds);
+            tick++;
+            if (!readPendingRecords()) return done;
+        }
+        return done;
+    }
+
+    // inputs of the current tick
+    void currentInputs(PaddleInput out[2]) const {
+        out[0] = inputs[0];
+        out[1] = inputs[1];
+    }
+
+private:
+    std::vector<uint8_t> bytes;
+    uint32_t recordsStart;
+    uint32_t indexOffset;
+    GameState state;
+    PaddleInput inputs[2];
+    uint32_t tick;
+    uint32_t cursor;         // next record
+    uint32_t nextRecordTick; // tick the next record applies to
+    uint32_t keyframeCount;
+    uint32_t keyframeWords[ReplayWriter::STATE_WORDS];
+
+    uint32_t readU32(size_t offset) const {
+        return (uint32_t)bytes[offset] | (uint32_t)bytes[offset + 1] << 8 | (uint32_t)bytes[offset + 2] << 16 |
+               (uint32_t)bytes[offset + 3] << 24;
+    }
+    uint32_t keyframeTick(uint32_t k) const { return readU32(indexOffset + 8 + (size_t)k * 8); }
+    uint32_t keyframeOffset(uint32_t k) const { return readU32(indexOffset + 12 + (size_t)k * 8); }
+
+    // the records of the current tick: a keyframe, new inputs
+    bool readPendingRecords() {
+        while (nextRecordTick == tick && cursor < indexOffset) {
+            if (!readRecord()) return false;
+        }
+        return true;
+    }
+
+    // applies the record at the cursor, which belongs to tick nextRecordTick
+    // (or to `tick` when jumping to a keyframe)
+    bool readRecord() {
+        const uint8_t *in = &bytes[0] + cursor, *end = &bytes[0] + indexOffset;
+        uint64_t head;
+        if (!readVarint(in, end, head)) return corrupt();
+        if (head & 1u) {
+            for (int i = 0; i < ReplayWriter::STATE_WORDS; i++) {
+                uint64_t word;
+                if (!readVarint(in, end, word)) return corrupt();
+                keyframeWords[i] ^= (uint32_t)word;
+            }
+            memcpy(&state, keyframeWords, sizeof(state));
+        } else {
+            if (in >= end) return corrupt();
+            uint8_t packed = *in++;
+            inputs[0].move = (int8_t)((packed & 3) - 1);
+            inputs[1].move = (int8_t)((packed >> 2 & 3) - 1);
+        }
+        cursor = (uint32_t)(in - &bytes[0]);
+
+        // tick of the following record
+        const uint8_t *peek = in;
+        uint64_t nextHead;
+        if (cursor < indexOffset && readVarint(peek, end, nextHead))
+            nextRecordTick = tick + (uint32_t)(nextHead >> 1);
+        else
+            nextRecordTick = 0xFFFFFFFFu;
+        return true;
+    }
+
+    bool corrupt() {
+        std::cout << "ERROR::REPLAY::CORRUPT_RECORD at byte " << cursor << std::endl;
+        cursor = indexOffset;
+        nextRecordTick = 0xFFFFFFFFu;
+        return false;
+    }
+
+    ReplayPlayer(const ReplayPlayer &);
+    ReplayPlayer &operator=(const ReplayPlayer &);
+};
+
+#endif
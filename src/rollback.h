@@ -0,0 +1,237 @@
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "game.h"
+#include "net_transport.h"
+
+// Two-player rollback netcode over a Transport.
+//
+// Every tick the local input is applied at once and sent to the peer; the
+// remote input, still on the way, is predicted (the last one received is
+// repeated, paddles rarely change direction). The state at the start of each
+// tick is kept in a ring, and when the real remote input for a tick turns
+// out different from the prediction the session rolls back to that tick's
+// snapshot and resimulates up to the present with the inputs now known. A
+// GameState is a few dozen bytes and stepGame() a few dozen nanoseconds,
+// so resimulating the 10 - 20 ticks of an 80 - 150 ms round trip at 120 Hz
+// costs about a microsecond.
+//
+// Packets carry all local inputs the peer has not acknowledged (so losses
+// need no resend), the acknowledgement of the peer's inputs, and the hash of
+// the newest state both sides have simulated with confirmed inputs only,
+// which must be equal on both ends: a difference is a desync.
+//
+// The simulation must be bit-for-bit deterministic (see game.h), both sides
+// use the same GameConfig, seed and step.
+class RollbackSession {
+
+public:
+    // snapshots kept, bounds how far the local side may run ahead
+    static const uint32_t HISTORY = 64;
+
+    struct Stats {
+        unsigned long rollbacks = 0;
+        unsigned long resimulatedTicks = 0;
+        unsigned int deepestRollback = 0;
+        unsigned long stalls = 0;     // ticks not advanced, too far ahead of the peer or of its acks
+        unsigned long desyncs = 0;
+        unsigned long packetsSent = 0;
+        unsigned long packetsReceived = 0;
+    };
+    Stats stats;
+
+    // maxPrediction: ticks the session may run ahead of the last remote input
+    RollbackSession(const GameConfig &config, uint32_t seed, float stepSeconds, int localPlayer,
+                    Transport *transport, uint32_t maxPrediction = 24)
+        : config(config), step(stepSeconds), localPlayer(localPlayer), transport(transport),
+          maxPrediction(maxPrediction < HISTORY - 1 ? maxPrediction : HISTORY - 1),
+          tick(0), confirmed(0), peerAcked(0), rollbackTo(NONE) {
+        resetGame(config, state, seed);
+        memset(localInputs, 0, sizeof(localInputs));
+        memset(remoteInputs, 0, sizeof(remoteInputs));
+        memset(usedRemote, 0, sizeof(usedRemote));
+    }
+
+    // next tick to simulate
+    uint32_t currentTick() const { return tick; }
+    // remote inputs known for every tick before this one
+    uint32_t confirmedTick() const { return confirmed; }
+    const GameState &current() const { return state; }
+
+    // A tick both inputs of which are confirmed, to record the match
+    // (replay.h): the state at its start and its inputs. False past the
+    // confirmed ticks, or once its snapshot is older than HISTORY ticks, so
+    // read them as they come, after each advance() or sync().
+    bool confirmedInputs(uint32_t t, GameState &start, PaddleInput input[2]) const {
+        if (t >= syncTick() || tick - t > HISTORY || rollbackTo != NONE) return false;
+        start = snapshots[t % HISTORY];
+        input[localPlayer] = localInputs[t % HISTORY];
+        input[1 - localPlayer] = remoteInputs[t % HISTORY];
+        return true;
+    }
+
+    // One fixed step: reads the network, rolls back if a prediction was
+    // wrong, then simulates the tick with `local`. False when the session
+    // is too far ahead of the peer and waits instead (the input is dropped).
+    bool advance(PaddleInput local) {
+        poll();
+        resimulate();
+
+        // the inputs the peer may still lack are resent from localInputs,
+        // which keeps HISTORY ticks: past that they would be overwritten.
+        // The peer's inputs can run ahead of ours, confirmed > tick.
+        bool ahead = (confirmed < tick && tick - confirmed >= maxPrediction) || tick - peerAcked >= HISTORY;
+        if (ahead) {
+            stats.stalls++;
+        } else {
+            localInputs[tick % HISTORY] = local;
+            simulate(tick);
+            tick++;
+        }
+        sendInputs();
+        return !ahead;
+    }
+
+    // Reads the network and resends without simulating a tick, e.g. at the
+    // end of a match until confirmedTick() catches up with currentTick().
+    void sync() {
+        poll();
+        resimulate();
+        sendInputs();
+    }
+
+private:
+    static const uint32_t NONE = 0xFFFFFFFFu;
+    static const uint32_t MAGIC = 0x504E4731u; // "PNG1"
+    static const uint32_t MAX_PACKET = 256;
+
+    GameConfig config;
+    float step;
+    int localPlayer;
+    Transport *transport;
+    uint32_t maxPrediction;
+
+    GameState state;
+    uint32_t tick;
+    uint32_t confirmed;  // remote inputs received for [0, confirmed)
+    uint32_t peerAcked;  // local inputs the peer has for [0, peerAcked)
+    uint32_t rollbackTo; // earliest tick simulated with a wrong prediction
+
+    // per tick, indexed by tick % HISTORY
+    GameState snapshots[HISTORY]; // state at the start of the tick
+    PaddleInput localInputs[HISTORY];
+    PaddleInput remoteInputs[HISTORY];
+    PaddleInput usedRemote[HISTORY];  // what the simulation used, predicted or not
+
+    PaddleInput predictRemote() const {
+        if (confirmed == 0) return PaddleInput();
+        return remoteInputs[(confirmed - 1) % HISTORY];
+    }
+
+    void simulate(uint32_t t) {
+        snapshots[t % HISTORY] = state;
+        PaddleInput remote = t < confirmed ? remoteInputs[t % HISTORY] : predictRemote();
+        usedRemote[t % HISTORY] = remote;
+        PaddleInput input[2];
+        input[localPlayer] = localInputs[t % HISTORY];
+        input[1 - localPlayer] = remote;
+        stepGame(config, state, input, step);
+    }
+
+    void resimulate() {
+        if (rollbackTo == NONE || rollbackTo >= tick) {
+            rollbackTo = NONE;
+            return;
+        }
+        uint32_t depth = tick - rollbackTo;
+        stats.rollbacks++;
+        stats.resimulatedTicks += depth;
+        if (depth > stats.deepestRollback) stats.deepestRollback = depth;
+        state = snapshots[rollbackTo % HISTORY];
+        for (uint32_t t = rollbackTo; t < tick; t++) simulate(t);
+        rollbackTo = NONE;
+    }
+
+    // FNV-1a of the snapshot at tick t, valid once t <= confirmed and t <= tick
+    uint32_t stateHash(uint32_t t) const {
+        const GameState &snapshot = t == tick ? state : snapshots[t % HISTORY];
+        const uint8_t *bytes = (const uint8_t *)&snapshot;
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < sizeof(GameState); i++) hash = (hash ^ bytes[i]) * 16777619u;
+        return hash;
+    }
+
+    // newest tick whose state only depends on confirmed inputs
+    uint32_t syncTick() const { return confirmed < tick ? confirmed : tick; }
+
+    // packet: magic, ack, sync tick, sync hash, first tick, count, count moves
+    void sendInputs() {
+        uint8_t packet[MAX_PACKET];
+        size_t size = 0;
+        uint32_t first = peerAcked;
+        if (tick - first > MAX_PACKET - 21) first = tick - (MAX_PACKET - 21);
+        uint32_t sync = syncTick();
+        writeU32(packet, size, MAGIC);
+        writeU32(packet, size, confirmed);
+        writeU32(packet, size, sync);
+        writeU32(packet, size, stateHash(sync));
+        writeU32(packet, size, first);
+        packet[size++] = (uint8_t)(tick - first);
+        for (uint32_t t = first; t < tick; t++) packet[size++] = (uint8_t)localInputs[t % HISTORY].move;
+        if (transport->send(packet, size)) stats.packetsSent++;
+    }
+
+    void poll() {
+        uint8_t packet[MAX_PACKET];
+        size_t size;
+        while ((size = transport->receive(packet, sizeof(packet))) > 0) {
+            if (size < 21 || readU32(packet) != MAGIC) continue;
+            stats.packetsReceived++;
+            uint32_t ack = readU32(packet + 4);
+            uint32_t sync = readU32(packet + 8), hash = readU32(packet + 12);
+            uint32_t first = readU32(packet + 16);
+            uint32_t count = packet[20];
+            if (size < 21 + count) continue;
+
+            if (ack > peerAcked && ack <= tick) peerAcked = ack;
+
+            // remote inputs, in order, the ones already known are skipped
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t t = first + i;
+                if (t < confirmed) continue;
+                if (t > confirmed) break; // a gap, the next packets repeat it
+                PaddleInput input;
+                input.move = (int8_t)packet[21 + i];
+                remoteInputs[t % HISTORY] = input;
+                if (t < tick && usedRemote[t % HISTORY].move != input.move && (rollbackTo == NONE || t < rollbackTo))
+                    rollbackTo = t;
+                confirmed++;
+            }
+
+            // compared once our side has the same confirmed history; before a
+            // pending rollback the snapshots past it are stale
+            bool comparable = sync <= confirmed && sync <= tick && tick - sync < HISTORY &&
+                              (rollbackTo == NONE || sync <= rollbackTo);
+            if (comparable && stateHash(sync) != hash) {
+                stats.desyncs++;
+                std::cout << "ERROR::ROLLBACK::DESYNC at tick " << sync << std::endl;
+            }
+        }
+    }
+
+    static void writeU32(uint8_t *out, size_t &size, uint32_t value) {
+        for (int i = 0; i < 4; i++) out[size++] = (uint8_t)(value >> (8 * i));
+    }
+    static uint32_t readU32(const uint8_t *in) {
+        return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+    }
+
+    RollbackSession(const RollbackSession &);
+    RollbackSession &operator=(const RollbackSession &);
+};
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef SDF_FONT_H
+#define SDF_FONT_H
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+#include "glm/glm.hpp"
+
+#include "thread_pool.h"
+
+// Signed distance field font atlas for the score and the HUD.
+//
+// Glyphs are strokes on a 4 x 6 grid (capitals, digits, a little
+// punctuation), so the distance field is exact: every texel takes its
+// distance to the nearest segment minus the stroke half width. The atlas
+// stores it as 0.5 on the outline, more inside, less outside, falling to 0
+// `SPREAD` texels out; the shader thresholds at 0.5 with a smoothing of a
+// screen pixel, which gives sharp edges from a few pixels tall up to the full
+// screen out of one small atlas.
+//
+// Glyphs are generated in parallel over the pool, then cached on disk (R8
+// texels behind a header with a hash of the strokes and the layout), so
+// later runs only read the file. Text is monospaced: ADVANCE grid units a
+// character for a height of 6.
+//
+//   cache file  "PSDF", version, hash, width, height, texels (u32 little endian, then bytes)
+
+class SdfFont {
+
+public:
+    static const uint32_t VERSION = 1;
+    static const int GRID_WIDTH = 4, GRID_HEIGHT = 6; // glyph box in grid units
+    static const int ADVANCE = 5;                     // grid units from a character to the next
+    static const int TEXELS_PER_UNIT = 6;
+    static const int SPREAD = 8;                      // texels of distance kept on each side of the outline
+    static const int CELL_WIDTH = GRID_WIDTH * TEXELS_PER_UNIT + 2 * SPREAD;
+    static const int CELL_HEIGHT = GRID_HEIGHT * TEXELS_PER_UNIT + 2 * SPREAD;
+    static const int COLUMNS = 16;
+
+    struct Stats {
+        bool fromCache = false;
+        double generateMs = 0.0;
+    };
+    Stats stats;
+
+    int width, height;
+    std::vector<uint8_t> texels; // width x height, row 0 at the bottom (GL order)
+
+    SdfFont() : width(0), height(0) {
+        const char *characters = glyphCharacters();
+        memset(glyphByChar, -1, sizeof(glyphByChar));
+        for (int i = 0; characters[i]; i++) glyphByChar[(unsigned char)characters[i]] = (int8_t)i;
+        glyphCount = (int)strlen(characters);
+        width = COLUMNS * CELL_WIDTH;
+        height = (glyphCount + COLUMNS - 1) / COLUMNS * CELL_HEIGHT;
+    }
+
+    // the cache when it matches this font, otherwise generated and cached
+    void loadOrGenerate(const std::string &cachePath, ThreadPool *pool = NULL) {
+        if (load(cachePath)) return;
+        generate(pool);
+        save(cachePath);
+    }
+
+    void generate(ThreadPool *pool = NULL) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        texels.assign((size_t)width * height, 0);
+        if (pool) pool->parallelFor(glyphCount, 1, [this](size_t begin, size_t end) { generateGlyphs(begin, end); });
+        else generateGlyphs(0, glyphCount);
+        stats.fromCache = false;
+        stats.generateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool load(const std::string &path) {
+        std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+        if (!file) return false;
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (bytes.size() != 20 + (size_t)width * height || memcmp(&bytes[0], "PSDF", 4) != 0 ||
+            readU32(bytes, 4) != VERSION || readU32(bytes, 8) != hash() || readU32(bytes, 12) != (uint32_t)width ||
+            readU32(bytes, 16) != (uint32_t)height) {
+            std::cout << "SDF font cache out of date, regenerating " << path << std::endl;
+            return false;
+        }
+        texels.assign(bytes.begin() + 20, bytes.end());
+        stats.fromCache = true;
+        return true;
+    }
+
+    bool save(const std::string &path) const {
+        std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+        if (!file) {
+            std::cout << "ERROR::SDF_FONT::FILE_NOT_WRITTEN " << path << std::endl;
+            return false;
+        }
+        std::vector<uint8_t> bytes;
+        bytes.insert(bytes.end(), "PSDF", "PSDF" + 4);
+        writeU32(bytes, VERSION);
+        writeU32(bytes, hash());
+        writeU32(bytes, (uint32_t)width);
+        writeU32(bytes, (uint32_t)height);
+        bytes.insert(bytes.end(), texels.begin(), texels.end());
+        file.write((const char *)&bytes[0], bytes.size());
+        return (bool)file;
+    }
+
+    // atlas cell of the character, -1 when the font has none (lower case is
+    // drawn as upper case)
+    int glyph(char c) const {
+        if (c >= 'a' && c <= 'z') c = (char)(c - 'a' + 'A');
+        return glyphByChar[(unsigned char)c];
+    }
+
+    // texture coordinates of a cell: min u, min v, max u, max v
+    glm::vec4 cellUv(int glyph) const {
+        glm::vec2 min((float)(glyph % COLUMNS * CELL_WIDTH), (float)(glyph / COLUMNS * CELL_HEIGHT));
+        glm::vec2 size(1.0f / width, 1.0f / height);
+        return glm::vec4(min * size, (min + glm::vec2(CELL_WIDTH, CELL_HEIGHT)) * size);
+    }
+
+private:
+    int8_t glyphByChar[256];
+    int glyphCount;
+
+    static const char *glyphCharacters() { return " 0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ:-./!+"; }
+
+    // strokes of each character, space separated, each a polyline of "xy" grid points
+    static const char *glyphStrokes(int glyph) {
+        static const char *strokes[] = {
+            "",
+            "103041453616050110", "152620 1030", "05163645440040", "05163645443313 334241301001",
+            "30360242", "460603334241301001", "36160501103041423303", "064610",
+            "13040516364544331302011030414233", "10304145361605041343",
+            "0004264440 0343", "00063645443303 3342413000", "4536160501103041", "00063645413000",
+            "46060040 0333", "460600 0333", "45361605011030414323", "0006 4640 0343",
+            "1636 2620 1030", "2646 3631201001", "0006 4602 1340", "060040",
+            "0006244640", "00064046", "103041453616050110", "00063645443303",
+            "103041453616050110 2240", "00063645443303 2340", "453616050413334241301001", "0646 2620",
+            "060110304146", "062046", "0610233046", "0046 0640",
+            "0623 4623 2320", "06460040",
+            "2121 2525", "1333", "2020", "0046", "2622 2020", "1333 2224"
+        };
+        return strokes[glyph];
+    }
+
+    // FNV-1a of the strokes and the layout, a different font makes the cache stale
+    uint32_t hash() const {
+        uint32_t h = 2166136261u;
+        const int layout[] = {TEXELS_PER_UNIT, SPREAD, CELL_WIDTH, CELL_HEIGHT, COLUMNS};
+        for (size_t i = 0; i < sizeof(layout); i++) h = (h ^ ((const uint8_t *)layout)[i]) * 16777619u;
+        for (int g = 0; g < glyphCount; g++) {
+            for (const char *p = glyphStrokes(g); *p; p++) h = (h ^ (uint8_t)*p) * 16777619u;
+            h = (h ^ (uint8_t)glyphCharacters()[g]) * 16777619u;
+        }
+        return h;
+    }
+
+    void generateGlyphs(size_t begin, size_t end) {
+        const float halfWidth = 0.45f * TEXELS_PER_UNIT;
+        std::vector<glm::vec4> segments; // a, b in texels of the cell
+        for (size_t g = begin; g < end; g++) {
+            segments.clear();
+            glm::vec2 previous(0.0f);
+            bool started = false;
+            for (const char *p = glyphStrokes((int)g); *p;) {
+                if (*p == ' ') {
+                    started = false;
+                    p++;
+                    continue;
+                }
+                glm::vec2 point = glm::vec2((float)(p[0] - '0'), (float)(p[1] - '0')) * (float)TEXELS_PER_UNIT +
+                                  (float)SPREAD;
+                if (started) segments.push_back(glm::vec4(previous, point));
+                // a single point is a dot
+                else if (p[2] == ' ' || p[2] == '\0') segments.push_back(glm::vec4(point, point));
+                previous = point;
+                started = true;
+                p += 2;
+            }
+
+            int cellX = (int)g % COLUMNS * CELL_WIDTH, cellY = (int)g / COLUMNS * CELL_HEIGHT;
+            for (int y = 0; y < CELL_HEIGHT; y++) {
+                uint8_t *row = &texels[(size_t)(cellY + y) * width + cellX];
+                for (int x = 0; x < CELL_WIDTH; x++) {
+                    glm::vec2 texel(x + 0.5f, y + 0.5f);
+                    float nearest = (float)(CELL_WIDTH + CELL_HEIGHT);
+                    for (size_t s = 0; s < segments.size(); s++)
+                        nearest = std::min(nearest, segmentDistance(texel, segments[s]));
+                    float value = 0.5f + (halfWidth - nearest) / (2.0f * SPREAD);
+                    row[x] = (uint8_t)(glm::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+                }
+            }
+        }
+    }
+
+    static float segmentDistance(const glm::vec2 &p, const glm::vec4 &segment) {
+        glm::vec2 a(segment.x, segment.y), ab = glm::vec2(segment.z, segment.w) - a;
+        float length2 = glm::dot(ab, ab);
+        float t = length2 > 0.0f ? glm::clamp(glm::dot(p - a, ab) / length2, 0.0f, 1.0f) : 0.0f;
+        return glm::length(p - (a + ab * t));
+    }
+
+    static uint32_t readU32(const std::vector<uint8_t> &bytes, size_t offset) {
+        return (uint32_t)bytes[offset] | (uint32_t)bytes[offset + 1] << 8 | (uint32_t)bytes[offset + 2] << 16 |
+               (uint32_t)bytes[offset + 3] << 24;
+    }
+    static void writeU32(std::vector<uint8_t> &out, uint32_t value) {
+        for (int i = 0; i < 4; i++) out.push_back((uint8_t)(value >> (8 * i)));
+    }
+
+    SdfFont(const SdfFont &);
+    SdfFont &operator=(const SdfFont &);
+};
+
+#endif
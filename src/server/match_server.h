@@ -0,0 +1,454 @@
+#ifndef MATCH_SERVER_H
+#define MATCH_SERVER_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <iomanip>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+#include "../game.h"
+#include "../ai.h"
+#include "../policy.h"
+#include "../thread_pool.h"
+#include "protocol.h"
+
+// Authoritative server for many Pong matches in one process.
+//
+// One UDP socket serves every client. Each tick has two phases:
+//
+//   network (main thread)  epoll wakes the loop when datagrams arrive, they
+//                          are drained and routed to their match by address:
+//                          joins, inputs, acknowledgements
+//   simulation (pool)      the matches are cut into chunks over the
+//                          work-stealing pool; each worker steps its
+//                          matches and sends their snapshots itself (sendto
+//                          on a UDP socket is thread-safe)
+//
+// The phases never overlap, so match and client data need no locks. A match
+// is a few hundred bytes and a step tens of nanoseconds: the cost per match is
+// the two snapshot packets, which is why they are quantized, delta encoded
+// and bit-packed (protocol.h). Matches are stepped a batch at a time
+// (stepGames()), and as ball collisions are swept the tick rate can go down
+// to a few dozen Hz without missed hits. Empty seats are played by a bot (ai.h), all the bots
+// of a chunk deciding together in float8 lanes, or by a trained network
+// (policy.h) run on the batch's bot seats at once. --bots fills the server
+// with bot-only matches to measure how many a host can take.
+class MatchServer {
+
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Settings {
+        unsigned short port;
+        double tickRate;
+        unsigned int threads;  // 0 = hardware threads - 1
+        int bots;              // bot-only matches, for load tests
+        int winningScore;
+        double clientTimeout;  // seconds without a packet before a client is dropped
+        AiSettings ai;         // how the bots play
+        // a trained network playing the bots instead, empty for none
+        std::string policyPath;
+
+        Settings() : port(7777), tickRate(60.0), threads(0), bots(0), winningScore(11), clientTimeout(10.0) {}
+    };
+
+    struct Stats {
+        std::atomic<unsigned long> packetsIn;
+        std::atomic<unsigned long> packetsOut;
+        std::atomic<unsigned long> bytesOut;
+        std::atomic<unsigned long> sendErrors;
+        unsigned long ticks;
+        double tickMsTotal, tickMsMax;
+
+        Stats() : packetsIn(0), packetsOut(0), bytesOut(0), sendErrors(0), ticks(0), tickMsTotal(0), tickMsMax(0) {}
+    };
+    Stats stats;
+
+    MatchServer(const Settings &settings)
+        : settings(settings), pool(settings.threads), socketFd(-1), pollFd(-1), waitingMatch(-1),
+          activeMatches(0), activeClients(0), seedCounter(1), bots(settings.ai) {}
+
+    ~MatchServer() {
+        if (socketFd >= 0) close(socketFd);
+#ifdef __linux__
+        if (pollFd >= 0) close(pollFd);
+#endif
+    }
+
+    bool start() {
+        socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (socketFd < 0) {
+            std::cout << "ERROR::SERVER::SOCKET_NOT_CREATED" << std::endl;
+            return false;
+        }
+        int bufferSize = 8 * 1024 * 1024;
+        setsockopt(socketFd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+        setsockopt(socketFd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(settings.port);
+        if (bind(socketFd, (sockaddr *)&address, sizeof(address)) < 0) {
+            std::cout << "ERROR::SERVER::BIND_FAILED " << settings.port << std::endl;
+            return false;
+        }
+        fcntl(socketFd, F_SETFL, fcntl(socketFd, F_GETFL, 0) | O_NONBLOCK);
+#ifdef __linux__
+        pollFd = epoll_create1(0);
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = socketFd;
+        if (pollFd < 0 || epoll_ctl(pollFd, EPOLL_CTL_ADD, socketFd, &event) < 0) {
+            std::cout << "ERROR::SERVER::EPOLL_FAILED" << std::endl;
+            return false;
+        }
+#endif
+        if (!settings.policyPath.empty() && !policy.load(settings.policyPath)) return false;
+        for (int i = 0; i < settings.bots; i++) {
+            int match = allocateMatch();
+            matches[match].bot[0] = matches[match].bot[1] = true;
+        }
+        std::cout << "Match server on port " << settings.port << ", " << settings.tickRate << " Hz, "
+                  << pool.size() + 1 << " threads, " << settings.bots << " bot matches" << std::endl;
+        return true;
+    }
+
+    // ticks until `running` turns false (or for `seconds` if > 0)
+    void run(const volatile bool &running, double seconds = 0.0) {
+        const Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / settings.tickRate));
+        Clock::time_point start = Clock::now(), nextTick = start, nextReport = start + std::chrono::seconds(1);
+        while (running) {
+            Clock::time_point now = Clock::now();
+            if (seconds > 0.0 && now - start >= std::chrono::duration_cast<Clock::duration>(
+                                                   std::chrono::duration<double>(seconds))) break;
+
+            // network until the tick is due
+            if (now < nextTick) {
+                waitReadable(nextTick - now);
+                receive();
+                continue;
+            }
+            receive();
+
+            Clock::time_point tickStart = Clock::now();
+            tick();
+            double tickMs = std::chrono::duration<double, std::milli>(Clock::now() - tickStart).count();
+            stats.ticks++;
+            stats.tickMsTotal += tickMs;
+            if (tickMs > stats.tickMsMax) stats.tickMsMax = tickMs;
+
+            // late ticks are not caught up, the matches just run slower
+            nextTick += period;
+            if (nextTick < Clock::now()) nextTick = Clock::now();
+
+            if (Clock::now() >= nextReport) {
+                dropSilentClients();
+                report();
+                nextReport += std::chrono::seconds(1);
+            }
+        }
+    }
+
+private:
+    static const uint32_t HISTORY = 32; // snapshots kept per match, the delta bases
+
+    struct Client {
+        sockaddr_in address;
+        int match;
+        int player;
+        uint32_t sequence; // newest input applied
+        uint32_t ack;      // newest snapshot received, NO_BASE before the first
+        Clock::time_point lastHeard;
+        bool active;
+    };
+
+    struct Match {
+        GameState state;
+        PaddleInput input[2];
+        int clients[2]; // -1: a bot plays
+        bool bot[2];
+        bool active;
+        QuantizedState history[HISTORY]; // as sent, by tick % HISTORY
+    };
+
+    Settings settings;
+    GameConfig config; // the same rules for every match
+    ThreadPool pool;
+    int socketFd;
+    int pollFd;
+    std::vector<Match> matches;
+    std::vector<int> freeMatches;
+    std::vector<Client> clients;
+    std::vector<int> freeClients;
+    std::unordered_map<uint64_t, int> clientByAddress;
+    int waitingMatch; // has one human and a bot keeping the seat warm
+    int activeMatches;
+    int activeClients;
+    uint32_t seedCounter;
+    SnapshotCodec codec;
+    AiBatch bots; // seat 2 * match + side
+    MlpPolicy policy;
+
+    static uint64_t addressKey(const sockaddr_in &address) {
+        return (uint64_t)address.sin_addr.s_addr << 16 | address.sin_port;
+    }
+
+    int allocateMatch() {
+        int index;
+        if (!freeMatches.empty()) {
+            index = freeMatches.back();
+            freeMatches.pop_back();
+        } else {
+            index = (int)matches.size();
+            matches.push_back(Match());
+        }
+        Match &match = matches[index];
+        resetGame(config, match.state, seedCounter++);
+        match.input[0].move = match.input[1].move = 0;
+        match.clients[0] = match.clients[1] = -1;
+        match.bot[0] = match.bot[1] = true;
+        match.active = true;
+        if (bots.size() < matches.size() * 2) bots.resize(matches.size() * 2);
+        bots.reset(index * 2, match.state.seed);
+        bots.reset(index * 2 + 1, match.state.seed ^ 0x9E3779B9u);
+        for (uint32_t i = 0; i < HISTORY; i++) match.history[i].tick = NO_BASE;
+        codec.quantize(match.state, match.history[match.state.tick % HISTORY]);
+        activeMatches++;
+        return index;
+    }
+
+    void waitReadable(Clock::duration timeout) {
+        int ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count();
+#ifdef __linux__
+        epoll_event event;
+        epoll_wait(pollFd, &event, 1, ms);
+#else
+        pollfd fd = {socketFd, POLLIN, 0};
+        ::poll(&fd, 1, ms);
+#endif
+    }
+
+    // drains the socket, main thread
+    void receive() {
+        uint8_t packet[64];
+        for (;;) {
+            sockaddr_in from;
+            socklen_t fromSize = sizeof(from);
+            ssize_t size = recvfrom(socketFd, packet, sizeof(packet), 0, (sockaddr *)&from, &fromSize);
+            if (size <= 0) return;
+            stats.packetsIn++;
+
+            std::unordered_map<uint64_t, int>::iterator found = clientByAddress.find(addressKey(from));
+            if (packet[0] == PACKET_JOIN) {
+                int client = found != clientByAddress.end() ? found->second : join(from);
+                if (client >= 0) welcome(clients[client]);
+                continue;
+            }
+            if (found == clientByAddress.end()) continue;
+            Client &client = clients[found->second];
+            client.lastHeard = Clock::now();
+            if (packet[0] == PACKET_INPUT && size >= 10) {
+                uint32_t ack = getU32(packet + 1), sequence = getU32(packet + 5);
+                if (ack != NO_BASE && (client.ack == NO_BASE || ack > client.ack)) client.ack = ack;
+                if (sequence > client.sequence || client.sequence == NO_BASE) {
+                    client.sequence = sequence;
+                    int8_t move = (int8_t)packet[9];
+                    matches[client.match].input[client.player].move = move < 0 ? -1 : (move > 0 ? 1 : 0);
+                }
+            }
+        }
+    }
+
+    // seats a new client: the free seat of the waiting match, or a new match
+    int join(const sockaddr_in &from) {
+        int index;
+        if (!freeClients.empty()) {
+            index = freeClients.back();
+            freeClients.pop_back();
+        } else {
+            index = (int)clients.size();
+            clients.push_back(Client());
+        }
+        Client &client = clients[index];
+        client.address = from;
+        client.sequence = NO_BASE;
+        client.ack = NO_BASE;
+        client.lastHeard = Clock::now();
+        client.active = true;
+        if (waitingMatch >= 0) {
+            client.match = waitingMatch;
+            client.player = 1;
+            waitingMatch = -1;
+        } else {
+            client.match = allocateMatch();
+            client.player = 0;
+            waitingMatch = client.match;
+        }
+        Match &match = matches[client.match];
+        match.clients[client.player] = index;
+        match.bot[client.player] = false;
+        clientByAddress[addressKey(from)] = index;
+        activeClients++;
+        return index;
+    }
+
+    void welcome(const Client &client) {
+        uint8_t packet[6];
+        size_t size = 0;
+        packet[size++] = PACKET_WELCOME;
+        packet[size++] = (uint8_t)client.player;
+        putU32(packet, size, matches[client.match].state.seed);
+        send(client.address, packet, size);
+    }
+
+    void send(const sockaddr_in &to, const uint8_t *packet, size_t size) {
+        if (sendto(socketFd, packet, size, 0, (const sockaddr *)&to, sizeof(to)) == (ssize_t)size) {
+            stats.packetsOut.fetch_add(1, std::memory_order_relaxed);
+            stats.bytesOut.fetch_add(size, std::memory_order_relaxed);
+        } else {
+            stats.sendErrors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // simulation phase
+    void tick() {
+        const float dt = (float)(1.0 / settings.tickRate);
+        // chunks of whole float8 groups of bot seats (4 matches)
+        const size_t groups = (matches.size() + 3) / 4;
+        pool.parallelFor(groups, 16, [this, dt](size_t beginGroup, size_t endGroup) {
+            const size_t begin = beginGroup * 4, end = std::min(endGroup * 4, matches.size());
+            if (!policy.loaded()) {
+                for (size_t i = begin; i < end; i++) {
+                    if (!matches[i].active) continue;
+                    for (int side = 0; side < 2; side++) bots.observe(i * 2 + side, config, matches[i].state, side);
+                }
+                bots.decide(config, dt, begin * 2, (end - begin) * 2);
+            }
+
+            // the active matches of the chunk, a batch at a time
+            const size_t BATCH = 64;
+            Match *batch[BATCH];
+            GameState *states[BATCH];
+            const PaddleInput *inputs[BATCH];
+            PolicyObservation observations[BATCH * 2];
+            PaddleInput *botInputs[BATCH * 2];
+            PaddleInput moves[BATCH * 2];
+            size_t i = begin;
+            while (i < end) {
+                size_t count = 0, seats = 0;
+                for (; i < end && count < BATCH; i++) {
+                    Match &match = matches[i];
+                    if (!match.active) continue;
+                    for (int side = 0; side < 2; side++) {
+                        if (!match.bot[side]) continue;
+                        if (policy.loaded()) {
+                            observations[seats] = observePolicy(config, match.state, side);
+                            botInputs[seats++] = &match.input[side];
+                        } else {
+                            match.input[side] = bots.input(i * 2 + side);
+                        }
+                    }
+                    batch[count] = &match;
+                    states[count] = &match.state;
+                    inputs[count] = match.input;
+                    count++;
+                }
+                if (seats) {
+                    policy.act(observations, seats, moves);
+                    for (size_t k = 0; k < seats; k++) *botInputs[k] = moves[k];
+                }
+                stepGames(config, states, inputs, count, dt);
+                for (size_t k = 0; k < count; k++) finishStep(*batch[k]);
+            }
+        });
+    }
+
+    // after the step: end of match, snapshots
+    void finishStep(Match &match) {
+        if (match.state.score[0] >= settings.winningScore || match.state.score[1] >= settings.winningScore) {
+            uint32_t tick = match.state.tick;
+            resetGame(config, match.state, (uint32_t)splitMix64(match.state.seed));
+            match.state.tick = tick; // ticks keep counting, the delta bases stay valid
+        }
+        QuantizedState &snapshot = match.history[match.state.tick % HISTORY];
+        codec.quantize(match.state, snapshot);
+
+        for (int side = 0; side < 2; side++) {
+            if (match.clients[side] < 0) continue;
+            const Client &client = clients[match.clients[side]];
+            const QuantizedState *base = NULL;
+            if (client.ack != NO_BASE && match.state.tick - client.ack < HISTORY &&
+                match.history[client.ack % HISTORY].tick == client.ack)
+                base = &match.history[client.ack % HISTORY];
+            uint8_t packet[MAX_SNAPSHOT_PACKET];
+            size_t size = encodeSnapshot(codec, snapshot, base, packet);
+            if (size) send(client.address, packet, size);
+        }
+    }
+
+    void dropSilentClients() {
+        Clock::time_point now = Clock::now();
+        for (size_t i = 0; i < clients.size(); i++) {
+            Client &client = clients[i];
+            if (!client.active || std::chrono::duration<double>(now - client.lastHeard).count() < settings.clientTimeout)
+                continue;
+            Match &match = matches[client.match];
+            match.clients[client.player] = -1;
+            match.bot[client.player] = true;
+            if (match.clients[0] < 0 && match.clients[1] < 0) {
+                match.active = false;
+                freeMatches.push_back(client.match);
+                activeMatches--;
+                if (waitingMatch == client.match) waitingMatch = -1;
+            }
+            clientByAddress.erase(addressKey(client.address));
+            client.active = false;
+            freeClients.push_back((int)i);
+            activeClients--;
+        }
+    }
+
+    void report() {
+        double ticks = stats.ticks ? (double)stats.ticks : 1.0;
+        std::ios::fmtflags flags = std::cout.flags();
+        std::streamsize precision = std::cout.precision();
+        std::cout << std::fixed << std::setprecision(3) << "matches " << activeMatches << ", clients "
+                  << activeClients << ", tick ms " << stats.tickMsTotal / ticks << " (max " << stats.tickMsMax
+                  << "), packets in " << stats.packetsIn.load() << " out " << stats.packetsOut.load() << " ("
+                  << std::setprecision(1) << stats.bytesOut.load() / 1024.0 << " KiB, " << stats.sendErrors.load()
+                  << " errors)" << std::endl;
+        std::cout.flags(flags);
+        std::cout.precision(precision);
+        stats.ticks = 0;
+        stats.tickMsTotal = stats.tickMsMax = 0.0;
+        stats.packetsIn = stats.packetsOut = stats.bytesOut = stats.sendErrors = 0;
+    }
+
+    MatchServer(const MatchServer &);
+    MatchServer &operator=(const MatchServer &);
+};
+
+#endif
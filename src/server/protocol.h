@@ -0,0 +1,70 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "../game.h"
+#include "../snapshot_codec.h"
+
+// Client / match server packets, one UDP datagram each, little endian.
+//
+//   JOIN      type                                    client -> server
+//   WELCOME   type, player (u8), seed (u32)           server -> client
+//   INPUT     type, snapshot ack (u32), sequence (u32), move (i8)
+//   SNAPSHOT  type, tick (u32), base distance (u8), SnapshotCodec bits
+//
+// The server is authoritative: clients only send their paddle input and
+// receive the state. A snapshot is quantized and delta encoded against the
+// snapshot the client last acknowledged, `base distance` ticks older (0: no
+// base, every field in full), see snapshot_codec.h: 12 - 22 bytes a packet
+// where the raw struct and header take 42.
+
+enum PacketType {
+    PACKET_JOIN = 1,
+    PACKET_WELCOME = 2,
+    PACKET_INPUT = 3,
+    PACKET_SNAPSHOT = 4
+};
+
+static const uint32_t NO_BASE = 0xFFFFFFFFu;
+static const size_t SNAPSHOT_HEADER = 6;
+static const size_t MAX_SNAPSHOT_PACKET = 64;
+
+inline void putU32(uint8_t *out, size_t &size, uint32_t value) {
+    for (int i = 0; i < 4; i++) out[size++] = (uint8_t)(value >> (8 * i));
+}
+inline uint32_t getU32(const uint8_t *in) {
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+// base NULL, or the state `state.tick - base->tick` (< 256) ticks older. Returns the packet size
+inline size_t encodeSnapshot(const SnapshotCodec &codec, const QuantizedState &state, const QuantizedState *base,
+                             uint8_t *out) {
+    size_t size = 0;
+    out[size++] = PACKET_SNAPSHOT;
+    putU32(out, size, state.tick);
+    out[size++] = (uint8_t)(base ? state.tick - base->tick : 0);
+    size_t payload = codec.encode(state, base, out + size, MAX_SNAPSHOT_PACKET - size);
+    return payload ? size + payload : 0;
+}
+
+// tick of the snapshot and of its base (NO_BASE for none), to find the base before decoding
+inline bool readSnapshotHeader(const uint8_t *in, size_t size, uint32_t &tick, uint32_t &baseTick) {
+    if (size < SNAPSHOT_HEADER || in[0] != PACKET_SNAPSHOT) return false;
+    tick = getU32(in + 1);
+    baseTick = in[5] ? tick - in[5] : NO_BASE;
+    return true;
+}
+
+// `base` is the client's copy of the state at the base tick (NULL for NO_BASE)
+inline bool decodeSnapshot(const SnapshotCodec &codec, const uint8_t *in, size_t size, const QuantizedState *base,
+                           QuantizedState &state) {
+    uint32_t tick, baseTick;
+    if (!readSnapshotHeader(in, size, tick, baseTick) || (baseTick != NO_BASE) != (base != NULL)) return false;
+    if (!codec.decode(in + SNAPSHOT_HEADER, size - SNAPSHOT_HEADER, base, state)) return false;
+    state.tick = tick;
+    return true;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#include "match_server.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <string>
+#include <iostream>
+
+// Dedicated match server, built with `make server`:
+//   --port N         UDP port (default 7777)
+//   --tick-rate N    simulation ticks per second (default 60)
+//   --threads N      simulation workers besides the main thread (default: hardware threads - 1)
+//   --bots N         bot-only matches, to load test a host
+//   --ai LEVEL       how the bots play: easy, normal (default) or hard
+//   --policy F.mlp   a trained network plays the bots instead (policy.h)
+//   --duration S     stop after S seconds (default: until Ctrl-C)
+
+static volatile bool running = true;
+
+static void stop(int)
+{
+    running = false;
+}
+
+int main(int argc, char **argv)
+{
+    MatchServer::Settings settings;
+    double duration = 0.0;
+    for (int i = 1; i < argc; i++) {
+      std::string arg = argv[i];
+      if (arg == "--port" && i + 1 < argc) settings.port = (unsigned short)atoi(argv[++i]);
+      else if (arg == "--tick-rate" && i + 1 < argc) settings.tickRate = atof(argv[++i]);
+      else if (arg == "--threads" && i + 1 < argc) settings.threads = (unsigned int)atoi(argv[++i]);
+      else if (arg == "--bots" && i + 1 < argc) settings.bots = atoi(argv[++i]);
+      else if (arg == "--ai" && i + 1 < argc) {
+        std::string level = argv[++i];
+        if (level == "easy") settings.ai = AiSettings::easy();
+        else if (level == "hard") settings.ai = AiSettings::hard();
+        else settings.ai = AiSettings::normal();
+      }
+      else if (arg == "--policy" && i + 1 < argc) settings.policyPath = argv[++i];
+      else if (arg == "--duration" && i + 1 < argc) duration = atof(argv[++i]);
+      else std::cout << "Unknown argument " << arg << std::endl;
+    }
+    if (settings.tickRate <= 0.0) settings.tickRate = 60.0;
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    MatchServer server(settings);
+    if (!server.start()) return -1;
+    server.run(running, duration);
+    return 0;
+}
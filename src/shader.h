@@ -3,10 +3,26 @@
 
 #include <GL/glew.h>
 
+#include "gl_state.h"
+#include "shader_preprocessor.h"
+
 #include <string>   // Handle strings
 #include <fstream>  // Input/output stream class to operate on files.
 #include <sstream>  // Stream class to operate on strings. 
 #include <iostream> // Input/output stream objects
+#include <map>      // Uniform blocks by name
+#include <vector>
+#include <algorithm>
+
+#include "glm/glm.hpp"
+
+// Uniform block binding points shared by every program: a block named
+// "Frame" is bound to the per-frame UBO and one named "Object" to the range
+// of the current object in the per-object UBO.
+enum UniformBlockBinding {
+    FRAME_UNIFORMS_BINDING = 0,
+    OBJECT_UNIFORMS_BINDING = 1
+};
 
 class Shader {
 
@@ -14,84 +30,167 @@ public:
     // the program id
     unsigned int ID;
 
-    // constructor reads and builds the shader
-    Shader(const GLchar* vertexPath, const GLchar* fragmentPath){
-        
-        // 1. Retrieve the  vertex/fragment source from filepath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensure ifstream objects can throw exceptions
-        vShaderFile.exceptions (std::ifstream::failbit || std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit || std::ifstream::badbit);
-        try{
-            // Open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer content into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // Close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // Convert Stream into strings
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-        }
-        catch(std::ifstream::failure e) {
+    // active uniform blocks, as reported by the driver after linking
+    struct UniformBlock {
+        GLuint index;
+        GLint dataSize; // bytes, std140 size of the block
+    };
+    std::map<std::string, UniformBlock> uniformBlocks;
+
+    // where the sources came from, for hot reload
+    std::string vertexPath;
+    std::string fragmentPath;
+    // the variant: defines given to the preprocessor
+    ShaderDefines defines;
+    // every file the sources were built from, includes too
+    std::vector<std::string> dependencies;
+    // bumped every time a reload replaces the program
+    unsigned int generation;
+    // ShaderProgramSource::hash of the code the program was built from
+    uint64_t sourceHash;
+
+    // constructor reads, preprocesses and builds the shader
+    Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const ShaderDefines &defines = ShaderDefines())
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines), generation(0), sourceHash(0) {
+
+        // 1. Retrieve the vertex/fragment source from filepath, resolving #include and #if
+        ShaderProgramSource source;
+        if (!loadSources(source))
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-        }
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
+        dependencies = source.files();
 
-        // 2. Compile Shaders
-        unsigned int vertex, fragment;
-        int success;
-        char infoLog[512];
-        
-        // Vertex Shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        // print compile error if any
-        glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-        if(!success){
-            glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-        }
+        // 2. Compile and link, waiting for the result
+        PendingProgram built = startProgram(source.vertex.code, source.fragment.code);
+        ID = built.program;
+        finishProgram(built);
+        programUsers()[ID]++;
+        sourceHash = source.hash;
 
-        // Fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        // print compile error if any
-        glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-        if(!success){
-            glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        reflectUniformBlocks();
+        bindUniformBlock("Frame", FRAME_UNIFORMS_BINDING);
+        bindUniformBlock("Object", OBJECT_UNIFORMS_BINDING);
+    }
+
+    // A variant of already preprocessed sources, with no program yet: ID
+    // stays 0 until beginReload() and pollReload() build one, or until
+    // shareProgram() gives it the program of an equal variant (see ShaderVariants).
+    explicit Shader(const ShaderProgramSource &source)
+        : ID(0), vertexPath(source.vertexPath), fragmentPath(source.fragmentPath),
+          defines(source.defines), generation(0), sourceHash(source.hash) {
+        dependencies = source.files();
+    }
+
+    // true once a program is linked
+    bool ready() const {
+        return ID != 0;
+    }
+
+    // Reads the current sources of this variant. Touches no GL state, so it
+    // can run on a worker thread.
+    bool loadSources(ShaderProgramSource &source) const {
+        return loadShaderProgram(vertexPath, fragmentPath, defines, source);
+    }
+
+    static bool readFile(const std::string &path, std::string &contents) {
+        return ShaderPreprocessor::readFile(path, contents);
+    }
+
+    // Ask the driver to compile on its own threads (KHR/ARB_parallel_shader_compile).
+    // Without it, compiling still works but pollReload() blocks until done.
+    static bool enableParallelCompile() {
+#if defined(GL_KHR_parallel_shader_compile)
+        if (GLEW_KHR_parallel_shader_compile) {
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+            parallelCompile() = true;
         }
+#endif
+#if defined(GL_ARB_parallel_shader_compile)
+        if (!parallelCompile() && GLEW_ARB_parallel_shader_compile) {
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+            parallelCompile() = true;
+        }
+#endif
+        return parallelCompile();
+    }
 
-        // Shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        // Print Linking errors if any
-        glGetProgramiv(ID, GL_LINK_STATUS, &success);
-        if (!success){
-            glGetProgramInfoLog(ID, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    // Hot reload, on the render thread. beginReload() only submits the
+    // sources; pollReload() at a frame boundary swaps the program in once the
+    // driver is done. If compiling or linking fails the old program stays.
+    void beginReload(const ShaderProgramSource &source) {
+        discardReload();
+        pending = startProgram(source.vertex.code, source.fragment.code);
+        pending.hash = source.hash;
+    }
+    bool reloadPending() const {
+        return pending.program != 0;
+    }
+    // sourceHash of the program being built, 0 if none
+    uint64_t pendingHash() const {
+        return pending.hash;
+    }
+    // true when the program was replaced, `wait` blocks until the driver is done
+    bool pollReload(bool wait = false) {
+        if (!pending.program) return false;
+        if (parallelCompile() && !wait) {
+            GLint done = GL_FALSE;
+            glGetProgramiv(pending.program, 0x91B1 /* GL_COMPLETION_STATUS_KHR */, &done);
+            if (!done) return false;
         }
-        // delete the shaders as they are linked to our program and not required
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        if (!finishProgram(pending)) {
+            std::cout << "ERROR::SHADER::RELOAD_FAILED keeping the previous program ("
+                      << vertexPath << ", " << fragmentPath << ")" << std::endl;
+            glState().deleteProgram(pending.program);
+            pending = PendingProgram();
+            return false;
+        }
+        PendingProgram built = pending;
+        pending = PendingProgram();
+        swapProgram(built.program, built.hash);
+        return true;
+    }
+    // runs the linked program of `other`, built from the same code: the
+    // program is deleted once no shader uses it any more
+    void shareProgram(const Shader &other) {
+        if (other.ID == ID) return;
+        discardReload();
+        swapProgram(other.ID, other.sourceHash);
+    }
+    void discardReload() {
+        if (!pending.program) return;
+        glDeleteShader(pending.vertex);
+        glDeleteShader(pending.fragment);
+        glState().deleteProgram(pending.program);
+        pending = PendingProgram();
+    }
 
+    // list the uniform blocks of the linked program
+    void reflectUniformBlocks() {
+        uniformBlocks.clear();
+        GLint count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        for (GLint i = 0; i < count; i++) {
+            char name[256];
+            GLsizei length = 0;
+            glGetActiveUniformBlockName(ID, i, sizeof(name), &length, name);
+            UniformBlock block;
+            block.index = (GLuint)i;
+            glGetActiveUniformBlockiv(ID, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+            uniformBlocks[std::string(name, length)] = block;
+        }
+    }
+    // attach a uniform block to a binding point, false if the block is not used
+    bool bindUniformBlock(const std::string &name, GLuint binding) const {
+        std::map<std::string, UniformBlock>::const_iterator it = uniformBlocks.find(name);
+        if (it == uniformBlocks.end()) return false;
+        glUniformBlockBinding(ID, it->second.index, binding);
+        return true;
     }
-    // use/activate the shader
+    bool hasUniformBlock(const std::string &name) const {
+        return uniformBlocks.count(name) != 0;
+    }
+    // use/activate the shader (skipped if it is already in use)
     void use() {
-        glUseProgram(ID);
+        glState().useProgram(ID);
     };
     // utility uniform functions
     void setBool(const std::string &name, bool value) const {
@@ -102,7 +201,112 @@ public:
     };
     void setInt(const std::string &name, int value) const {
         glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        intUniforms[name] = value; // sampler units etc., reapplied after a reload
+    };
+    void setMat4(const std::string &name, const glm::mat4 &value) const {
+        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &value[0][0]);
     };
+
+private:
+    struct PendingProgram {
+        GLuint vertex = 0;
+        GLuint fragment = 0;
+        GLuint program = 0;
+        uint64_t hash = 0;
+    };
+    PendingProgram pending;
+    mutable std::map<std::string, int> intUniforms;
+
+    Shader(const Shader &);
+    Shader &operator=(const Shader &);
+
+
+    static bool &parallelCompile() {
+        static bool enabled = false;
+        return enabled;
+    }
+
+    // shaders running each program (render thread only)
+    static std::map<GLuint, int> &programUsers() {
+        static std::map<GLuint, int> users;
+        return users;
+    }
+
+    void swapProgram(GLuint program, uint64_t hash) {
+        GLuint old = ID;
+        ID = program;
+        sourceHash = hash;
+        programUsers()[ID]++;
+        if (old && --programUsers()[old] == 0) {
+            programUsers().erase(old);
+            glState().deleteProgram(old);
+        }
+        generation++;
+
+        reflectUniformBlocks();
+        bindUniformBlock("Frame", FRAME_UNIFORMS_BINDING);
+        bindUniformBlock("Object", OBJECT_UNIFORMS_BINDING);
+        // uniforms are program state: restore the ones set through setInt()
+        GLuint current = glState().currentProgram();
+        use();
+        for (std::map<std::string, int>::const_iterator it = intUniforms.begin(); it != intUniforms.end(); ++it)
+            glUniform1i(glGetUniformLocation(ID, it->first.c_str()), it->second);
+        if (current != old && current != GLStateCache::UNKNOWN) glState().useProgram(current);
+    }
+
+    // submit compile and link without asking for the result (which would wait)
+    static PendingProgram startProgram(const std::string &vertexCode, const std::string &fragmentCode) {
+        const char* vShaderCode = vertexCode.c_str();
+        const char* fShaderCode = fragmentCode.c_str();
+        PendingProgram p;
+
+        // Vertex Shader
+        p.vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(p.vertex, 1, &vShaderCode, NULL);
+        glCompileShader(p.vertex);
+
+        // Fragment Shader
+        p.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(p.fragment, 1, &fShaderCode, NULL);
+        glCompileShader(p.fragment);
+
+        // Shader Program
+        p.program = glCreateProgram();
+        glAttachShader(p.program, p.vertex);
+        glAttachShader(p.program, p.fragment);
+        glLinkProgram(p.program);
+        return p;
+    }
+
+    // print compile / link errors if any, and release the shader objects
+    static bool finishProgram(const PendingProgram &p) {
+        int success;
+        char infoLog[512];
+        bool ok = true;
+
+        glGetShaderiv(p.vertex, GL_COMPILE_STATUS, &success);
+        if(!success){
+            glGetShaderInfoLog(p.vertex, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+            ok = false;
+        }
+        glGetShaderiv(p.fragment, GL_COMPILE_STATUS, &success);
+        if(!success){
+            glGetShaderInfoLog(p.fragment, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+            ok = false;
+        }
+        glGetProgramiv(p.program, GL_LINK_STATUS, &success);
+        if (!success){
+            glGetProgramInfoLog(p.program, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+            ok = false;
+        }
+        // delete the shaders as they are linked to our program and not required
+        glDeleteShader(p.vertex);
+        glDeleteShader(p.fragment);
+        return ok;
+    }
 };
 
 #endif
\ No newline at end of file
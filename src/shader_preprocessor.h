@@ -0,0 +1,443 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <cctype>
+
+// GLSL preprocessing done before glShaderSource.
+//
+// - `#include "file"` is resolved relative to the including file (`#pragma
+//   once` is honoured, cycles are errors).
+// - the caller's defines and the file's own #define drive every #if / #ifdef
+//   / #ifndef / #elif / #else / #endif, so the driver only sees the branch
+//   of the variant. Defines no longer referenced by the remaining code are
+//   dropped, the caller's ones still used are injected after #version.
+//
+// Because of the last point two define sets that select the same code give
+// byte-identical sources, which is what ShaderVariants dedupes on.
+//
+// Skipped lines are kept empty and every file switch emits `#line <n> <file>`,
+// so driver errors give the line in the file and files[file] its path.
+
+// name -> value; use "1" for flags
+typedef std::map<std::string, std::string> ShaderDefines;
+
+// one stage after preprocessing
+struct ShaderSource {
+    std::string code;
+    std::vector<std::string> files; // every file read, indexed by the #line source number
+};
+
+// FNV-1a, chained through `hash`
+inline uint64_t hashShaderSource(const std::string &text, uint64_t hash = 14695981039346656037ull) {
+    for (size_t i = 0; i < text.size(); i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+class ShaderPreprocessor {
+
+public:
+    ShaderPreprocessor(const ShaderDefines &defines) : injected(defines) {}
+
+    bool process(const std::string &path, ShaderSource &out) {
+        macros = injected;
+        once.clear();
+        stack.clear();
+        branches.clear();
+        version.clear();
+        body.clear();
+        ok = true;
+        out.files.clear();
+
+        processFile(path, out);
+        if (!ok) return false;
+        if (version.empty()) {
+            std::cout << "ERROR::SHADER_PREPROCESSOR::MISSING_VERSION " << path << std::endl;
+            return false;
+        }
+
+        // #define only used by the resolved conditionals is dead now
+        std::set<std::string> used;
+        std::istringstream lines(body);
+        std::string line, pruned;
+        while (std::getline(lines, line)) {
+            std::string directive, name, value;
+            size_t start = line.find_first_not_of(" \t");
+            if (start != std::string::npos && line[start] == '#') {
+                splitDirective(line.substr(start + 1), directive, name);
+                if (directive == "define") {
+                    splitDirective(name, name, value, true);
+                    collectIdentifiers(value, used);
+                }
+                continue;
+            }
+            collectIdentifiers(line, used);
+        }
+        lines.clear();
+        lines.str(body);
+        while (std::getline(lines, line)) {
+            std::string directive, name, value;
+            size_t start = line.find_first_not_of(" \t");
+            if (start != std::string::npos && line[start] == '#') {
+                splitDirective(line.substr(start + 1), directive, name);
+                splitDirective(name, name, value, true);
+                if (directive == "define" && name.find('(') == std::string::npos && !used.count(name))
+                    line.clear();
+            }
+            pruned += line + "\n";
+        }
+        body.swap(pruned);
+
+        out.code = version + "\n";
+        for (ShaderDefines::const_iterator it = injected.begin(); it != injected.end(); ++it)
+            if (used.count(it->first)) out.code += "#define " + it->first + " " + it->second + "\n";
+        out.code += body;
+        return true;
+    }
+
+    static bool readFile(const std::string &path, std::string &contents) {
+        std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+        if (!file) return false;
+        std::stringstream stream;
+        stream << file.rdbuf();
+        contents = stream.str();
+        return !file.bad();
+    }
+
+private:
+    ShaderDefines injected;
+    std::map<std::string, std::string> macros; // injected + #define seen so far
+    std::set<std::string> once;
+    std::vector<std::string> stack; // files being included
+    std::string version;
+    std::string body;
+    bool ok;
+
+    struct Branch {
+        bool parentActive;
+        bool taken;  // some branch of this #if chain was selected
+        bool active; // the current branch is emitted
+    };
+    std::vector<Branch> branches;
+
+    bool active() const { return branches.empty() || branches.back().active; }
+
+    void error(const char *what, const std::string &path, int line) {
+        std::cout << "ERROR::SHADER_PREPROCESSOR::" << what << " " << path << ":" << line << std::endl;
+        ok = false;
+    }
+
+    static std::string lineDirective(int line, size_t file) {
+        std::ostringstream s;
+        s << "#line " << line << " " << file << "\n";
+        return s.str();
+    }
+
+    void processFile(const std::string &path, ShaderSource &out) {
+        for (size_t i = 0; i < stack.size(); i++) {
+            if (stack[i] == path) return error("INCLUDE_CYCLE", path, 0);
+        }
+        if (once.count(path)) return;
+
+        std::string text;
+        if (!readFile(path, text)) return error("FILE_NOT_READ", path, 0);
+
+        size_t fileIndex = out.files.size();
+        out.files.push_back(path);
+        stack.push_back(path);
+        size_t depth = branches.size();
+        body += lineDirective(1, fileIndex);
+
+        std::istringstream lines(text);
+        std::string line;
+        int lineNumber = 0;
+        while (ok && std::getline(lines, line)) {
+            lineNumber++;
+            if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+
+            size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line[start] != '#') {
+                body += active() ? line + "\n" : "\n";
+                continue;
+            }
+
+            std::string directive, rest;
+            splitDirective(line.substr(start + 1), directive, rest);
+
+            if (directive == "if" || directive == "ifdef" || directive == "ifndef") {
+                Branch b;
+                b.parentActive = active();
+                bool condition = false;
+                if (b.parentActive) {
+                    if (directive == "if") condition = evaluate(rest, path, lineNumber) != 0;
+                    else condition = (macros.count(firstWord(rest)) != 0) == (directive == "ifdef");
+                }
+                b.taken = b.active = condition;
+                branches.push_back(b);
+                body += "\n";
+            } else if (directive == "elif" || directive == "else") {
+                if (branches.size() <= depth) return error("UNEXPECTED_ELSE", path, lineNumber);
+                Branch &b = branches.back();
+                if (!b.parentActive || b.taken) {
+                    b.active = false;
+                } else {
+                    b.active = directive == "else" || evaluate(rest, path, lineNumber) != 0;
+                    b.taken = b.active;
+                }
+                body += "\n";
+            } else if (directive == "endif") {
+                if (branches.size() <= depth) return error("UNEXPECTED_ENDIF", path, lineNumber);
+                branches.pop_back();
+                body += "\n";
+            } else if (!active()) {
+                body += "\n";
+            } else if (directive == "version") {
+                if (stack.size() > 1 || !version.empty()) return error("VERSION_NOT_FIRST", path, lineNumber);
+                version = line.substr(start);
+                body += "\n";
+            } else if (directive == "include") {
+                std::string name = unquote(rest);
+                if (name.empty()) return error("BAD_INCLUDE", path, lineNumber);
+                processFile(directoryOf(path) + name, out);
+                body += lineDirective(lineNumber + 1, fileIndex);
+            } else if (directive == "pragma" && firstWord(rest) == "once") {
+                once.insert(path);
+                body += "\n";
+            } else {
+                if (directive == "define") {
+                    std::string name, value;
+                    splitDirective(rest, name, value, true);
+                    size_t paren = name.find('(');
+                    if (paren != std::string::npos) name.erase(paren); // function-like, value unused
+                    macros[name] = value;
+                } else if (directive == "undef") {
+                    macros.erase(firstWord(rest));
+                }
+                body += line + "\n";
+            }
+        }
+
+        if (ok && branches.size() != depth) error("UNTERMINATED_CONDITIONAL", path, lineNumber);
+        stack.pop_back();
+    }
+
+    // `head` is the leading identifier, with its parameter list if `params`
+    static void splitDirective(const std::string &text, std::string &head, std::string &tail,
+                               bool params = false) {
+        size_t a = text.find_first_not_of(" \t");
+        if (a == std::string::npos) { head.clear(); tail.clear(); return; }
+        size_t b = a;
+        while (b < text.size() && (isalnum((unsigned char)text[b]) || text[b] == '_')) b++;
+        if (params && b < text.size() && text[b] == '(') {
+            size_t close = text.find(')', b);
+            b = close == std::string::npos ? text.size() : close + 1;
+        }
+        head = text.substr(a, b - a);
+        size_t c = text.find_first_not_of(" \t", b);
+        tail = c == std::string::npos ? std::string() : stripComment(text.substr(c));
+    }
+
+    static std::string stripComment(std::string text) {
+        size_t c = text.find("//");
+        if (c != std::string::npos) text.erase(c);
+        while ((c = text.find("/*")) != std::string::npos) {
+            size_t e = text.find("*/", c + 2);
+            text.erase(c, e == std::string::npos ? std::string::npos : e + 2 - c);
+        }
+        size_t end = text.find_last_not_of(" \t");
+        return end == std::string::npos ? std::string() : text.substr(0, end + 1);
+    }
+
+    static std::string firstWord(const std::string &text) {
+        size_t a = text.find_first_not_of(" \t");
+        if (a == std::string::npos) return std::string();
+        size_t b = text.find_first_of(" \t", a);
+        return text.substr(a, b == std::string::npos ? std::string::npos : b - a);
+    }
+
+    static std::string unquote(const std::string &text) {
+        if (text.size() < 2) return std::string();
+        char close = text[0] == '"' ? '"' : text[0] == '<' ? '>' : 0;
+        size_t end = text.find(close, 1);
+        if (!close || end == std::string::npos) return std::string();
+        return text.substr(1, end - 1);
+    }
+
+    static std::string directoryOf(const std::string &path) {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    static void collectIdentifiers(const std::string &text, std::set<std::string> &out) {
+        for (size_t i = 0; i < text.size();) {
+            if (isalpha((unsigned char)text[i]) || text[i] == '_') {
+                size_t j = i;
+                while (j < text.size() && (isalnum((unsigned char)text[j]) || text[j] == '_')) j++;
+                out.insert(text.substr(i, j - i));
+                i = j;
+            } else if (isdigit((unsigned char)text[i])) {
+                while (i < text.size() && (isalnum((unsigned char)text[i]) || text[i] == '.')) i++;
+            } else {
+                i++;
+            }
+        }
+    }
+
+    // #if expressions: integers, defined(), ! && || == != < > <= >= + - and parentheses.
+    // Unknown identifiers are 0, as in C.
+    struct Expression {
+        const std::map<std::string, std::string> *macros;
+        std::vector<std::string> tokens;
+        size_t pos;
+        int depth;
+        bool valid;
+
+        Expression(const std::map<std::string, std::string> *macros, const std::string &text, int depth)
+            : macros(macros), pos(0), depth(depth), valid(true) {
+            for (size_t i = 0; i < text.size();) {
+                char c = text[i];
+                if (c == ' ' || c == '\t') { i++; continue; }
+                size_t j = i + 1;
+                if (isalnum((unsigned char)c) || c == '_') {
+                    while (j < text.size() && (isalnum((unsigned char)text[j]) || text[j] == '_')) j++;
+                } else if (j < text.size() &&
+                           ((c == '&' && text[j] == '&') || (c == '|' && text[j] == '|') ||
+                            ((c == '=' || c == '!' || c == '<' || c == '>') && text[j] == '='))) {
+                    j++;
+                }
+                tokens.push_back(text.substr(i, j - i));
+                i = j;
+            }
+        }
+
+        long run() {
+            long v = parseOr();
+            if (pos != tokens.size()) valid = false;
+            return v;
+        }
+
+        bool accept(const char *t) {
+            if (pos < tokens.size() && tokens[pos] == t) { pos++; return true; }
+            return false;
+        }
+
+        long parseOr() {
+            long v = parseAnd();
+            while (accept("||")) { long r = parseAnd(); v = v || r; }
+            return v;
+        }
+        long parseAnd() {
+            long v = parseEquality();
+            while (accept("&&")) { long r = parseEquality(); v = v && r; }
+            return v;
+        }
+        long parseEquality() {
+            long v = parseRelational();
+            for (;;) {
+                if (accept("==")) v = v == parseRelational();
+                else if (accept("!=")) v = v != parseRelational();
+                else return v;
+            }
+        }
+        long parseRelational() {
+            long v = parseAdditive();
+            for (;;) {
+                if (accept("<=")) v = v <= parseAdditive();
+                else if (accept(">=")) v = v >= parseAdditive();
+                else if (accept("<")) v = v < parseAdditive();
+                else if (accept(">")) v = v > parseAdditive();
+                else return v;
+            }
+        }
+        long parseAdditive() {
+            long v = parseUnary();
+            for (;;) {
+                if (accept("+")) v += parseUnary();
+                else if (accept("-")) v -= parseUnary();
+                else return v;
+            }
+        }
+        long parseUnary() {
+            if (accept("!")) return !parseUnary();
+            if (accept("-")) return -parseUnary();
+            return parsePrimary();
+        }
+        long parsePrimary() {
+            if (pos >= tokens.size()) { valid = false; return 0; }
+            if (accept("(")) {
+                long v = parseOr();
+                if (!accept(")")) valid = false;
+                return v;
+            }
+            const std::string t = tokens[pos++];
+            if (t == "defined") {
+                bool paren = accept("(");
+                if (pos >= tokens.size()) { valid = false; return 0; }
+                long v = macros->count(tokens[pos++]) != 0;
+                if (paren && !accept(")")) valid = false;
+                return v;
+            }
+            if (isdigit((unsigned char)t[0])) return strtol(t.c_str(), NULL, 0);
+            if (!isalpha((unsigned char)t[0]) && t[0] != '_') { valid = false; return 0; }
+
+            std::map<std::string, std::string>::const_iterator it = macros->find(t);
+            if (it == macros->end() || it->second.empty()) return 0;
+            if (depth > 16) { valid = false; return 0; }
+            Expression nested(macros, it->second, depth + 1);
+            long v = nested.run();
+            valid = valid && nested.valid;
+            return v;
+        }
+    };
+
+    long evaluate(const std::string &text, const std::string &path, int line) {
+        Expression e(&macros, text, 0);
+        long v = e.run();
+        if (!e.valid) error("BAD_EXPRESSION", path, line);
+        return v;
+    }
+};
+
+// both stages of a program, as given to glShaderSource
+struct ShaderProgramSource {
+    std::string vertexPath;
+    std::string fragmentPath;
+    ShaderDefines defines;
+    ShaderSource vertex;
+    ShaderSource fragment;
+    uint64_t hash; // of the preprocessed code, equal for equivalent variants
+
+    // every file either stage read, once each
+    std::vector<std::string> files() const {
+        std::vector<std::string> all = vertex.files;
+        std::set<std::string> seen(all.begin(), all.end());
+        for (size_t i = 0; i < fragment.files.size(); i++)
+            if (seen.insert(fragment.files[i]).second) all.push_back(fragment.files[i]);
+        return all;
+    }
+};
+
+inline bool loadShaderProgram(const std::string &vertexPath, const std::string &fragmentPath,
+                              const ShaderDefines &defines, ShaderProgramSource &out) {
+    out.vertexPath = vertexPath;
+    out.fragmentPath = fragmentPath;
+    out.defines = defines;
+    ShaderPreprocessor pre(defines);
+    bool ok = pre.process(vertexPath, out.vertex);
+    ok = pre.process(fragmentPath, out.fragment) && ok;
+    out.hash = hashShaderSource(out.fragment.code, hashShaderSource(std::string(1, '\0'), hashShaderSource(out.vertex.code)));
+    return ok;
+}
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <set>
+
+#include "shader.h"
+#include "shader_watcher.h"
+#include "shader_preprocessor.h"
+
+// Permutations of shader sources, one Shader per variant.
+//
+// A variant is (vertex path, fragment path, defines) and keeps its own
+// defines, so a hot reload preprocesses each variant as itself. Its sources go
+// through the preprocessor and the program is keyed by the hash of the result:
+// variants whose define sets end up selecting the same code run one GL
+// program. That is checked again every update(), as a reload can make two
+// variants diverge or meet.
+//
+// Programs are built lazily by get(). prewarm() preprocesses a list of
+// variants on a worker thread instead; update(), on the render thread, then
+// submits their compiles (asynchronous with parallel compile) and get() only
+// waits if a variant is needed before the driver is done with it.
+class ShaderVariants {
+
+public:
+    struct Request {
+        std::string vertexPath;
+        std::string fragmentPath;
+        ShaderDefines defines;
+    };
+
+    ShaderVariants() : watcher(NULL), cancel(false) {}
+
+    // Shader leaves its GL program alone, the context may already be gone
+    ~ShaderVariants() {
+        cancel = true;
+        if (worker.joinable()) worker.join();
+        for (size_t i = 0; i < shaders.size(); i++) delete shaders[i];
+    }
+
+    Shader *get(const std::string &vertexPath, const std::string &fragmentPath,
+                const ShaderDefines &defines = ShaderDefines()) {
+        std::string key = makeKey(vertexPath, fragmentPath, defines);
+        std::map<std::string, Shader *>::iterator it = byKey.find(key);
+        if (it == byKey.end()) {
+            ShaderProgramSource source;
+            if (!loadShaderProgram(vertexPath, fragmentPath, defines, source))
+                std::cout << "ERROR::SHADER_VARIANTS::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            it = byKey.insert(std::make_pair(key, adopt(source))).first;
+        }
+        if (!it->second->ready()) link(it->second);
+        return it->second;
+    }
+
+    void prewarm(const std::vector<Request> &requests) {
+        if (worker.joinable()) worker.join();
+        worker = std::thread(&ShaderVariants::preprocess, this, requests);
+    }
+
+    // hot reload every variant, those already made and those to come
+    void setWatcher(ShaderWatcher *shaderWatcher) {
+        watcher = shaderWatcher;
+        for (size_t i = 0; i < shaders.size(); i++) watcher->watch(shaders[i]);
+    }
+
+    // render thread, once per frame
+    void update() {
+        std::vector<ShaderProgramSource> fresh;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            fresh.swap(prepared);
+        }
+        for (size_t i = 0; i < fresh.size(); i++) {
+            std::string key = makeKey(fresh[i].vertexPath, fresh[i].fragmentPath, fresh[i].defines);
+            if (!byKey.count(key)) byKey[key] = adopt(fresh[i]);
+        }
+        for (size_t i = 0; i < shaders.size(); i++)
+            if (shaders[i]->reloadPending()) shaders[i]->pollReload();
+        share();
+    }
+
+    size_t variantCount() const { return byKey.size(); }
+    size_t programCount() const {
+        std::set<GLuint> programs;
+        for (size_t i = 0; i < shaders.size(); i++)
+            if (shaders[i]->ready()) programs.insert(shaders[i]->ID);
+        return programs.size();
+    }
+
+private:
+    std::map<std::string, Shader *> byKey;
+    std::vector<Shader *> shaders;
+    std::set<Shader *> waiting; // made to share a program, not given one yet
+    ShaderWatcher *watcher;
+
+    std::thread worker;
+    std::atomic<bool> cancel;
+    std::mutex mutex;
+    std::vector<ShaderProgramSource> prepared; // preprocessed by the worker, not yet compiled
+
+    static std::string makeKey(const std::string &vertexPath, const std::string &fragmentPath,
+                               const ShaderDefines &defines) {
+        std::string key = vertexPath + '\n' + fragmentPath;
+        for (ShaderDefines::const_iterator it = defines.begin(); it != defines.end(); ++it)
+            key += '\n' + it->first + '=' + it->second;
+        return key;
+    }
+
+    // the shader linked or being built from this code, NULL if none
+    Shader *equivalent(const Shader *shader, uint64_t hash) const {
+        for (size_t i = 0; i < shaders.size(); i++) {
+            if (shaders[i] == shader) continue;
+            if ((shaders[i]->ready() && shaders[i]->sourceHash == hash) || shaders[i]->pendingHash() == hash)
+                return shaders[i];
+        }
+        return NULL;
+    }
+
+    // a new variant: it waits for the program of an equivalent one if there
+    // is one, else its program is submitted
+    Shader *adopt(const ShaderProgramSource &source) {
+        Shader *shader = new Shader(source);
+        if (equivalent(shader, source.hash)) waiting.insert(shader);
+        else shader->beginReload(source);
+        shaders.push_back(shader);
+        if (watcher) watcher->watch(shader);
+        return shader;
+    }
+
+    // get() needs a program now
+    void link(Shader *shader) {
+        if (shader->reloadPending()) {
+            shader->pollReload(true);
+            return;
+        }
+        Shader *other = equivalent(shader, shader->sourceHash);
+        if (other && !other->ready()) other->pollReload(true);
+        share();
+        if (shader->reloadPending()) shader->pollReload(true);
+    }
+
+    // Equal code, one program: every linked variant runs the program of the
+    // first linked one with its hash. A waiting variant whose equivalent has
+    // changed since builds its own (once: a failed compile is not retried,
+    // the next edit reloads it).
+    void share() {
+        std::map<uint64_t, Shader *> first;
+        for (size_t i = 0; i < shaders.size(); i++)
+            if (shaders[i]->ready() && !first.count(shaders[i]->sourceHash)) first[shaders[i]->sourceHash] = shaders[i];
+        for (size_t i = 0; i < shaders.size(); i++) {
+            Shader *shader = shaders[i];
+            if (shader->reloadPending()) continue;
+            std::map<uint64_t, Shader *>::iterator it = first.find(shader->sourceHash);
+            if (it != first.end()) {
+                shader->shareProgram(*it->second);
+                waiting.erase(shader);
+            } else if (waiting.count(shader) && !equivalent(shader, shader->sourceHash)) {
+                waiting.erase(shader);
+                ShaderProgramSource source;
+                if (shader->loadSources(source)) shader->beginReload(source);
+                else std::cout << "ERROR::SHADER_VARIANTS::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            }
+        }
+    }
+
+    // worker thread: file reads and preprocessing only, GL stays on the render thread
+    void preprocess(std::vector<Request> requests) {
+        for (size_t i = 0; i < requests.size() && !cancel; i++) {
+            ShaderProgramSource source;
+            if (!loadShaderProgram(requests[i].vertexPath, requests[i].fragmentPath, requests[i].defines, source))
+                continue;
+            std::lock_guard<std::mutex> lock(mutex);
+            prepared.push_back(source);
+        }
+    }
+
+    ShaderVariants(const ShaderVariants &);
+    ShaderVariants &operator=(const ShaderVariants &);
+};
+
+#endif
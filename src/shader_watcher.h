@@ -0,0 +1,245 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "shader.h"
+
+// Shader hot reload.
+//
+// A background thread watches the GLSL files of the registered shaders,
+// includes too (inotify on Linux, modification times elsewhere), and
+// preprocesses the new sources when one changes. The files watched are
+// those the last preprocessing read, so an edit adding or dropping an
+// #include moves the watches with it. Shaders can be registered while it
+// runs. It never touches GL: update(), called by the render thread between
+// frames, hands the sources to Shader::beginReload() and swaps in the
+// programs the driver has finished compiling.
+class ShaderWatcher {
+
+public:
+    ShaderWatcher() : running(false) {}
+    ~ShaderWatcher() { stop(); }
+
+    // render thread, the watcher thread picks it up on its next round
+    void watch(Shader *shader) {
+        Entry entry;
+        entry.shader = shader;
+        setPaths(entry, shader->dependencies);
+        std::lock_guard<std::mutex> lock(mutex);
+        added.push_back(entry);
+    }
+
+    void start() {
+        if (running) return;
+        running = true;
+        thread = std::thread(&ShaderWatcher::run, this);
+    }
+
+    void stop() {
+        if (!running) return;
+        running = false;
+        thread.join();
+    }
+
+    // render thread, at a frame boundary
+    void update() {
+        std::vector<Sources> fresh;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            fresh.swap(ready);
+        }
+        for (size_t i = 0; i < fresh.size(); i++) {
+            Shader *shader = fresh[i].shader;
+            shader->beginReload(fresh[i].source);
+            size_t r = 0;
+            while (r < reloading.size() && reloading[r].first != shader) r++;
+            if (r == reloading.size()) reloading.push_back(std::make_pair(shader, shader->generation));
+        }
+        // ShaderVariants may swap the program in first
+        for (size_t r = 0; r < reloading.size();) {
+            Shader *shader = reloading[r].first;
+            if (shader->reloadPending()) shader->pollReload();
+            if (shader->reloadPending()) {
+                r++;
+                continue;
+            }
+            if (shader->generation != reloading[r].second)
+                std::cout << "SHADER::RELOADED " << shader->fragmentPath << std::endl;
+            reloading.erase(reloading.begin() + r);
+        }
+    }
+
+private:
+    struct Entry {
+        Shader *shader;
+        std::vector<std::string> paths;
+        std::vector<long long> mtime;
+    };
+    struct Sources {
+        Shader *shader;
+        ShaderProgramSource source;
+    };
+
+    std::vector<Entry> entries; // the watcher thread's
+    std::thread thread;
+    std::atomic<bool> running;
+    std::mutex mutex;
+    std::vector<Entry> added;   // registered, not yet taken by the watcher thread
+    std::vector<Sources> ready; // read by the watcher, not yet handed to GL
+    // render thread: handed to GL and not swapped in yet, with the generation before
+    std::vector<std::pair<Shader *, unsigned int> > reloading;
+
+    // watcher thread: moves the new registrations to entries, returns where they start
+    size_t takeAdded() {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t first = entries.size();
+        entries.insert(entries.end(), added.begin(), added.end());
+        added.clear();
+        return first;
+    }
+
+    static long long modificationTime(const std::string &path) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return 0;
+        return (long long)st.st_mtime;
+    }
+
+    static std::string directoryOf(const std::string &path) {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+    }
+    static std::string fileNameOf(const std::string &path) {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    // the times of the paths already watched are kept, so a change that
+    // came with the refresh is not seen twice
+    static void setPaths(Entry &entry, const std::vector<std::string> &paths) {
+        std::vector<long long> mtime;
+        for (size_t i = 0; i < paths.size(); i++) {
+            size_t old = std::find(entry.paths.begin(), entry.paths.end(), paths[i]) - entry.paths.begin();
+            mtime.push_back(old < entry.paths.size() ? entry.mtime[old] : modificationTime(paths[i]));
+        }
+        entry.paths = paths;
+        entry.mtime.swap(mtime);
+    }
+
+    // watcher thread: read both stages, a half-written file is retried on the
+    // next event. False when they could not be read.
+    bool sourcesChanged(size_t e) {
+        Sources sources;
+        sources.shader = entries[e].shader;
+        if (!sources.shader->loadSources(sources.source)) return false;
+        setPaths(entries[e], sources.source.files());
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < ready.size(); i++) {
+            if (ready[i].shader == sources.shader) {
+                ready[i] = sources;
+                return true;
+            }
+        }
+        ready.push_back(sources);
+        return true;
+    }
+
+#if defined(__linux__)
+    void run() {
+        int fd = inotify_init1(IN_NONBLOCK);
+        if (fd < 0) {
+            std::cout << "ERROR::SHADER_WATCHER::INOTIFY_INIT_FAILED" << std::endl;
+            return;
+        }
+        // one watch per directory, editors often replace files by renaming
+        std::vector<std::vector<int> > watchOf;
+        std::map<int, int> users; // paths watched through each watch
+
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        while (running) {
+            for (size_t e = takeAdded(); e < entries.size(); e++) {
+                watchOf.push_back(std::vector<int>());
+                watchPaths(fd, entries[e], watchOf[e], users);
+            }
+            struct pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 200) <= 0) continue;
+            // let a burst of writes from the editor settle
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+            std::vector<bool> changed(entries.size(), false);
+            ssize_t len;
+            while ((len = read(fd, buffer, sizeof(buffer))) > 0) {
+                for (char *p = buffer; p < buffer + len;) {
+                    const struct inotify_event *event = (const struct inotify_event *)p;
+                    p += sizeof(struct inotify_event) + event->len;
+                    if (!event->len) continue;
+                    for (size_t e = 0; e < entries.size(); e++)
+                        for (size_t i = 0; i < entries[e].paths.size(); i++)
+                            if (watchOf[e][i] == event->wd && fileNameOf(entries[e].paths[i]) == event->name)
+                                changed[e] = true;
+                }
+            }
+            for (size_t e = 0; e < entries.size(); e++)
+                if (changed[e] && sourcesChanged(e)) watchPaths(fd, entries[e], watchOf[e], users);
+        }
+        close(fd);
+    }
+
+    // (re)watches the directories of the entry's paths, watches[i] for
+    // paths[i]; the new watches are added before the unused ones go, as
+    // adding a directory already watched returns its watch
+    static void watchPaths(int fd, const Entry &entry, std::vector<int> &watches, std::map<int, int> &users) {
+        std::vector<int> previous;
+        previous.swap(watches);
+        for (size_t i = 0; i < entry.paths.size(); i++) {
+            int wd = inotify_add_watch(fd, directoryOf(entry.paths[i]).c_str(),
+                                       IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+            if (wd >= 0) users[wd]++;
+            watches.push_back(wd);
+        }
+        for (size_t i = 0; i < previous.size(); i++) {
+            if (previous[i] < 0 || --users[previous[i]] > 0) continue;
+            inotify_rm_watch(fd, previous[i]);
+            users.erase(previous[i]);
+        }
+    }
+#else
+    void run() {
+        while (running) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            takeAdded();
+            for (size_t e = 0; e < entries.size(); e++) {
+                bool changed = false;
+                for (size_t i = 0; i < entries[e].paths.size(); i++) {
+                    long long t = modificationTime(entries[e].paths[i]);
+                    if (t != entries[e].mtime[i]) {
+                        entries[e].mtime[i] = t;
+                        changed = true;
+                    }
+                }
+                if (changed) sourcesChanged(e);
+            }
+        }
+    }
+#endif
+
+    ShaderWatcher(const ShaderWatcher &);
+    ShaderWatcher &operator=(const ShaderWatcher &);
+};
+
+#endif
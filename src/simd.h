@@ -0,0 +1,211 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cmath>
+#include <cstddef>
+
+// 8-wide float vector used by the batched kernels (intersection, culling...).
+//
+// With -mavx2 (make SIMD=avx2) it wraps an __m256, otherwise it falls back to
+// plain arrays with per-lane loops, which the compiler is free to
+// auto-vectorise. Kernels are written once against this type and run on
+// both paths.
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_AVX2 1
+#endif
+
+struct mask8;
+
+struct float8 {
+#if SIMD_AVX2
+    __m256 v;
+#else
+    float v[8];
+#endif
+
+    static float8 load(const float *p) {
+        float8 r;
+#if SIMD_AVX2
+        r.v = _mm256_loadu_ps(p);
+#else
+        for (int i = 0; i < 8; i++) r.v[i] = p[i];
+#endif
+        return r;
+    }
+    // first `count` values of p, zeros after, for arrays that are not padded
+    static float8 loadPartial(const float *p, size_t count) {
+        if (count >= 8) return load(p);
+        float tmp[8] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        for (size_t i = 0; i < count; i++) tmp[i] = p[i];
+        return load(tmp);
+    }
+    static float8 broadcast(float x) {
+        float8 r;
+#if SIMD_AVX2
+        r.v = _mm256_set1_ps(x);
+#else
+        for (int i = 0; i < 8; i++) r.v[i] = x;
+#endif
+        return r;
+    }
+    // p[idx[0]], p[idx[1]] ... p[idx[7]]
+    static float8 gather(const float *p, const int *idx) {
+        float8 r;
+#if SIMD_AVX2
+        r.v = _mm256_i32gather_ps(p, _mm256_loadu_si256((const __m256i *)idx), 4);
+#else
+        for (int i = 0; i < 8; i++) r.v[i] = p[idx[i]];
+#endif
+        return r;
+    }
+    // 0, 1, 2 ... 7 plus a base, for carrying primitive indices in lanes
+    static float8 iota(float base) {
+        float8 r;
+#if SIMD_AVX2
+        r.v = _mm256_add_ps(_mm256_set1_ps(base), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+#else
+        for (int i = 0; i < 8; i++) r.v[i] = base + (float)i;
+#endif
+        return r;
+    }
+    void store(float *p) const {
+#if SIMD_AVX2
+        _mm256_storeu_ps(p, v);
+#else
+        for (int i = 0; i < 8; i++) p[i] = v[i];
+#endif
+    }
+};
+
+struct mask8 {
+#if SIMD_AVX2
+    __m256 v;
+#else
+    bool v[8];
+#endif
+
+    // one bit per lane, lane 0 in bit 0
+    int bits() const {
+#if SIMD_AVX2
+        return _mm256_movemask_ps(v);
+#else
+        int r = 0;
+        for (int i = 0; i < 8; i++) r |= (v[i] ? 1 : 0) << i;
+        return r;
+#endif
+    }
+    bool any() const { return bits() != 0; }
+
+    // lanes [0, count) set, used to switch off the padding of the last group
+    static mask8 firstLanes(size_t count) {
+        mask8 r;
+#if SIMD_AVX2
+        __m256 idx = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+        r.v = _mm256_cmp_ps(idx, _mm256_set1_ps((float)(count < 8 ? count : 8)), _CMP_LT_OQ);
+#else
+        for (int i = 0; i < 8; i++) r.v[i] = (size_t)i < count;
+#endif
+        return r;
+    }
+};
+
+#if SIMD_AVX2
+
+#define SIMD_BINARY_OP(op, intrin) \
+    inline float8 operator op(const float8 &a, const float8 &b) { float8 r; r.v = intrin(a.v, b.v); return r; }
+#define SIMD_COMPARE_OP(op, pred) \
+    inline mask8 operator op(const float8 &a, const float8 &b) { mask8 r; r.v = _mm256_cmp_ps(a.v, b.v, pred); return r; }
+
+SIMD_BINARY_OP(+, _mm256_add_ps)
+SIMD_BINARY_OP(-, _mm256_sub_ps)
+SIMD_BINARY_OP(*, _mm256_mul_ps)
+SIMD_BINARY_OP(/, _mm256_div_ps)
+SIMD_COMPARE_OP(<, _CMP_LT_OQ)
+SIMD_COMPARE_OP(<=, _CMP_LE_OQ)
+SIMD_COMPARE_OP(>, _CMP_GT_OQ)
+SIMD_COMPARE_OP(>=, _CMP_GE_OQ)
+
+inline mask8 operator&(const mask8 &a, const mask8 &b) { mask8 r; r.v = _mm256_and_ps(a.v, b.v); return r; }
+inline mask8 operator|(const mask8 &a, const mask8 &b) { mask8 r; r.v = _mm256_or_ps(a.v, b.v); return r; }
+
+inline float8 min(const float8 &a, const float8 &b) { float8 r; r.v = _mm256_min_ps(a.v, b.v); return r; }
+inline float8 max(const float8 &a, const float8 &b) { float8 r; r.v = _mm256_max_ps(a.v, b.v); return r; }
+inline float8 sqrt(const float8 &a) { float8 r; r.v = _mm256_sqrt_ps(a.v); return r; }
+inline float8 abs(const float8 &a) { float8 r; r.v = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); return r; }
+inline float8 floor(const float8 &a) { float8 r; r.v = _mm256_floor_ps(a.v); return r; }
+// a * b + c
+inline float8 fmadd(const float8 &a, const float8 &b, const float8 &c) {
+    float8 r;
+#if defined(__FMA__)
+    r.v = _mm256_fmadd_ps(a.v, b.v, c.v);
+#else
+    r.v = _mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v);
+#endif
+    return r;
+}
+// lanes of a where m is set, b elsewhere
+inline float8 select(const mask8 &m, const float8 &a, const float8 &b) {
+    float8 r; r.v = _mm256_blendv_ps(b.v, a.v, m.v); return r;
+}
+
+#undef SIMD_BINARY_OP
+#undef SIMD_COMPARE_OP
+
+#else
+
+#define SIMD_BINARY_OP(op) \
+    inline float8 operator op(const float8 &a, const float8 &b) { \
+        float8 r; for (int i = 0; i < 8; i++) r.v[i] = a.v[i] op b.v[i]; return r; }
+#define SIMD_COMPARE_OP(op) \
+    inline mask8 operator op(const float8 &a, const float8 &b) { \
+        mask8 r; for (int i = 0; i < 8; i++) r.v[i] = a.v[i] op b.v[i]; return r; }
+
+SIMD_BINARY_OP(+)
+SIMD_BINARY_OP(-)
+SIMD_BINARY_OP(*)
+SIMD_BINARY_OP(/)
+SIMD_COMPARE_OP(<)
+SIMD_COMPARE_OP(<=)
+SIMD_COMPARE_OP(>)
+SIMD_COMPARE_OP(>=)
+
+inline mask8 operator&(const mask8 &a, const mask8 &b) { mask8 r; for (int i = 0; i < 8; i++) r.v[i] = a.v[i] && b.v[i]; return r; }
+inline mask8 operator|(const mask8 &a, const mask8 &b) { mask8 r; for (int i = 0; i < 8; i++) r.v[i] = a.v[i] || b.v[i]; return r; }
+
+inline float8 min(const float8 &a, const float8 &b) { float8 r; for (int i = 0; i < 8; i++) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return r; }
+inline float8 max(const float8 &a, const float8 &b) { float8 r; for (int i = 0; i < 8; i++) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return r; }
+inline float8 sqrt(const float8 &a) { float8 r; for (int i = 0; i < 8; i++) r.v[i] = std::sqrt(a.v[i]); return r; }
+inline float8 abs(const float8 &a) { float8 r; for (int i = 0; i < 8; i++) r.v[i] = std::fabs(a.v[i]); return r; }
+inline float8 floor(const float8 &a) { float8 r; for (int i = 0; i < 8; i++) r.v[i] = std::floor(a.v[i]); return r; }
+inline float8 fmadd(const float8 &a, const float8 &b, const float8 &c) { return a * b + c; }
+inline float8 select(const mask8 &m, const float8 &a, const float8 &b) {
+    float8 r; for (int i = 0; i < 8; i++) r.v[i] = m.v[i] ? a.v[i] : b.v[i]; return r;
+}
+
+#undef SIMD_BINARY_OP
+#undef SIMD_COMPARE_OP
+
+#endif
+
+inline float8 operator-(const float8 &a) { return float8::broadcast(0.0f) - a; }
+
+// rational approximation, a few ulp off std::tanh (the one Eigen uses)
+inline float8 tanh(const float8 &a) {
+    const float8 limit = float8::broadcast(7.90531110763549805f);
+    float8 x = max(min(a, limit), -limit);
+    float8 x2 = x * x;
+    float8 p = fmadd(x2, float8::broadcast(-2.76076847742355e-16f), float8::broadcast(2.00018790482477e-13f));
+    p = fmadd(x2, p, float8::broadcast(-8.60467152213735e-11f));
+    p = fmadd(x2, p, float8::broadcast(5.12229709037114e-08f));
+    p = fmadd(x2, p, float8::broadcast(1.48572235717979e-05f));
+    p = fmadd(x2, p, float8::broadcast(6.37261928875436e-04f));
+    p = fmadd(x2, p, float8::broadcast(4.89352455891786e-03f));
+    float8 q = fmadd(x2, float8::broadcast(1.19825839466702e-06f), float8::broadcast(1.18534705686654e-04f));
+    q = fmadd(x2, q, float8::broadcast(2.26843463243900e-03f));
+    q = fmadd(x2, q, float8::broadcast(4.89352518554385e-03f));
+    return x * p / q;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread.
+//
+// The producer only writes `tail` and the consumer only writes `head`, each
+// on its own cache line, so push and pop are a load, a copy and a release
+// store, with no lock and no compare-and-swap. Capacity is a power of two
+// (indices wrap with a mask) and the counters run freely, full when they are
+// Capacity apart.
+template <typename T, size_t Capacity>
+class SpscQueue {
+
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // producer, false when full (the item is not queued)
+    bool push(const T &item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity) return false;
+        items[t & (Capacity - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer, false when empty
+    bool pop(T &item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        item = items[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer, the oldest item without removing it, NULL when empty
+    const T *peek() const {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return NULL;
+        return &items[h & (Capacity - 1)];
+    }
+
+    // approximate when called while the other thread is working
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+    bool empty() const { return size() == 0; }
+
+private:
+    alignas(64) std::atomic<size_t> head; // consumer
+    alignas(64) std::atomic<size_t> tail; // producer
+    alignas(64) T items[Capacity];
+
+    SpscQueue(const SpscQueue &);
+    SpscQueue &operator=(const SpscQueue &);
+};
+
+#endif
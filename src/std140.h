@@ -0,0 +1,65 @@
+#ifndef STD140_H
+#define STD140_H
+
+#include <cstring>
+#include <cstddef>
+
+#include "glm/glm.hpp"
+
+// Writes GLM values with the std140 layout rules of uniform blocks:
+// scalars align to 4 bytes, vec2 to 8, vec3 / vec4 to 16, matrices are
+// arrays of vec4 columns and every array element is padded to 16 bytes.
+//
+// Members must be written in the order they appear in the GLSL block. With
+// a NULL destination nothing is written and `offset` just gives the size.
+class Std140Writer {
+
+public:
+    char *data;
+    size_t offset;
+
+    Std140Writer(void *dst = NULL) : data((char *)dst), offset(0) {}
+
+    Std140Writer &write(float v)            { return put(&v, sizeof(v), 4); }
+    Std140Writer &write(int v)              { return put(&v, sizeof(v), 4); }
+    Std140Writer &write(unsigned int v)     { return put(&v, sizeof(v), 4); }
+    Std140Writer &write(const glm::vec2 &v) { return put(&v[0], sizeof(v), 8); }
+    Std140Writer &write(const glm::vec3 &v) { return put(&v[0], sizeof(v), 16); }
+    Std140Writer &write(const glm::vec4 &v) { return put(&v[0], sizeof(v), 16); }
+
+    Std140Writer &write(const glm::mat3 &m) {
+        for (int c = 0; c < 3; c++) put(&m[c][0], sizeof(glm::vec3), 16);
+        return pad(16);
+    }
+    Std140Writer &write(const glm::mat4 &m) {
+        for (int c = 0; c < 4; c++) put(&m[c][0], sizeof(glm::vec4), 16);
+        return *this;
+    }
+
+    // T name[count]: each element starts on 16 bytes
+    template <typename T>
+    Std140Writer &writeArray(const T *values, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            pad(16);
+            write(values[i]);
+        }
+        return pad(16);
+    }
+
+    // a block's size is rounded up to a vec4
+    size_t size() const { return (offset + 15) & ~(size_t)15; }
+
+private:
+    Std140Writer &pad(size_t alignment) {
+        offset = (offset + alignment - 1) & ~(alignment - 1);
+        return *this;
+    }
+    Std140Writer &put(const void *src, size_t bytes, size_t alignment) {
+        pad(alignment);
+        if (data) memcpy(data + offset, src, bytes);
+        offset += bytes;
+        return *this;
+    }
+};
+
+#endif
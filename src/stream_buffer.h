@@ -0,0 +1,141 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <GL/glew.h>
+
+#include <iostream>
+
+#include "gl_state.h"
+
+// Ring buffer for data rewritten every frame (dynamic vertices, indices,
+// uniforms).
+//
+// The buffer is split in `frameCount` regions, one per frame in flight. A
+// frame writes only into its own region, and a fence placed at the end of
+// the frame tells when the GPU is done with it, so the CPU never writes over
+// data still being read and the driver never has to synchronise implicitly.
+//
+// With GL 4.4 / ARB_buffer_storage the whole buffer stays mapped
+// (persistent + coherent). Without it (macOS stops at 4.1) each allocation
+// is mapped unsynchronized instead, which is safe for the same reason.
+class StreamBuffer {
+
+public:
+    GLuint ID;
+    GLenum target;
+    GLsizeiptr frameSize;
+    int frameCount;
+    bool persistent;
+
+    // fence waits that had to block, i.e. the CPU got ahead of the GPU
+    unsigned int stalls;
+
+    struct Allocation {
+        void *ptr;       // write the data here, NULL if the frame is out of space
+        GLintptr offset; // offset in the buffer, for glBindBufferRange / attrib pointers
+        GLsizeiptr size;
+    };
+
+    StreamBuffer(GLenum target, GLsizeiptr bytesPerFrame, int frameCount = 3)
+        : target(target), frameSize(bytesPerFrame), frameCount(frameCount), stalls(0),
+          mapped(NULL), region(0), head(0) {
+        GLsizeiptr total = frameSize * frameCount;
+        fences = new GLsync[frameCount];
+        for (int i = 0; i < frameCount; i++) fences[i] = 0;
+
+        glGenBuffers(1, &ID);
+        glState().bindBuffer(target, ID);
+        persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+        if (persistent) {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(target, total, NULL, flags);
+            mapped = (char *)glMapBufferRange(target, 0, total, flags);
+            if (!mapped) {
+                std::cout << "ERROR::STREAM_BUFFER::PERSISTENT_MAP_FAILED" << std::endl;
+                persistent = false;
+            }
+        }
+        if (!persistent) {
+            // immutable storage cannot be respecified, start from a fresh name;
+            // it is often the same number, which the cache must not think bound
+            if (mapped == NULL && (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)) {
+                glState().deleteBuffers(1, &ID);
+                glGenBuffers(1, &ID);
+                glState().bindBuffer(target, ID);
+            }
+            glBufferData(target, total, NULL, GL_STREAM_DRAW);
+        }
+    }
+
+    ~StreamBuffer() {
+        for (int i = 0; i < frameCount; i++)
+            if (fences[i]) glDeleteSync(fences[i]);
+        delete[] fences;
+        if (persistent) {
+            glState().bindBuffer(target, ID);
+            glUnmapBuffer(target);
+        }
+        glState().deleteBuffers(1, &ID);
+    }
+
+    // moves to the next region, waiting until the GPU has finished with it
+    void beginFrame() {
+        region = (region + 1) % frameCount;
+        head = 0;
+        GLsync fence = fences[region];
+        if (!fence) return;
+
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            stalls++;
+            do {
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+            } while (status == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(fence);
+        fences[region] = 0;
+    }
+
+    // `alignment` must be a power of two (GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT for UBOs)
+    Allocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16) {
+        Allocation a = {NULL, 0, size};
+        GLsizeiptr start = (head + alignment - 1) & ~(alignment - 1);
+        if (start + size > frameSize) {
+            std::cout << "ERROR::STREAM_BUFFER::FRAME_OUT_OF_SPACE" << std::endl;
+            return a;
+        }
+        head = start + size;
+        a.offset = region * frameSize + start;
+        if (persistent) {
+            a.ptr = mapped + a.offset;
+        } else {
+            glState().bindBuffer(target, ID);
+            a.ptr = glMapBufferRange(target, a.offset, size,
+                                     GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        }
+        return a;
+    }
+
+    // call once the allocation is written, before drawing from it
+    void commit(const Allocation &a) {
+        if (persistent || !a.ptr) return;
+        glState().bindBuffer(target, ID);
+        glUnmapBuffer(target);
+    }
+
+    // fences the region, after the last draw reading from it
+    void endFrame() {
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+private:
+    char *mapped;
+    GLsync *fences;
+    int region;
+    GLsizeiptr head;
+
+    StreamBuffer(const StreamBuffer &);
+    StreamBuffer &operator=(const StreamBuffer &);
+};
+
+#endif
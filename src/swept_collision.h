@@ -0,0 +1,104 @@
+#ifndef SWEPT_COLLISION_H
+#define SWEPT_COLLISION_H
+
+#include <cmath>
+#include <limits>
+
+#include "glm/glm.hpp"
+
+// Continuous collision of a moving circle against an axis aligned box.
+//
+// The circle goes from `center` to `center + motion` over the step; a moving
+// box is handled by passing the motion relative to it. The hit time is exact:
+// the box grown by the radius (a rounded rectangle) is ray cast, first its
+// sides as slabs and, when the entry point lands in a corner region, the
+// circle of that corner. However fast the circle goes it cannot skip a box,
+// which a test at the end of each step does as soon as the circle covers more
+// than its diameter plus the box width in one step.
+
+struct SweepHit {
+    float t;          // fraction of `motion` travelled at first contact, 0 if already touching
+    glm::vec2 normal; // unit, from the box to the circle
+};
+
+inline float sweepMin(float a, float b) { return a < b ? a : b; }
+inline float sweepMax(float a, float b) { return a > b ? a : b; }
+
+// [tNear, tFar] where x + d t is in [lo, hi], false if never (d is 0, x outside)
+inline bool sweepSlab(float x, float d, float lo, float hi, float &tNear, float &tFar) {
+    const float inf = std::numeric_limits<float>::infinity();
+    if (d >= 0.0f && d <= 0.0f) {
+        tNear = -inf;
+        tFar = inf;
+        return x >= lo && x <= hi;
+    }
+    float t1 = (lo - x) / d, t2 = (hi - x) / d;
+    tNear = sweepMin(t1, t2);
+    tFar = sweepMax(t1, t2);
+    return true;
+}
+
+// first contact in [0, 1], only while moving towards the box
+inline bool sweepCircleAabb(const glm::vec2 &center, const glm::vec2 &motion, float radius,
+                            const glm::vec2 &boxMin, const glm::vec2 &boxMax, SweepHit &hit) {
+    // already touching: a hit at 0 unless moving out
+    float closestX = sweepMin(sweepMax(center.x, boxMin.x), boxMax.x);
+    float closestY = sweepMin(sweepMax(center.y, boxMin.y), boxMax.y);
+    float ox = center.x - closestX, oy = center.y - closestY;
+    float distance2 = ox * ox + oy * oy;
+    if (distance2 <= radius * radius) {
+        float nx, ny;
+        if (distance2 > 0.0f) {
+            float length = std::sqrt(distance2);
+            nx = ox / length;
+            ny = oy / length;
+        } else {
+            // centre inside the box: out through the nearest side
+            float left = center.x - boxMin.x, right = boxMax.x - center.x;
+            float down = center.y - boxMin.y, up = boxMax.y - center.y;
+            bool sideX = sweepMin(left, right) <= sweepMin(down, up);
+            nx = sideX ? (left <= right ? -1.0f : 1.0f) : 0.0f;
+            ny = sideX ? 0.0f : (down <= up ? -1.0f : 1.0f);
+        }
+        if (motion.x * nx + motion.y * ny >= 0.0f) return false;
+        hit.t = 0.0f;
+        hit.normal = glm::vec2(nx, ny);
+        return true;
+    }
+
+    // grown box as slabs
+    float nearX, farX, nearY, farY;
+    bool inSlabX = sweepSlab(center.x, motion.x, boxMin.x - radius, boxMax.x + radius, nearX, farX);
+    bool inSlabY = sweepSlab(center.y, motion.y, boxMin.y - radius, boxMax.y + radius, nearY, farY);
+    float tNear = sweepMax(nearX, nearY), tFar = sweepMin(farX, farY);
+    if (!inSlabX || !inSlabY || tNear > tFar || tNear > 1.0f || tFar < 0.0f) return false;
+
+    float t = sweepMax(tNear, 0.0f);
+    float px = center.x + motion.x * t, py = center.y + motion.y * t;
+    if (py >= boxMin.y && py <= boxMax.y) {
+        hit.t = t;
+        hit.normal = glm::vec2(px < boxMin.x ? -1.0f : 1.0f, 0.0f);
+        return true;
+    }
+    if (px >= boxMin.x && px <= boxMax.x) {
+        hit.t = t;
+        hit.normal = glm::vec2(0.0f, py < boxMin.y ? -1.0f : 1.0f);
+        return true;
+    }
+
+    // corner region: the circle around that corner, missing it misses the box
+    float cx = center.x - (px < boxMin.x ? boxMin.x : boxMax.x);
+    float cy = center.y - (py < boxMin.y ? boxMin.y : boxMax.y);
+    float b = cx * motion.x + cy * motion.y;
+    float c = cx * cx + cy * cy - radius * radius;
+    float mm = motion.x * motion.x + motion.y * motion.y;
+    float disc = b * b - mm * c;
+    if (b >= 0.0f || disc < 0.0f) return false;
+    float tCorner = (-b - std::sqrt(disc)) / mm;
+    if (tCorner > 1.0f) return false;
+    hit.t = tCorner;
+    hit.normal = glm::vec2((cx + motion.x * tCorner) / radius, (cy + motion.y * tCorner) / radius);
+    return true;
+}
+
+#endif
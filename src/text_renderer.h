@@ -0,0 +1,152 @@
+#ifndef TEXT_RENDERER_H
+#define TEXT_RENDERER_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#include "glm/glm.hpp"
+
+#include "gl_state.h"
+#include "half.h"
+#include "stream_buffer.h"
+#include "render_queue.h"
+#include "sdf_font.h"
+
+// Draws strings from an SdfFont, all the text of a frame in one instanced
+// draw of a quad.
+//
+// add() lays a string out on the CPU into one instance a glyph: corner,
+// size, atlas rectangle and colour, interleaved in 36 bytes. prepare() copies
+// the frame's glyphs into a StreamBuffer and hands back the draw; the
+// fragment shader (bin/Shaders/fText.glsl) turns the distance into coverage,
+// so the same atlas serves every size. Blend with GL_SRC_ALPHA,
+// GL_ONE_MINUS_SRC_ALPHA.
+//
+// Attribute locations: 0 corner (0..1), then per instance 1 position, 2 size,
+// 3 atlas rectangle (min uv, max uv), 4 colour (normalized RGBA8).
+class TextRenderer {
+
+public:
+    enum Align { LEFT, CENTER, RIGHT };
+
+    GLuint vertexArray;
+    GLuint atlasTexture;
+
+    TextRenderer(const SdfFont &font, size_t maxGlyphs)
+        : font(font), capacity(maxGlyphs),
+          stream(GL_ARRAY_BUFFER, (GLsizeiptr)(maxGlyphs * sizeof(Glyph) + 16)) {
+        glGenTextures(1, &atlasTexture);
+        glState().bindTexture(0, GL_TEXTURE_2D, atlasTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // rows of single bytes
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, font.width, font.height, 0, GL_RED, GL_UNSIGNED_BYTE,
+                     font.texels.empty() ? NULL : &font.texels[0]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        const float corners[] = {1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+        const unsigned int indices[] = {0, 1, 3, 1, 2, 3};
+        glGenVertexArrays(1, &vertexArray);
+        glGenBuffers(1, &quadBuffer);
+        glGenBuffers(1, &indexBuffer);
+        glState().bindVertexArray(vertexArray);
+        glState().bindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(0);
+        for (GLuint location = 1; location <= 4; location++) {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        glyphs.reserve(maxGlyphs);
+    }
+
+    ~TextRenderer() {
+        glState().deleteTextures(1, &atlasTexture);
+        glState().deleteVertexArrays(1, &vertexArray);
+        glState().deleteBuffers(1, &quadBuffer);
+        glState().deleteBuffers(1, &indexBuffer);
+    }
+
+    // queues a line of text, `position` is its baseline at the alignment
+    // point and `height` the height of a capital, both in the units of the
+    // transform given to prepare(); characters the font lacks are skipped
+    void add(const std::string &text, glm::vec2 position, float height, const glm::vec4 &color,
+             Align align = LEFT) {
+        const float unit = height / SdfFont::GRID_HEIGHT;
+        const float width = (text.size() * SdfFont::ADVANCE - (SdfFont::ADVANCE - SdfFont::GRID_WIDTH)) * unit;
+        if (align == CENTER) position.x -= 0.5f * width;
+        if (align == RIGHT) position.x -= width;
+
+        // the cell reaches SPREAD texels past the glyph box on every side
+        const float pad = (float)SdfFont::SPREAD / SdfFont::TEXELS_PER_UNIT * unit;
+        const glm::vec2 size = glm::vec2(SdfFont::GRID_WIDTH, SdfFont::GRID_HEIGHT) * unit + 2.0f * pad;
+        const uint32_t packed = packColor(color);
+        for (size_t i = 0; i < text.size(); i++) {
+            int index = font.glyph(text[i]);
+            if (index <= 0 || glyphs.size() == capacity) continue; // unknown, space or full
+            Glyph glyph;
+            glyph.position = position + glm::vec2(i * SdfFont::ADVANCE * unit - pad, -pad);
+            glyph.size = size;
+            glyph.uv = font.cellUv(index);
+            glyph.color = packed;
+            glyphs.push_back(glyph);
+        }
+    }
+
+    // uploads the glyphs added since the last call, false when there is
+    // nothing to draw
+    bool prepare(const glm::mat4 &transform, DrawCommand &command) {
+        stream.beginFrame();
+        const size_t count = glyphs.size();
+        if (count == 0) return false;
+        StreamBuffer::Allocation block = stream.allocate((GLsizeiptr)(count * sizeof(Glyph)));
+        if (block.ptr) memcpy(block.ptr, &glyphs[0], count * sizeof(Glyph));
+        glyphs.clear();
+        if (!block.ptr) return false;
+        stream.commit(block);
+
+        glState().bindVertexArray(vertexArray);
+        glState().bindBuffer(GL_ARRAY_BUFFER, stream.ID);
+        const GLsizei stride = sizeof(Glyph);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void *)(block.offset + offsetof(Glyph, position)));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *)(block.offset + offsetof(Glyph, size)));
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void *)(block.offset + offsetof(Glyph, uv)));
+        glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)(block.offset + offsetof(Glyph, color)));
+
+        DrawCommand draw = {vertexArray, GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, transform, (GLsizei)count};
+        command = draw;
+        return true;
+    }
+
+    // after the draw was issued, fences this frame's glyphs
+    void endFrame() { stream.endFrame(); }
+
+private:
+    struct Glyph {
+        glm::vec2 position; // bottom left corner of the cell
+        glm::vec2 size;
+        glm::vec4 uv;
+        uint32_t color;
+    };
+
+    const SdfFont &font;
+    size_t capacity;
+    std::vector<Glyph> glyphs;
+    StreamBuffer stream;
+    GLuint quadBuffer, indexBuffer;
+
+    TextRenderer(const TextRenderer &);
+    TextRenderer &operator=(const TextRenderer &);
+};
+
+#endif
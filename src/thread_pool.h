@@ -0,0 +1,154 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <functional>
+
+// Work-stealing thread pool.
+//
+// Each worker has its own task deque: it takes work from the back of its own
+// (the most recently pushed, still in cache) and, when empty, steals from the
+// front of the others (the oldest, usually the biggest remaining pieces).
+// Uneven tasks - a match with a rollback, a particle emitter that just burst -
+// get spread over idle workers without a central queue every thread fights
+// over. The deques are guarded by one small lock each, held for a push or a
+// pop only.
+//
+// parallelFor() is the usual entry point: it cuts a range into chunks, spreads
+// them over the workers and runs chunks on the calling thread too until all
+// are done.
+class ThreadPool {
+
+public:
+    typedef std::function<void()> Task;
+
+    // threads: 0 = one per hardware thread, minus the caller
+    explicit ThreadPool(unsigned int threads = 0)
+        : queues(threads ? threads : defaultThreads()), stopping(false), pending(0), nextQueue(0) {
+        for (size_t i = 0; i < queues.size(); i++)
+            workers.push_back(std::thread(&ThreadPool::run, this, (unsigned int)i));
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+    }
+
+    unsigned int size() const { return (unsigned int)workers.size(); }
+
+    void submit(const Task &task) {
+        Queue &queue = queues[nextQueue++ % queues.size()];
+        pending++;
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(task);
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+
+    // body(begin, end) over [0, count) in chunks of at least `grain`, returns when all are done
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &body) {
+        if (count == 0) return;
+        if (grain == 0) grain = 1;
+        size_t chunks = (count + grain - 1) / grain;
+        size_t target = (size_t)(queues.size() + 1) * 4; // a few chunks per thread to balance
+        if (chunks > target) chunks = target;
+        if (chunks <= 1) {
+            body(0, count);
+            return;
+        }
+
+        std::atomic<size_t> remaining(chunks);
+        for (size_t c = 0; c < chunks; c++) {
+            size_t begin = count * c / chunks, end = count * (c + 1) / chunks;
+            submit([&body, &remaining, begin, end]() {
+                body(begin, end);
+                remaining--;
+            });
+        }
+        // help instead of waiting
+        while (remaining.load() > 0) {
+            Task task;
+            if (steal(task, 0)) task();
+            else std::this_thread::yield();
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<Queue> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping;
+    std::atomic<int> pending; // queued, not yet taken
+    std::atomic<unsigned int> nextQueue;
+
+    static unsigned int defaultThreads() {
+        unsigned int hardware = std::thread::hardware_concurrency();
+        return hardware > 1 ? hardware - 1 : 1;
+    }
+
+    // own queue from the back, then the others from the front
+    bool take(Task &task, unsigned int self) {
+        {
+            Queue &own = queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = own.tasks.back();
+                own.tasks.pop_back();
+                pending--;
+                return true;
+            }
+        }
+        return steal(task, self + 1);
+    }
+
+    bool steal(Task &task, unsigned int start) {
+        for (size_t i = 0; i < queues.size(); i++) {
+            Queue &victim = queues[(start + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                pending--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(unsigned int self) {
+        for (;;) {
+            Task task;
+            if (take(task, self)) {
+                task();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            while (!stopping && pending.load() == 0) wake.wait(lock);
+            if (stopping && pending.load() == 0) return;
+        }
+    }
+
+    ThreadPool(const ThreadPool &);
+    ThreadPool &operator=(const ThreadPool &);
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef YUV_H
+#define YUV_H
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// RGBA8 -> planar YUV 4:2:0 (I420), BT.601 limited range, for video export.
+//
+// Coefficients are the usual ones in 7-bit fixed point so they fit the signed
+// bytes of vpmaddubsw: Y = ((33 R + 64 G + 13 B + 64) >> 7) + 16, within two
+// levels of the exact formula, 16..235 for black..white. Chroma is
+// taken from the 2x2 block average (centred siting, "C420jpeg" in Y4M terms),
+// averaged rows first then columns with rounding, like vpavgb. The AVX2 path
+// (make SIMD=avx2) does 16 pixels per step and gives the same bytes as the
+// scalar one.
+//
+// Planes are tightly packed: Y is width x height, U and V are
+// ceil(width / 2) x ceil(height / 2). With flipY the source rows are read
+// bottom-up, as returned by glReadPixels.
+
+inline uint8_t yuvAverage(uint8_t a, uint8_t b) {
+    return (uint8_t)((a + b + 1) >> 1);
+}
+
+inline uint8_t rgbaToLuma(const uint8_t *p) {
+    return (uint8_t)(((33 * p[0] + 64 * p[1] + 13 * p[2] + 64) >> 7) + 16);
+}
+
+// chroma of the average of four pixels: a b on the top row, c d below
+inline void rgbaToChroma(const uint8_t *a, const uint8_t *b, const uint8_t *c, const uint8_t *d,
+                         uint8_t &u, uint8_t &v) {
+    int m[3];
+    for (int i = 0; i < 3; i++) m[i] = yuvAverage(yuvAverage(a[i], c[i]), yuvAverage(b[i], d[i]));
+    u = (uint8_t)(((-19 * m[0] - 37 * m[1] + 56 * m[2] + 64) >> 7) + 128);
+    v = (uint8_t)(((56 * m[0] - 47 * m[1] - 9 * m[2] + 64) >> 7) + 128);
+}
+
+#if defined(__AVX2__)
+// 8 RGBA pixels -> 8 x int32 of (c0 R + c1 G + c2 B + 64) >> 7
+inline __m256i yuvDot8(__m256i pixels, __m256i coefficients) {
+    __m256i pairs = _mm256_maddubs_epi16(pixels, coefficients);
+    __m256i sums = _mm256_madd_epi16(pairs, _mm256_set1_epi16(1));
+    return _mm256_srai_epi32(_mm256_add_epi32(sums, _mm256_set1_epi32(64)), 7);
+}
+
+// 16 pixels -> 16 Y
+inline void yuvLuma16(__m256i p0, __m256i p1, uint8_t *y) {
+    const __m256i coefY = _mm256_set1_epi32(0x000D4021); // 33, 64, 13, 0
+    __m256i l0 = _mm256_add_epi32(yuvDot8(p0, coefY), _mm256_set1_epi32(16));
+    __m256i l1 = _mm256_add_epi32(yuvDot8(p1, coefY), _mm256_set1_epi32(16));
+    __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(l0, l1), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_storeu_si128((__m128i *)y, _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1)));
+}
+
+// two rows of 16 pixels -> 16 Y per row, 8 U and 8 V
+inline void rgbaToYuv420Block16(const uint8_t *row0, const uint8_t *row1,
+                                uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v) {
+    const __m256i coefU = _mm256_set1_epi32(0x0038DBED); // -19, -37, 56, 0
+    const __m256i coefV = _mm256_set1_epi32(0x00F7D138); // 56, -47, -9, 0
+    const __m256i chromaOffset = _mm256_set1_epi32(128);
+
+    __m256i a0 = _mm256_loadu_si256((const __m256i *)row0);
+    __m256i a1 = _mm256_loadu_si256((const __m256i *)(row0 + 32));
+    __m256i b0 = _mm256_loadu_si256((const __m256i *)row1);
+    __m256i b1 = _mm256_loadu_si256((const __m256i *)(row1 + 32));
+
+    // luma, packs interleaves the 128-bit lanes and the permute puts them back
+    yuvLuma16(a0, a1, y0);
+    yuvLuma16(b0, b1, y1);
+
+    // 2x2 averages: rows, then even / odd pixels
+    __m256i m0 = _mm256_avg_epu8(a0, b0);
+    __m256i m1 = _mm256_avg_epu8(a1, b1);
+    __m256 f0 = _mm256_castsi256_ps(m0), f1 = _mm256_castsi256_ps(m1);
+    __m256i even = _mm256_castps_si256(_mm256_shuffle_ps(f0, f1, _MM_SHUFFLE(2, 0, 2, 0)));
+    __m256i odd = _mm256_castps_si256(_mm256_shuffle_ps(f0, f1, _MM_SHUFFLE(3, 1, 3, 1)));
+    __m256i m = _mm256_permute4x64_epi64(_mm256_avg_epu8(even, odd), _MM_SHUFFLE(3, 1, 2, 0));
+
+    __m256i cu = _mm256_add_epi32(yuvDot8(m, coefU), chromaOffset);
+    __m256i cv = _mm256_add_epi32(yuvDot8(m, coefV), chromaOffset);
+    __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(cu, cv), _MM_SHUFFLE(3, 1, 2, 0));
+    __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+    _mm_storel_epi64((__m128i *)u, bytes);
+    _mm_storel_epi64((__m128i *)v, _mm_srli_si128(bytes, 8));
+}
+#endif
+
+inline void rgbaToYuv420(const uint8_t *rgba, int width, int height, bool flipY,
+                         uint8_t *yPlane, uint8_t *uPlane, uint8_t *vPlane) {
+    const int chromaWidth = (width + 1) / 2;
+    const size_t stride = (size_t)width * 4;
+
+    for (int j = 0; j < height; j += 2) {
+        // output rows j and j + 1 (the last row again if the height is odd)
+        int j1 = j + 1 < height ? j + 1 : j;
+        const uint8_t *row0 = rgba + (size_t)(flipY ? height - 1 - j : j) * stride;
+        const uint8_t *row1 = rgba + (size_t)(flipY ? height - 1 - j1 : j1) * stride;
+        uint8_t *y0 = yPlane + (size_t)j * width;
+        uint8_t *y1 = yPlane + (size_t)j1 * width;
+        uint8_t *u = uPlane + (size_t)(j / 2) * chromaWidth;
+        uint8_t *v = vPlane + (size_t)(j / 2) * chromaWidth;
+
+        int x = 0;
+#if defined(__AVX2__)
+        for (; x + 16 <= width; x += 16)
+            rgbaToYuv420Block16(row0 + x * 4, row1 + x * 4, y0 + x, y1 + x, u + x / 2, v + x / 2);
+#endif
+        for (; x < width; x += 2) {
+            // the last column again if the width is odd
+            int x1 = x + 1 < width ? x + 1 : x;
+            y0[x] = rgbaToLuma(row0 + x * 4);
+            y0[x1] = rgbaToLuma(row0 + x1 * 4);
+            y1[x] = rgbaToLuma(row1 + x * 4);
+            y1[x1] = rgbaToLuma(row1 + x1 * 4);
+            rgbaToChroma(row0 + x * 4, row0 + x1 * 4, row1 + x * 4, row1 + x1 * 4, u[x / 2], v[x / 2]);
+        }
+    }
+}
+
+#endif